@@ -0,0 +1,50 @@
+#include "base/framework/cancel_token.h"
+#include <assert.h>
+#include "base/framework/task.h"
+
+namespace base {
+	namespace internal {
+		namespace {
+			volatile LONG canceled_count = 0;
+		}
+
+		LONG CanceledCount() {
+			return canceled_count;
+		}
+
+		void AddCanceledCount(LONG count) {
+			InterlockedExchangeAdd(&canceled_count, count);
+		}
+	}
+
+	CancelHandle::CancelHandle(Task *task)
+		: token_(std::shared_ptr<internal::CancelState>(new internal::CancelState()), 0) {
+		assert(task != nullptr);
+		task->set_cancel_token(token_);
+	}
+
+	void CancelHandle::Cancel() {
+		if (token_.state_ == nullptr) {
+			return;
+		}
+		// only the first cancel counts.
+		if (InterlockedCompareExchange(&token_.state_->generation_, token_.generation_ + 1, token_.generation_) == token_.generation_) {
+			internal::AddCanceledCount(1);
+		}
+	}
+
+	TaskGroup::TaskGroup() : state_(new internal::CancelState()), added_count_(0) {
+	}
+
+	void TaskGroup::Add(Task *task) {
+		assert(task != nullptr);
+		task->set_cancel_token(CancelToken(state_, state_->generation_));
+		InterlockedIncrement(&added_count_);
+	}
+
+	void TaskGroup::CancelAll() {
+		InterlockedIncrement(&state_->generation_);
+		// some of the tasks may have run already, the count is only an upper bound.
+		internal::AddCanceledCount(InterlockedExchange(&added_count_, 0));
+	}
+}
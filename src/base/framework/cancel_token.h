@@ -0,0 +1,94 @@
+/*
+ * Cancel the tasks which have been posted to a MessageLoop, from any thread.
+ * A CancelHandle cancels one task, a TaskGroup cancels all the tasks added to it at once. Both of them
+ * work by a generation counter: a task remembers the generation of its handle or group when it is
+ * attached, and it is canceled once the generation has moved on, so canceling costs O(1) no matter
+ * how many tasks there are. A task can be attached to one handle or group only, before it is posted.
+ *
+ * The loop never runs a canceled task. It deletes the task, together with its bound arguments, when the
+ * task comes out of the queues, or earlier when the loop finds enough canceled tasks in its delayed
+ * queue and purges them.
+ *
+ * For example,
+ * std::unique_ptr<base::CancelableTask> task = base::MakeRunnableMethod(this, &Foo::OnTimeout);
+ * base::CancelHandle timeout(task.get());
+ * loop->PostDelayTask(std::move(task), 30 * 60 * 1000);
+ * ....
+ * timeout.Cancel();
+ */
+
+#ifndef BASE_FRAMEWORK_CANCEL_TOKEN_H__
+#define BASE_FRAMEWORK_CANCEL_TOKEN_H__
+
+#include <memory>
+#include <Windows.h>
+#include "base/util/noncopyable.h"
+
+namespace base {
+	class Task;
+
+	namespace internal {
+		struct CancelState {
+			CancelState() : generation_(0) {
+			}
+
+			volatile LONG generation_;
+		};
+
+		// The number of tasks canceled in the process so far, at most. The loops compare it with the size
+		// of their delayed queues to decide when to purge them.
+		LONG CanceledCount();
+		void AddCanceledCount(LONG count);
+	}
+
+	class CancelToken {
+	public:
+		CancelToken() : generation_(0) {
+		}
+
+		bool IsCanceled() const {
+			return state_ != nullptr && state_->generation_ != generation_;
+		}
+
+	private:
+		friend class CancelHandle;
+		friend class TaskGroup;
+		CancelToken(const std::shared_ptr<internal::CancelState> &state, LONG generation)
+			: state_(state), generation_(generation) {
+		}
+
+		std::shared_ptr<internal::CancelState> state_;
+		LONG generation_;
+	};
+
+	// The copies of a handle share the same task.
+	class CancelHandle {
+	public:
+		CancelHandle() {
+		}
+
+		explicit CancelHandle(Task *task);
+		void Cancel();
+		bool IsCanceled() const {
+			return token_.IsCanceled();
+		}
+
+	private:
+		CancelToken token_;
+	};
+
+	class TaskGroup : public noncopyable {
+	public:
+		TaskGroup();
+		void Add(Task *task);
+		// Cancel the tasks added so far, the tasks added later are not affected.
+		void CancelAll();
+
+	private:
+		std::shared_ptr<internal::CancelState> state_;
+		// The number of tasks added since the last CancelAll.
+		volatile LONG added_count_;
+	};
+}
+
+#endif// BASE_FRAMEWORK_CANCEL_TOKEN_H__
@@ -0,0 +1,152 @@
+#include <vector>
+#include "base/framework/cancel_token.h"
+#include "base/framework/message_loop.h"
+#include "base/framework/timing_wheel.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/test/test_tasks.h"
+#include "base/thread/thread.h"
+#include "base/test/test_with_exit_manager.h"
+
+using base::CancelHandle;
+using base::MessageLoop;
+using base::TaskGroup;
+using base::Thread;
+using base::WaitableEvent;
+
+namespace {
+	class Recorder : public base::test::Recorder {
+	public:
+		void Hold(std::shared_ptr<int> payload) {
+			Record(*payload);
+		}
+	};
+
+	// Make a payload whose use count tells whether the task bound with it is still alive.
+	std::shared_ptr<int> MakePayload(int value) {
+		return std::shared_ptr<int>(new int(value));
+	}
+
+	class Timer : public base::Task {
+	public:
+		Timer(base::TimeTicks run_time, int sequence_num) {
+			set_delayed_run_time(run_time);
+			set_sequence_num(sequence_num);
+		}
+
+		virtual void Run() {
+		}
+	};
+}
+
+TEST(CancelHandle, Basic) {
+	CancelHandle empty;
+	EXPECT_FALSE(empty.IsCanceled());
+	empty.Cancel();
+	std::unique_ptr<base::Task> task(new Timer(base::TimeTicks(), 0));
+	CancelHandle handle(task.get());
+	CancelHandle copy = handle;
+	EXPECT_FALSE(task->IsCanceled());
+	copy.Cancel();
+	EXPECT_TRUE(task->IsCanceled());
+	EXPECT_TRUE(handle.IsCanceled());
+	LONG canceled_count = base::internal::CanceledCount();
+	handle.Cancel();
+	EXPECT_EQ(canceled_count, base::internal::CanceledCount());
+}
+
+TEST(TaskGroup, CancelAll) {
+	TaskGroup group;
+	std::unique_ptr<base::Task> first(new Timer(base::TimeTicks(), 0));
+	std::unique_ptr<base::Task> second(new Timer(base::TimeTicks(), 1));
+	group.Add(first.get());
+	group.Add(second.get());
+	EXPECT_FALSE(first->IsCanceled());
+	group.CancelAll();
+	EXPECT_TRUE(first->IsCanceled());
+	EXPECT_TRUE(second->IsCanceled());
+	// the group can be used again.
+	std::unique_ptr<base::Task> third(new Timer(base::TimeTicks(), 2));
+	group.Add(third.get());
+	EXPECT_FALSE(third->IsCanceled());
+	EXPECT_TRUE(first->IsCanceled());
+}
+
+TEST(TimingWheel, TakeCanceled) {
+	base::TimingWheel wheel;
+	TaskGroup group;
+	base::TimeTicks start = base::TimeTicks::Now();
+	for (int i = 0; i < 100; ++i) {
+		base::Task *task = new Timer(start + base::TimeSpan::FromMilliseconds(i * i * i), i);
+		if (i % 2 == 0) {
+			group.Add(task);
+		}
+		wheel.Push(task);
+	}
+	delete wheel.PopDue(start);
+	group.CancelAll();
+	int canceled = 0;
+	for (base::Task *task = wheel.TakeCanceled(); task != nullptr; ++canceled) {
+		EXPECT_EQ(0, task->sequence_num() % 2);
+		base::Task *next = task->next();
+		delete task;
+		task = next;
+	}
+	EXPECT_EQ(49, canceled);
+	EXPECT_EQ(50u, wheel.size());
+	for (int i = 1; i < 100; i += 2) {
+		base::Task *task = wheel.PopDue(start + base::TimeSpan::FromHours(1));
+		ASSERT_TRUE(task != nullptr);
+		EXPECT_EQ(i, task->sequence_num());
+		delete task;
+	}
+	EXPECT_TRUE(wheel.empty());
+}
+
+TEST_WITH_EM(MessageLoop, CanceledTasksNeverRun) {
+	Recorder recorder;
+	Thread thread;
+	thread.Start();
+	TaskGroup group;
+	std::unique_ptr<base::CancelableTask> task = base::MakeRunnableMethod(&recorder, &Recorder::Record, 1);
+	CancelHandle handle(task.get());
+	thread.message_loop()->PostDelayTask(std::move(task), 20);
+	for (int i = 2; i < 10; ++i) {
+		task = base::MakeRunnableMethod(&recorder, &Recorder::Record, i);
+		group.Add(task.get());
+		thread.message_loop()->PostDelayTask(std::move(task), i % 3 * 10);
+	}
+	thread.message_loop()->PostDelayTask(base::MakeRunnableMethod(&recorder, &Recorder::Record, 10), 30);
+	thread.message_loop()->PostDelayTask(base::MakeRunnableMethod(&recorder, &Recorder::Done), 50);
+	handle.Cancel();
+	group.CancelAll();
+	recorder.Wait();
+	thread.Stop();
+	ASSERT_EQ(1u, recorder.ids().size());
+	EXPECT_EQ(10, recorder.ids()[0]);
+}
+
+// A canceled timeout gives back its arguments long before its deadline.
+TEST_WITH_EM(MessageLoop, PurgeCanceledDelayedTasks) {
+	const int kCount = 100;
+	Recorder recorder;
+	std::shared_ptr<int> payload = MakePayload(1);
+	Thread thread;
+	thread.Start();
+	std::vector<CancelHandle> handles;
+	for (int i = 0; i < kCount; ++i) {
+		std::unique_ptr<base::CancelableTask> task = base::MakeRunnableMethod(&recorder, &Recorder::Hold, payload);
+		handles.push_back(CancelHandle(task.get()));
+		thread.message_loop()->PostDelayTask(std::move(task), 30 * 60 * 1000);
+	}
+	for (int i = 0; i < kCount; ++i) {
+		handles[i].Cancel();
+	}
+	// wake the loop up, it purges the delayed queue before it looks for the due tasks.
+	thread.message_loop()->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Done));
+	recorder.Wait();
+	thread.message_loop()->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Done));
+	recorder.Wait();
+	EXPECT_EQ(1, payload.use_count());
+	thread.Stop();
+	EXPECT_TRUE(recorder.ids().empty());
+}
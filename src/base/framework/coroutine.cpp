@@ -0,0 +1,263 @@
+#include <winsock2.h>
+#include "base/framework/coroutine.h"
+#include <vector>
+#include "base/thread/thread_local.h"
+
+namespace base {
+	namespace internal {
+		// A fiber, and the coroutine it runs now.
+		struct FiberSlot {
+			LPVOID fiber_;
+			Coroutine *coroutine_;
+		};
+
+		// The fibers of a loop, and the coroutines which wait for a socket of the loop, which are in no queue
+		// of it. The thread is turned into a fiber when the first coroutine runs on it, and back when the loop
+		// is destructed.
+		class FiberPool : public MessageLoop::DestructionObserver {
+		public:
+			static FiberPool* current() {
+				FiberPool *pool = LocalStorage<FiberPool>::GetInstance()->Get();
+				if (pool == nullptr) {
+					pool = new FiberPool();
+					LocalStorage<FiberPool>::GetInstance()->Set(pool);
+					MessageLoop::current()->AddDestructionObserver(pool);
+				}
+				return pool;
+			}
+
+			LPVOID main_fiber() const {
+				return main_fiber_;
+			}
+
+			void set_limit(size_t limit) {
+				limit_ = limit;
+				while (slots_.size() > limit_) {
+					DeleteSlot(slots_.back());
+					slots_.pop_back();
+				}
+			}
+
+			FiberSlot* Take(LPFIBER_START_ROUTINE start) {
+				if (!slots_.empty()) {
+					FiberSlot *slot = slots_.back();
+					slots_.pop_back();
+					return slot;
+				}
+				FiberSlot *slot = new FiberSlot();
+				slot->coroutine_ = nullptr;
+				slot->fiber_ = CreateFiber(0, start, slot);
+				assert(slot->fiber_ != nullptr);
+				return slot;
+			}
+
+			void Release(FiberSlot *slot) {
+				slot->coroutine_ = nullptr;
+				if (slots_.size() < limit_) {
+					slots_.push_back(slot);
+				}else {
+					DeleteSlot(slot);
+				}
+			}
+
+			void Park(Coroutine *coroutine) {
+				coroutine->parked_prev_ = nullptr;
+				coroutine->parked_next_ = parked_;
+				if (parked_ != nullptr) {
+					parked_->parked_prev_ = coroutine;
+				}
+				parked_ = coroutine;
+			}
+
+			void Unpark(Coroutine *coroutine) {
+				if (coroutine->parked_prev_ != nullptr) {
+					coroutine->parked_prev_->parked_next_ = coroutine->parked_next_;
+				}else {
+					parked_ = coroutine->parked_next_;
+				}
+				if (coroutine->parked_next_ != nullptr) {
+					coroutine->parked_next_->parked_prev_ = coroutine->parked_prev_;
+				}
+				coroutine->parked_prev_ = coroutine->parked_next_ = nullptr;
+			}
+
+			static void DeleteSlot(FiberSlot *slot) {
+				DeleteFiber(slot->fiber_);
+				delete slot;
+			}
+
+			virtual void PreDestroyCurrentMessageLoop() {
+				LocalStorage<FiberPool>::GetInstance()->Set(nullptr);
+				delete this;
+			}
+
+		private:
+			FiberPool() : limit_(kDefaultLimit), converted_(false), parked_(nullptr) {
+				if (IsThreadAFiber()) {
+					main_fiber_ = GetCurrentFiber();
+				}else {
+					main_fiber_ = ConvertThreadToFiber(nullptr);
+					converted_ = true;
+				}
+				assert(main_fiber_ != nullptr);
+			}
+
+			~FiberPool() {
+				// the pump is still there, so their watches stop.
+				while (parked_ != nullptr) {
+					Coroutine *coroutine = parked_;
+					Unpark(coroutine);
+					delete coroutine;
+				}
+				for (size_t i = 0; i < slots_.size(); ++i) {
+					DeleteSlot(slots_[i]);
+				}
+				if (converted_) {
+					ConvertFiberToThread();
+				}
+			}
+
+			static const size_t kDefaultLimit = 16;
+			LPVOID main_fiber_;
+			std::vector<FiberSlot*> slots_;
+			size_t limit_;
+			bool converted_;
+			Coroutine *parked_;
+		};
+	}
+
+	Coroutine::Coroutine(std::unique_ptr<Task> body)
+		: body_(std::move(body)), slot_(nullptr), action_(kNone), resume_loop_(nullptr), delay_ms_(0), socket_(INVALID_SOCKET),
+		mode_(IOMessagePump::kWatchRead), watch_failed_(false), resume_posted_(false), parked_prev_(nullptr),
+		parked_next_(nullptr) {
+	}
+
+	Coroutine::~Coroutine() {
+		if (slot_ != nullptr) {
+			// suspended when its loop went away.
+			internal::FiberPool::DeleteSlot(slot_);
+		}
+	}
+
+	bool Coroutine::Start(MessageLoop *loop, const Location &from_here, std::unique_ptr<Task> body) {
+		assert(loop != nullptr && body != nullptr);
+		return loop->PostTask(from_here, std::unique_ptr<Task>(new Coroutine(std::move(body))));
+	}
+
+	Coroutine* Coroutine::current() {
+		return internal::LocalStorage<Coroutine>::GetInstance()->Get();
+	}
+
+	void Coroutine::SwitchToLoop(MessageLoop *loop) {
+		Coroutine *coroutine = current();
+		assert(coroutine != nullptr && loop != nullptr);
+		coroutine->resume_loop_ = loop;
+		coroutine->Suspend(kResumeOnLoop);
+	}
+
+	void Coroutine::Sleep(int64_t delay_ms) {
+		Coroutine *coroutine = current();
+		assert(coroutine != nullptr);
+		coroutine->delay_ms_ = delay_ms;
+		coroutine->Suspend(kResumeAfterDelay);
+	}
+
+	bool Coroutine::WaitForSocket(SOCKET socket, IOMessagePump::WatchMode mode) {
+		Coroutine *coroutine = current();
+		assert(coroutine != nullptr);
+		coroutine->socket_ = socket;
+		coroutine->mode_ = mode;
+		coroutine->watch_failed_ = false;
+		coroutine->Suspend(kResumeOnSocket);
+		return !coroutine->watch_failed_;
+	}
+
+	void Coroutine::SetFiberPoolLimit(size_t limit) {
+		assert(MessageLoop::current() != nullptr);
+		internal::FiberPool::current()->set_limit(limit);
+	}
+
+	void Coroutine::Run() {
+		// the thread must be a fiber to switch to one, also when the coroutine comes from another loop.
+		internal::FiberPool *pool = internal::FiberPool::current();
+		if (slot_ == nullptr) {
+			slot_ = pool->Take(&Coroutine::FiberMain);
+			slot_->coroutine_ = this;
+		}
+		action_ = kNone;
+		internal::LocalStorage<Coroutine>::GetInstance()->Set(this);
+		SwitchToFiber(slot_->fiber_);
+		internal::LocalStorage<Coroutine>::GetInstance()->Set(nullptr);
+	}
+
+	void Coroutine::Retire() {
+		// the loop is done with the task, so it can be posted again.
+		switch (action_) {
+		case kResumeOnLoop:
+			resume_loop_->PostContinuation(posted_from(), std::unique_ptr<Task>(this), 0);
+			break;
+		case kResumeAfterDelay:
+			MessageLoop::current()->PostContinuation(posted_from(), std::unique_ptr<Task>(this), delay_ms_);
+			break;
+		case kResumeOnSocket:
+			resume_posted_ = false;
+			if (IOMessageLoop::current()->WatchSocket(socket_, false, mode_, &controller_, this)) {
+				internal::FiberPool::current()->Park(this);
+			}else {
+				watch_failed_ = true;
+				MessageLoop::current()->PostContinuation(posted_from(), std::unique_ptr<Task>(this), 0);
+			}
+			break;
+		case kFinished:
+			internal::FiberPool::current()->Release(slot_);
+			slot_ = nullptr;
+			delete this;
+			break;
+		default:
+			// canceled before it started.
+			delete this;
+			break;
+		}
+	}
+
+	void CALLBACK Coroutine::FiberMain(LPVOID parameter) {
+		internal::FiberSlot *slot = static_cast<internal::FiberSlot*>(parameter);
+		// a fiber must never return, it runs the next coroutine it is given instead.
+		for (;;) {
+			slot->coroutine_->RunBody();
+			slot->coroutine_->Suspend(kFinished);
+		}
+	}
+
+	void Coroutine::RunBody() {
+		if (!body_->IsCanceled()) {
+			body_->Run();
+		}
+		body_.reset();
+	}
+
+	void Coroutine::Suspend(Action action) {
+		action_ = action;
+		// the main fiber of the thread which runs the coroutine now, it may not be the one it started on.
+		SwitchToFiber(internal::FiberPool::current()->main_fiber());
+	}
+
+	void Coroutine::OnSocketCanReadWithoutBlocking(SOCKET socket) {
+		OnSocketReady();
+	}
+
+	void Coroutine::OnSocketCanWriteWithoutBlocking(SOCKET socket) {
+		OnSocketReady();
+	}
+
+	void Coroutine::OnSocketReady() {
+		// a socket watched for both can be readable and writable in one notification, the task is posted
+		// once or the queue gets it twice.
+		if (resume_posted_) {
+			return;
+		}
+		resume_posted_ = true;
+		internal::FiberPool::current()->Unpark(this);
+		MessageLoop::current()->PostContinuation(posted_from(), std::unique_ptr<Task>(this), 0);
+	}
+}
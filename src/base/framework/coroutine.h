@@ -0,0 +1,100 @@
+/*
+ * Coroutines on the MessageLoop, so a request handler can be written as sequential code instead of a chain
+ * of tasks. The compiler has no co_await, so a coroutine runs on a fiber: an await switches back to the
+ * loop, which goes on with its other tasks, and the coroutine is resumed on a loop later by the coroutine
+ * itself, posted as a task. The coroutine is allocated once when it starts, the awaits allocate nothing.
+ *
+ * For example,
+ * void Handler::Serve() {                            // started by Coroutine::Start(io_loop, FROM_HERE, ...).
+ *     base::Coroutine::WaitForSocket(socket_, base::IOMessagePump::kWatchRead);
+ *     Request request = ReadRequest();
+ *     base::Coroutine::SwitchToLoop(db_loop_);      // runs on the database thread from here.
+ *     Response response = Query(request);
+ *     base::Coroutine::SwitchToLoop(io_loop_);
+ *     base::Coroutine::Sleep(10);
+ *     WriteResponse(response);
+ * }
+ *
+ * The fibers are kept by the loop which a coroutine finishes on, for the next coroutine which starts there.
+ * A coroutine is resumed by MessageLoop::PostContinuation, so a loop with a capacity never rejects it in the
+ * middle of its body. A coroutine which is still suspended when its loop is destructed, in its queues or
+ * waiting for a socket, is deleted with its fiber, the objects on the stack of the fiber are not
+ * destructed then.
+ */
+
+#ifndef BASE_FRAMEWORK_COROUTINE_H__
+#define BASE_FRAMEWORK_COROUTINE_H__
+
+#include <memory>
+#include "base/base_types.h"
+#include "base/framework/location.h"
+#include "base/framework/message_loop.h"
+#include "base/framework/message_pump_io.h"
+#include "base/framework/task.h"
+
+namespace base {
+	namespace internal {
+		struct FiberSlot;
+		class FiberPool;
+	}
+
+	class Coroutine : public Task, private IOMessagePump::Watcher {
+	public:
+		// Run |body| as a coroutine on |loop|. Return false if the loop rejected it, see MessageLoop::SetCapacity.
+		static bool Start(MessageLoop *loop, const Location &from_here, std::unique_ptr<Task> body);
+		// The coroutine which is running on this thread, nullptr outside of a coroutine.
+		static Coroutine* current();
+		// The functions below suspend the current coroutine without blocking the thread.
+		// Resume on |loop|, or after the other pending tasks if it is the current loop.
+		static void SwitchToLoop(MessageLoop *loop);
+		// Resume on the current loop after |delay_ms|.
+		static void Sleep(int64_t delay_ms);
+		// Resume on the current loop, which must be an IO loop, once the socket is ready. Return false if the
+		// socket cannot be watched.
+		static bool WaitForSocket(SOCKET socket, IOMessagePump::WatchMode mode);
+		// How many idle fibers the current loop keeps, 0 creates a fiber for each coroutine.
+		static void SetFiberPoolLimit(size_t limit);
+
+		virtual ~Coroutine();
+		virtual void Run();
+		virtual void Retire();
+
+	private:
+		friend class internal::FiberPool;
+		// What the loop does with the coroutine when it has switched back.
+		enum Action {
+			kNone,
+			kResumeOnLoop,
+			kResumeAfterDelay,
+			kResumeOnSocket,
+			kFinished
+		};
+
+		Coroutine(std::unique_ptr<Task> body);
+		// Run on the fiber.
+		static void CALLBACK FiberMain(LPVOID parameter);
+		void RunBody();
+		// Switch back to the loop, the action tells how to resume.
+		void Suspend(Action action);
+		virtual void OnSocketCanReadWithoutBlocking(SOCKET socket);
+		virtual void OnSocketCanWriteWithoutBlocking(SOCKET socket);
+		void OnSocketReady();
+
+		std::unique_ptr<Task> body_;
+		internal::FiberSlot *slot_;
+		Action action_;
+		MessageLoop *resume_loop_;
+		int64_t delay_ms_;
+		SOCKET socket_;
+		IOMessagePump::WatchMode mode_;
+		bool watch_failed_;
+		// the socket is ready and the coroutine is posted, a second notification for the same wait is ignored.
+		bool resume_posted_;
+		// In the list of the coroutines which wait for a socket of the loop, see FiberPool.
+		Coroutine *parked_prev_;
+		Coroutine *parked_next_;
+		IOMessagePump::SocketWatcher controller_;
+	};
+}
+
+#endif// BASE_FRAMEWORK_COROUTINE_H__
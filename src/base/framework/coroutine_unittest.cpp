@@ -0,0 +1,286 @@
+#include <winsock2.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "base/framework/coroutine.h"
+#include "base/synchronization/lock.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/test/test_tasks.h"
+#include "base/thread/thread.h"
+#include "base/test/test_with_exit_manager.h"
+
+using base::Coroutine;
+using base::MessageLoop;
+using base::Thread;
+using base::TimeTicks;
+using base::WaitableEvent;
+using base::test::DeleteTracker;
+using base::test::DoNothing;
+
+namespace {
+	class Hopper {
+	public:
+		Hopper(MessageLoop *first, MessageLoop *second, WaitableEvent *done) : first_(first), second_(second), done_(done) {
+		}
+
+		void Hop() {
+			loops_.push_back(MessageLoop::current());
+			Coroutine::SwitchToLoop(second_);
+			loops_.push_back(MessageLoop::current());
+			// a local survives the hops.
+			std::string text("hop");
+			Coroutine::SwitchToLoop(first_);
+			loops_.push_back(MessageLoop::current());
+			text.append("ped");
+			EXPECT_EQ("hopped", text);
+			EXPECT_TRUE(Coroutine::current() != nullptr);
+			done_->Signal();
+		}
+
+		void SleepFor(int64_t delay_ms) {
+			TimeTicks start = TimeTicks::Now();
+			Coroutine::Sleep(delay_ms);
+			slept_ = TimeTicks::Now() - start;
+			done_->Signal();
+		}
+
+		MessageLoop *first_;
+		MessageLoop *second_;
+		WaitableEvent *done_;
+		std::vector<MessageLoop*> loops_;
+		base::TimeSpan slept_;
+	};
+
+	// Coroutines on one loop which yield to each other.
+	class Interleaver {
+	public:
+		Interleaver(int total, WaitableEvent *done) : remaining_(total), done_(done) {
+		}
+
+		void Step(int id) {
+			for (int i = 0; i < 3; ++i) {
+				steps_.push_back(id);
+				Coroutine::SwitchToLoop(MessageLoop::current());
+			}
+			if (--remaining_ == 0) {
+				done_->Signal();
+			}
+		}
+
+		int remaining_;
+		WaitableEvent *done_;
+		std::vector<int> steps_;
+	};
+
+	class SocketReader {
+	public:
+		SocketReader(SOCKET socket, WaitableEvent *done) : socket_(socket), done_(done), watched_(false) {
+		}
+
+		void Read() {
+			watched_ = Coroutine::WaitForSocket(socket_, base::IOMessagePump::kWatchRead);
+			char buffer[16];
+			int size = recv(socket_, buffer, sizeof(buffer), 0);
+			if (size > 0) {
+				data_.assign(buffer, size);
+			}
+			done_->Signal();
+		}
+
+		// Waits for a socket which is readable and writable at once, then sleeps. The coroutine must be
+		// resumed once by the wait, a second resume would cut the sleep short.
+		void ReadWrite() {
+			watched_ = Coroutine::WaitForSocket(socket_, base::IOMessagePump::kWatchReadWrite);
+			char buffer[16];
+			int size = recv(socket_, buffer, sizeof(buffer), 0);
+			if (size > 0) {
+				data_.assign(buffer, size);
+			}
+			TimeTicks start = TimeTicks::Now();
+			Coroutine::Sleep(30);
+			slept_ = TimeTicks::Now() - start;
+			done_->Signal();
+		}
+
+		SOCKET socket_;
+		WaitableEvent *done_;
+		bool watched_;
+		std::string data_;
+		base::TimeSpan slept_;
+	};
+
+	// A connected pair of loopback sockets.
+	class SocketPair {
+	public:
+		SocketPair() : listener_(INVALID_SOCKET), client_(INVALID_SOCKET), server_(INVALID_SOCKET) {
+			WSADATA data;
+			WSAStartup(MAKEWORD(2, 2), &data);
+		}
+
+		~SocketPair() {
+			closesocket(client_);
+			closesocket(server_);
+			closesocket(listener_);
+			WSACleanup();
+		}
+
+		bool Connect() {
+			listener_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+			sockaddr_in address;
+			memset(&address, 0, sizeof(address));
+			address.sin_family = AF_INET;
+			address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			int length = sizeof(address);
+			if (bind(listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener_, 1) != 0 ||
+				getsockname(listener_, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+				return false;
+			}
+			client_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+			if (connect(client_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+				return false;
+			}
+			server_ = accept(listener_, nullptr, nullptr);
+			return server_ != INVALID_SOCKET;
+		}
+
+		SOCKET listener_;
+		SOCKET client_;
+		SOCKET server_;
+	};
+
+	// Waits for data which never comes.
+	void WaitForever(SOCKET socket, const std::shared_ptr<DeleteTracker> &tracker, WaitableEvent *waiting) {
+		waiting->Signal();
+		Coroutine::WaitForSocket(socket, base::IOMessagePump::kWatchRead);
+		ADD_FAILURE() << "resumed without data";
+	}
+
+	// Fills its own loop, then switches to it.
+	void YieldOnFullLoop(bool *rejected, bool *resumed, WaitableEvent *done) {
+		MessageLoop *loop = MessageLoop::current();
+		loop->SetCapacity(1, MessageLoop::kRejectTask);
+		loop->PostTask(base::MakeRunnableFunction(&DoNothing));
+		*rejected = !loop->PostTask(base::MakeRunnableFunction(&DoNothing));
+		Coroutine::SwitchToLoop(loop);
+		Coroutine::Sleep(0);
+		loop->SetCapacity(0, MessageLoop::kBlockProducer);
+		*resumed = true;
+		done->Signal();
+	}
+}
+
+TEST_WITH_EM(Coroutine, SwitchToLoop) {
+	Thread first;
+	Thread second;
+	first.Start();
+	second.Start();
+	WaitableEvent done(false, false);
+	Hopper hopper(first.message_loop(), second.message_loop(), &done);
+	Coroutine::Start(first.message_loop(), FROM_HERE, base::MakeRunnableMethod(&hopper, &Hopper::Hop));
+	done.Wait();
+	second.Stop();
+	first.Stop();
+	ASSERT_EQ(3u, hopper.loops_.size());
+	EXPECT_EQ(hopper.first_, hopper.loops_[0]);
+	EXPECT_EQ(hopper.second_, hopper.loops_[1]);
+	EXPECT_EQ(hopper.first_, hopper.loops_[2]);
+}
+
+TEST_WITH_EM(Coroutine, Sleep) {
+	Thread thread;
+	thread.Start();
+	WaitableEvent done(false, false);
+	Hopper hopper(nullptr, nullptr, &done);
+	Coroutine::Start(thread.message_loop(), FROM_HERE, base::MakeRunnableMethod(&hopper, &Hopper::SleepFor, static_cast<int64_t>(30)));
+	done.Wait();
+	thread.Stop();
+	EXPECT_LE(base::TimeSpan::FromMilliseconds(30), hopper.slept_);
+}
+
+TEST_WITH_EM(Coroutine, Interleave) {
+	const int kCoroutines = 20;
+	Thread thread;
+	thread.Start();
+	WaitableEvent done(false, false);
+	Interleaver interleaver(kCoroutines, &done);
+	thread.message_loop()->PostTask(base::MakeRunnableFunction(&Coroutine::SetFiberPoolLimit, static_cast<size_t>(4)));
+	for (int i = 0; i < kCoroutines; ++i) {
+		Coroutine::Start(thread.message_loop(), FROM_HERE, base::MakeRunnableMethod(&interleaver, &Interleaver::Step, i));
+	}
+	done.Wait();
+	thread.Stop();
+	ASSERT_EQ(static_cast<size_t>(3 * kCoroutines), interleaver.steps_.size());
+	// every coroutine took its first step before any took its second one.
+	for (int i = 0; i < kCoroutines; ++i) {
+		EXPECT_EQ(i, interleaver.steps_[i]);
+		EXPECT_EQ(i, interleaver.steps_[kCoroutines + i]);
+	}
+}
+
+TEST_WITH_EM(Coroutine, WaitForSocket) {
+	SocketPair sockets;
+	ASSERT_TRUE(sockets.Connect());
+	SOCKET client = sockets.client_;
+	SOCKET server = sockets.server_;
+
+	Thread thread;
+	thread.StartWithOptions(Thread::Options(MessageLoop::kIOMessageLoop));
+	WaitableEvent done(false, false);
+	SocketReader reader(server, &done);
+	Coroutine::Start(thread.message_loop(), FROM_HERE, base::MakeRunnableMethod(&reader, &SocketReader::Read));
+	Sleep(20);
+	EXPECT_EQ(5, send(client, "hello", 5, 0));
+	done.Wait();
+	thread.Stop();
+	EXPECT_TRUE(reader.watched_);
+	EXPECT_EQ("hello", reader.data_);
+}
+
+TEST_WITH_EM(Coroutine, WaitForSocketReadWrite) {
+	SocketPair sockets;
+	ASSERT_TRUE(sockets.Connect());
+	SOCKET client = sockets.client_;
+	SOCKET server = sockets.server_;
+	// readable before the wait starts, so both events come in the first notification.
+	EXPECT_EQ(5, send(client, "hello", 5, 0));
+
+	Thread thread;
+	thread.StartWithOptions(Thread::Options(MessageLoop::kIOMessageLoop));
+	WaitableEvent done(false, false);
+	SocketReader reader(server, &done);
+	Coroutine::Start(thread.message_loop(), FROM_HERE, base::MakeRunnableMethod(&reader, &SocketReader::ReadWrite));
+	done.Wait();
+	thread.Stop();
+	EXPECT_TRUE(reader.watched_);
+	EXPECT_EQ("hello", reader.data_);
+	EXPECT_LE(base::TimeSpan::FromMilliseconds(30), reader.slept_);
+}
+
+// The loop is full when the coroutine switches to it, the coroutine goes over the capacity.
+TEST_WITH_EM(Coroutine, ResumeOnFullLoop) {
+	Thread thread;
+	thread.Start();
+	bool rejected = false;
+	bool resumed = false;
+	WaitableEvent done(false, false);
+	Coroutine::Start(thread.message_loop(), FROM_HERE, base::MakeRunnableFunction(&YieldOnFullLoop, &rejected, &resumed, &done));
+	done.Wait();
+	thread.Stop();
+	EXPECT_TRUE(rejected);
+	EXPECT_TRUE(resumed);
+}
+
+// A coroutine waiting for a socket is in no queue, it is deleted with the loop all the same.
+TEST_WITH_EM(Coroutine, WaitingForSocketWhenLoopGoesAway) {
+	SocketPair sockets;
+	ASSERT_TRUE(sockets.Connect());
+	bool deleted = false;
+	Thread thread;
+	thread.StartWithOptions(Thread::Options(MessageLoop::kIOMessageLoop));
+	WaitableEvent waiting(false, false);
+	Coroutine::Start(thread.message_loop(), FROM_HERE, base::MakeRunnableFunction(&WaitForever, sockets.server_,
+		std::shared_ptr<DeleteTracker>(new DeleteTracker(&deleted)), &waiting));
+	waiting.Wait();
+	thread.Stop();
+	EXPECT_TRUE(deleted);
+}
@@ -0,0 +1,77 @@
+#include "base/framework/delayed_task_queue.h"
+
+#include <algorithm>
+
+namespace base {
+	HeapDelayedTaskQueue::~HeapDelayedTaskQueue() {
+		assert(heap_.empty());
+	}
+
+	void HeapDelayedTaskQueue::Push(Task *task) {
+		heap_.push_back(task);
+		std::push_heap(heap_.begin(), heap_.end(), TaskCompare());
+	}
+
+	TimeTicks HeapDelayedTaskQueue::NextRunTime() {
+		if (heap_.empty()) {
+			return TimeTicks();
+		}
+		return heap_.front()->delayed_run_time();
+	}
+
+	TimeSpan HeapDelayedTaskQueue::NextLeeway() {
+		if (heap_.empty()) {
+			return TimeSpan();
+		}
+		return heap_.front()->leeway();
+	}
+
+	Task* HeapDelayedTaskQueue::PopDue(TimeTicks now) {
+		if (heap_.empty() || heap_.front()->delayed_run_time() > now) {
+			return nullptr;
+		}
+		Task *task = heap_.front();
+		std::pop_heap(heap_.begin(), heap_.end(), TaskCompare());
+		heap_.pop_back();
+		return task;
+	}
+
+	Task* HeapDelayedTaskQueue::TakeAll() {
+		Task *list = nullptr;
+		for (size_t i = 0; i < heap_.size(); ++i) {
+			heap_[i]->set_next(list);
+			list = heap_[i];
+		}
+		heap_.clear();
+		return list;
+	}
+
+	Task* HeapDelayedTaskQueue::TakeCanceled() {
+		Task *list = nullptr;
+		size_t kept = 0;
+		for (size_t i = 0; i < heap_.size(); ++i) {
+			if (heap_[i]->IsCanceled()) {
+				heap_[i]->set_next(list);
+				list = heap_[i];
+			}else {
+				heap_[kept++] = heap_[i];
+			}
+		}
+		if (kept != heap_.size()) {
+			heap_.resize(kept);
+			std::make_heap(heap_.begin(), heap_.end(), TaskCompare());
+		}
+		return list;
+	}
+
+	bool HeapDelayedTaskQueue::TaskCompare::operator()(const Task *a, const Task *b) const {
+		// The heap puts the greatest one on the top, so the task which should run later is the less one.
+		if (a->delayed_run_time() > b->delayed_run_time()) {
+			return true;
+		}
+		if (a->delayed_run_time() < b->delayed_run_time()) {
+			return false;
+		}
+		return a->sequence_num() > b->sequence_num();
+	}
+}
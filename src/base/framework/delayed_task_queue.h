@@ -0,0 +1,69 @@
+/*
+ * The delayed task queue holds the tasks of a MessageLoop which were posted with a delay, ordered by
+ * their delayed run time and then by the order they were posted.
+ * HeapDelayedTaskQueue is a binary heap, it is exact but costs O(log n) for each push and pop. See
+ * timing_wheel.h for the queue which suits a huge number of pending timeouts.
+ */
+
+#ifndef BASE_FRAMEWORK_DELAYED_TASK_QUEUE_H__
+#define BASE_FRAMEWORK_DELAYED_TASK_QUEUE_H__
+
+#include <vector>
+#include "base/framework/task.h"
+#include "base/time/time.h"
+#include "base/util/noncopyable.h"
+
+namespace base {
+	class DelayedTaskQueue : public noncopyable {
+	public:
+		virtual ~DelayedTaskQueue() {
+		}
+
+		// Add a task whose delayed run time and sequence num have been set, the queue takes the ownership.
+		virtual void Push(Task *task) = 0;
+		// Return the time when the queue should be checked again, or a null time if the queue is empty.
+		// It needn't be the delayed run time of a task, the loop may find nothing due at that time and
+		// then asks again.
+		virtual TimeTicks NextRunTime() = 0;
+		// The leeway of the task which is due at NextRunTime, zero if it is not the time of a task.
+		virtual TimeSpan NextLeeway() = 0;
+		// Take away the next task whose delayed run time is not later than now. Return nullptr if there is none.
+		virtual Task* PopDue(TimeTicks now) = 0;
+		// Take away all the tasks, linked by Task::next().
+		virtual Task* TakeAll() = 0;
+		// Take away the canceled tasks, linked by Task::next(). It costs O(n).
+		virtual Task* TakeCanceled() = 0;
+		virtual size_t size() const = 0;
+		bool empty() const {
+			return size() == 0;
+		}
+	};
+
+	class HeapDelayedTaskQueue : public DelayedTaskQueue {
+	public:
+		HeapDelayedTaskQueue() {
+		}
+
+		virtual ~HeapDelayedTaskQueue();
+		virtual void Push(Task *task);
+		virtual TimeTicks NextRunTime();
+		virtual TimeSpan NextLeeway();
+		virtual Task* PopDue(TimeTicks now);
+		virtual Task* TakeAll();
+		virtual Task* TakeCanceled();
+		virtual size_t size() const {
+			return heap_.size();
+		}
+
+	private:
+		// Order the tasks by their delayed run time, and then by the sequence num if the times are equal.
+		struct TaskCompare {
+			bool operator()(const Task *a, const Task *b) const;
+		};
+
+		// Kept by std::push_heap and std::pop_heap, so the canceled tasks can be removed from the middle.
+		std::vector<Task*> heap_;
+	};
+}
+
+#endif// BASE_FRAMEWORK_DELAYED_TASK_QUEUE_H__
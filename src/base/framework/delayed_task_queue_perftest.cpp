@@ -0,0 +1,84 @@
+#include <stdlib.h>
+#include <sstream>
+#include <vector>
+#include "base/framework/delayed_task_queue.h"
+#include "base/framework/timing_wheel.h"
+#include "base/test/perf_reporter.h"
+#include "gtest/gtest.h"
+
+using base::DelayedTaskQueue;
+using base::Task;
+using base::TimeSpan;
+using base::TimeTicks;
+
+namespace {
+	class Timer : public Task {
+	public:
+		Timer(TimeTicks run_time, int sequence_num) {
+			set_delayed_run_time(run_time);
+			set_sequence_num(sequence_num);
+		}
+
+		virtual void Run() {
+		}
+	};
+
+	// Push the timers and then drain the queue the way a loop does, 1ms at a time, and report both.
+	void PushAndDrain(const char *queue_name, DelayedTaskQueue *queue, std::vector<Timer*> &timers, TimeTicks start) {
+		std::stringstream name;
+		name << queue_name << " with " << timers.size() << " timers";
+		std::string push_name = name.str() + " push";
+		std::string drain_name = name.str() + " drain";
+		base::PerfReporter reporter(static_cast<int64_t>(timers.size()));
+
+		base::StopWatch push_watch(base::StringPiece(push_name), &reporter);
+		push_watch.Start();
+		for (size_t i = 0; i < timers.size(); ++i) {
+			queue->Push(timers[i]);
+		}
+		push_watch.Stop();
+		push_watch.Report();
+
+		base::StopWatch drain_watch(base::StringPiece(drain_name), &reporter);
+		size_t popped = 0;
+		drain_watch.Start();
+		for (TimeTicks now = start; !queue->empty(); now += TimeSpan::FromMilliseconds(1)) {
+			TimeTicks next_time = queue->NextRunTime();
+			if (next_time > now) {
+				// an idle loop sleeps until the next run time.
+				now = next_time;
+			}
+			while (queue->PopDue(now) != nullptr) {
+				++popped;
+			}
+		}
+		drain_watch.Stop();
+		drain_watch.Report();
+		EXPECT_EQ(timers.size(), popped);
+	}
+}
+
+// The deadlines are spread over 30 minutes like the timeouts of a busy server.
+TEST(DelayedTaskQueuePerfTest, HeapVersusTimingWheel) {
+	const int64_t kMaxDelayUs = TimeSpan::FromMinutes(30).ToMicroseconds();
+	for (int count = 1000; count <= 1000000; count *= 10) {
+		TimeTicks start = TimeTicks::Now();
+		std::vector<Timer*> timers;
+		srand(count);
+		for (int i = 0; i < count; ++i) {
+			int64_t delay_us = (static_cast<int64_t>(rand() % 32768) << 15 | rand() % 32768) % kMaxDelayUs;
+			timers.push_back(new Timer(start + TimeSpan::FromMicroseconds(delay_us), i));
+		}
+		{
+			base::HeapDelayedTaskQueue heap;
+			PushAndDrain("Heap", &heap, timers, start);
+		}
+		{
+			base::TimingWheel wheel;
+			PushAndDrain("TimingWheel", &wheel, timers, start);
+		}
+		for (size_t i = 0; i < timers.size(); ++i) {
+			delete timers[i];
+		}
+	}
+}
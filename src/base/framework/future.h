@@ -0,0 +1,426 @@
+/*
+ * Get a result back from a task which runs on another MessageLoop without blocking any thread.
+ *
+ * PostTaskAndReplyWithResult runs a method on the target loop and hands its result to a reply on the
+ * loop of the caller. The request, the result and the reply travel in one relay task, which is the only
+ * allocation of the pair, so it is the one to use on a hot path.
+ * For example,
+ * base::PostTaskAndReplyWithResult(file_thread.message_loop(), FROM_HERE, reader, &Reader::ReadAll,
+ *     this, &Foo::OnRead);      // void Foo::OnRead(const std::string &data), runs on this loop.
+ *
+ * A Promise is the writing end of a Future. The value is set once, on any thread, and the continuation of
+ * the future is posted to the loop it was given when the value is there, or at once if it already is.
+ * For example,
+ * base::Promise<int> promise;
+ * loop->PostTask(base::MakeRunnableMethod(this, &Foo::Compute, promise));    // calls promise.SetValue(42).
+ * promise.GetFuture().Then(base::MessageLoop::current(), this, &Foo::OnComputed);
+ *
+ * A Promise costs three allocations: the state shared by the promise and the future, the task which sets
+ * the value and the continuation, which is typed by its reply and so can not live in the state.
+ *
+ * A promise which will never get its value is broken instead, the continuation is deleted without running
+ * and the future tells IsBroken(). PostTaskWithResult breaks the promise when the loop rejects the request,
+ * see MessageLoop::SetCapacity, and PostTaskAndReplyWithResult returns false then.
+ *
+ * A future has one continuation. The loops keep plain pointers to each other: the loop of a continuation
+ * or a reply must outlive the request, or the result is posted to a deleted loop. A reply or continuation
+ * which its loop rejects is deleted with the result, the loop counts it in queue_stats().rejected_count_.
+ * The result type needs a copy constructor but no default constructor.
+ */
+
+#ifndef BASE_FRAMEWORK_FUTURE_H__
+#define BASE_FRAMEWORK_FUTURE_H__
+
+#include <assert.h>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <Windows.h>
+#include "base/framework/location.h"
+#include "base/framework/message_loop.h"
+#include "base/framework/task.h"
+#include "base/util/noncopyable.h"
+
+namespace base {
+	namespace internal {
+		// Room for a value which is constructed later, so the value needs no default constructor.
+		template<class T>
+		class ValueStorage : public noncopyable {
+		public:
+			ValueStorage() : constructed_(false) {
+			}
+
+			~ValueStorage() {
+				if (constructed_) {
+					get().~T();
+				}
+			}
+
+			void Set(const T &value) {
+				if (constructed_) {
+					get() = value;
+				}else {
+					new (&buffer_) T(value);
+					constructed_ = true;
+				}
+			}
+
+			T& get() {
+				assert(constructed_);
+				return *reinterpret_cast<T*>(&buffer_);
+			}
+
+			const T& get() const {
+				assert(constructed_);
+				return *reinterpret_cast<const T*>(&buffer_);
+			}
+
+		private:
+			typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type buffer_;
+			bool constructed_;
+		};
+
+		template<class R, class T>
+		class MethodCall {
+		public:
+			MethodCall(T *obj, R (T::*method)()) : obj_(obj), method_(method) {
+			}
+
+			R operator()() const {
+				return (obj_->*method_)();
+			}
+
+		private:
+			T *obj_;
+			R (T::*method_)();
+		};
+
+		template<class R>
+		class FunctionCall {
+		public:
+			explicit FunctionCall(R (*function)()) : function_(function) {
+			}
+
+			R operator()() const {
+				return (*function_)();
+			}
+
+		private:
+			R (*function_)();
+		};
+
+		// The method, function or functor takes the result by value or by const reference.
+		template<class T, class Method>
+		class MethodReply {
+		public:
+			MethodReply(T *obj, Method method) : obj_(obj), method_(method) {
+			}
+
+			template<class R>
+			void operator()(const R &result) const {
+				(obj_->*method_)(result);
+			}
+
+		private:
+			T *obj_;
+			Method method_;
+		};
+
+		template<class Function>
+		class FunctionReply {
+		public:
+			explicit FunctionReply(Function function) : function_(function) {
+			}
+
+			template<class R>
+			void operator()(const R &result) const {
+				function_(result);
+			}
+
+		private:
+			Function function_;
+		};
+
+		// Runs the request on the target loop, then posts itself back to run the reply with the result.
+		template<class R, class Request, class Reply>
+		class ResultRelay : public Task {
+		public:
+			ResultRelay(const Request &request, const Reply &reply, MessageLoop *reply_loop)
+				: request_(request), reply_(reply), reply_loop_(reply_loop), ran_(false), replying_(false) {
+			}
+
+			virtual void Run() {
+				if (!replying_) {
+					result_.Set(request_());
+					ran_ = true;
+				}else {
+					reply_(result_.get());
+				}
+			}
+
+			virtual void Retire() {
+				if (replying_ || !ran_) {
+					delete this;
+					return;
+				}
+				replying_ = true;
+				// a rejected reply is deleted by the loop, which counts it.
+				reply_loop_->PostTask(posted_from(), std::unique_ptr<Task>(this));
+			}
+
+		private:
+			Request request_;
+			Reply reply_;
+			// not owned, it must outlive the request.
+			MessageLoop *reply_loop_;
+			ValueStorage<R> result_;
+			bool ran_;
+			bool replying_;
+		};
+
+		// Carries the value to the loop the continuation runs on.
+		template<class T>
+		class Continuation : public Task {
+		public:
+			explicit Continuation(MessageLoop *loop) : loop_(loop) {
+			}
+
+			MessageLoop* loop() const {
+				return loop_;
+			}
+
+			void set_value(const T &value) {
+				value_.Set(value);
+			}
+
+		protected:
+			// not owned, it must outlive the promise.
+			MessageLoop *loop_;
+			ValueStorage<T> value_;
+		};
+
+		template<class T, class Reply>
+		class ReplyContinuation : public Continuation<T> {
+		public:
+			ReplyContinuation(MessageLoop *loop, const Reply &reply) : Continuation<T>(loop), reply_(reply) {
+			}
+
+			virtual void Run() {
+				reply_(this->value_.get());
+			}
+
+		private:
+			Reply reply_;
+		};
+
+		template<class T>
+		class FutureState : public noncopyable {
+		public:
+			FutureState() : continuation_(nullptr), ready_(false), broken_(false) {
+			}
+
+			~FutureState() {
+				// the value never came.
+				if (continuation_ != nullptr && continuation_ != Settled()) {
+					delete static_cast<Continuation<T>*>(continuation_);
+				}
+			}
+
+			void SetValue(const T &value) {
+				assert(!ready_ && !broken_);
+				value_.Set(value);
+				ready_ = true;
+				void *continuation = InterlockedExchangePointer(&continuation_, Settled());
+				if (continuation != nullptr) {
+					Post(static_cast<Continuation<T>*>(continuation));
+				}
+			}
+
+			void Break() {
+				assert(!ready_ && !broken_);
+				broken_ = true;
+				delete static_cast<Continuation<T>*>(InterlockedExchangePointer(&continuation_, Settled()));
+			}
+
+			void SetContinuation(Continuation<T> *continuation) {
+				void *previous = InterlockedCompareExchangePointer(&continuation_, continuation, nullptr);
+				if (previous == Settled()) {
+					if (broken_) {
+						delete continuation;
+					}else {
+						Post(continuation);
+					}
+				}else {
+					// only one continuation for each future.
+					assert(previous == nullptr);
+				}
+			}
+
+			bool IsReady() const {
+				return ready_;
+			}
+
+			bool IsBroken() const {
+				return broken_;
+			}
+
+			const T& value() const {
+				assert(ready_);
+				return value_.get();
+			}
+
+		private:
+			// Marks the value has been set or the promise broken, no continuation lives there.
+			void* Settled() {
+				return this;
+			}
+
+			void Post(Continuation<T> *continuation) {
+				continuation->set_value(value_.get());
+				continuation->loop()->PostTask(continuation->posted_from(), std::unique_ptr<Task>(continuation));
+			}
+
+			ValueStorage<T> value_;
+			void* volatile continuation_;
+			volatile bool ready_;
+			volatile bool broken_;
+		};
+	}
+
+	template<class T>
+	class Promise;
+
+	template<class T>
+	class Future {
+	public:
+		Future() {
+		}
+
+		bool is_valid() const {
+			return state_ != nullptr;
+		}
+
+		bool IsReady() const {
+			return state_->IsReady();
+		}
+
+		// The value will never come, the continuation does not run.
+		bool IsBroken() const {
+			return state_->IsBroken();
+		}
+
+		// Only when it is ready.
+		const T& value() const {
+			return state_->value();
+		}
+
+		// Run obj->method(value) on |loop| once the value is set.
+		template<class U, class Method>
+		void Then(MessageLoop *loop, U *obj, Method method) {
+			ThenInternal(loop, internal::MethodReply<U, Method>(obj, method));
+		}
+
+		// |function| is a function or a functor, like a lambda.
+		template<class Function>
+		void Then(MessageLoop *loop, Function function) {
+			ThenInternal(loop, internal::FunctionReply<Function>(function));
+		}
+
+	private:
+		template<class U> friend class Promise;
+		explicit Future(const std::shared_ptr<internal::FutureState<T>> &state) : state_(state) {
+		}
+
+		template<class Reply>
+		void ThenInternal(MessageLoop *loop, const Reply &reply) {
+			assert(loop != nullptr && state_ != nullptr);
+			state_->SetContinuation(new internal::ReplyContinuation<T, Reply>(loop, reply));
+		}
+
+		std::shared_ptr<internal::FutureState<T>> state_;
+	};
+
+	template<class T>
+	class Promise {
+	public:
+		// The state shared with the future is allocated here, once.
+		Promise() : state_(std::make_shared<internal::FutureState<T>>()) {
+		}
+
+		Future<T> GetFuture() const {
+			return Future<T>(state_);
+		}
+
+		// Can be called on any thread, once, and not together with Break.
+		void SetValue(const T &value) const {
+			state_->SetValue(value);
+		}
+
+		// Tell the future its value will never come.
+		void Break() const {
+			state_->Break();
+		}
+
+	private:
+		std::shared_ptr<internal::FutureState<T>> state_;
+	};
+
+	namespace internal {
+		template<class R, class Request>
+		class PromiseTask : public Task {
+		public:
+			PromiseTask(const Request &request, const Promise<R> &promise) : request_(request), promise_(promise) {
+			}
+
+			virtual void Run() {
+				promise_.SetValue(request_());
+			}
+
+		private:
+			Request request_;
+			Promise<R> promise_;
+		};
+	}
+
+	// Run obj->method() on |loop| and reply_obj->reply(result) on the loop of the calling thread. Return
+	// false if |loop| rejected the request, the reply never runs then.
+	template<class R, class T, class U, class ReplyMethod>
+	bool PostTaskAndReplyWithResult(MessageLoop *loop, const Location &from_here, T *obj, R (T::*method)(), U *reply_obj, ReplyMethod reply) {
+		assert(MessageLoop::current() != nullptr);
+		typedef internal::ResultRelay<R, internal::MethodCall<R, T>, internal::MethodReply<U, ReplyMethod>> Relay;
+		return loop->PostTask(from_here, std::unique_ptr<Task>(new Relay(internal::MethodCall<R, T>(obj, method),
+			internal::MethodReply<U, ReplyMethod>(reply_obj, reply), MessageLoop::current())));
+	}
+
+	// |reply| is a function or a functor, like a lambda.
+	template<class R, class ReplyFunction>
+	bool PostTaskAndReplyWithResult(MessageLoop *loop, const Location &from_here, R (*function)(), ReplyFunction reply) {
+		assert(MessageLoop::current() != nullptr);
+		typedef internal::ResultRelay<R, internal::FunctionCall<R>, internal::FunctionReply<ReplyFunction>> Relay;
+		return loop->PostTask(from_here, std::unique_ptr<Task>(new Relay(internal::FunctionCall<R>(function),
+			internal::FunctionReply<ReplyFunction>(reply), MessageLoop::current())));
+	}
+
+	// Run obj->method() on |loop|, the future is ready with its result, or broken if |loop| rejected it.
+	template<class R, class T>
+	Future<R> PostTaskWithResult(MessageLoop *loop, const Location &from_here, T *obj, R (T::*method)()) {
+		Promise<R> promise;
+		if (!loop->PostTask(from_here, std::unique_ptr<Task>(new internal::PromiseTask<R, internal::MethodCall<R, T>>(
+			internal::MethodCall<R, T>(obj, method), promise)))) {
+			promise.Break();
+		}
+		return promise.GetFuture();
+	}
+
+	template<class R>
+	Future<R> PostTaskWithResult(MessageLoop *loop, const Location &from_here, R (*function)()) {
+		Promise<R> promise;
+		if (!loop->PostTask(from_here, std::unique_ptr<Task>(new internal::PromiseTask<R, internal::FunctionCall<R>>(
+			internal::FunctionCall<R>(function), promise)))) {
+			promise.Break();
+		}
+		return promise.GetFuture();
+	}
+}
+
+#endif// BASE_FRAMEWORK_FUTURE_H__
@@ -0,0 +1,271 @@
+#include "base/framework/future.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/test/test_tasks.h"
+#include "base/thread/thread.h"
+#include "base/test/test_with_exit_manager.h"
+
+using base::Future;
+using base::MessageLoop;
+using base::Promise;
+using base::Thread;
+using base::WaitableEvent;
+using base::test::Block;
+using base::test::DoNothing;
+
+namespace {
+	// Remembers the loops the request and the reply ran on.
+	class Requester {
+	public:
+		Requester() : request_loop_(nullptr), reply_loop_(nullptr), result_(0), done_(false, false) {
+		}
+
+		void Request() {
+			request_loop_ = MessageLoop::current();
+		}
+
+		int Compute() {
+			request_loop_ = MessageLoop::current();
+			return 42;
+		}
+
+		void Reply() {
+			reply_loop_ = MessageLoop::current();
+			done_.Signal();
+		}
+
+		void OnResult(const int &result) {
+			result_ = result;
+			Reply();
+		}
+
+		void PostRequest(MessageLoop *target) {
+			target->PostTaskAndReply(FROM_HERE, base::MakeRunnableMethod(this, &Requester::Request), base::MakeRunnableMethod(this, &Requester::Reply));
+		}
+
+		void PostRequestWithResult(MessageLoop *target) {
+			base::PostTaskAndReplyWithResult(target, FROM_HERE, this, &Requester::Compute, this, &Requester::OnResult);
+		}
+
+		void SetValue(Promise<int> promise, int value) {
+			promise.SetValue(value);
+		}
+
+		MessageLoop *request_loop_;
+		MessageLoop *reply_loop_;
+		int result_;
+		WaitableEvent done_;
+	};
+
+	int Seven() {
+		return 7;
+	}
+
+	int function_result = 0;
+	void OnFunctionResult(int result) {
+		function_result = result;
+	}
+
+	// A result without a default constructor.
+	class Port {
+	public:
+		explicit Port(int number) : number_(number) {
+		}
+
+		int number() const {
+			return number_;
+		}
+
+	private:
+		int number_;
+	};
+
+	Port OpenPort() {
+		return Port(80);
+	}
+
+	int replied_port = 0;
+	void OnPort(const Port &port) {
+		replied_port = port.number();
+	}
+
+	int continued_port = 0;
+	void OnPortReady(const Port &port) {
+		continued_port = port.number();
+	}
+
+	void RequestPort(MessageLoop *target, WaitableEvent *posted) {
+		base::PostTaskAndReplyWithResult(target, FROM_HERE, &OpenPort, &OnPort);
+		posted->Signal();
+	}
+}
+
+TEST_WITH_EM(Future, PostTaskAndReply) {
+	Thread origin;
+	Thread target;
+	origin.Start();
+	target.Start();
+	Requester requester;
+	origin.message_loop()->PostTask(base::MakeRunnableMethod(&requester, &Requester::PostRequest, target.message_loop()));
+	requester.done_.Wait();
+	EXPECT_EQ(target.message_loop(), requester.request_loop_);
+	EXPECT_EQ(origin.message_loop(), requester.reply_loop_);
+	target.Stop();
+	origin.Stop();
+}
+
+TEST_WITH_EM(Future, PostTaskAndReplyWithResult) {
+	Thread origin;
+	Thread target;
+	origin.Start();
+	target.Start();
+	Requester requester;
+	origin.message_loop()->PostTask(base::MakeRunnableMethod(&requester, &Requester::PostRequestWithResult, target.message_loop()));
+	requester.done_.Wait();
+	EXPECT_EQ(42, requester.result_);
+	EXPECT_EQ(target.message_loop(), requester.request_loop_);
+	EXPECT_EQ(origin.message_loop(), requester.reply_loop_);
+	target.Stop();
+	origin.Stop();
+}
+
+// The continuation is added before and after the value is set.
+TEST_WITH_EM(Future, ThenRunsOnChosenLoop) {
+	Thread thread;
+	Thread continuation_thread;
+	thread.Start();
+	continuation_thread.Start();
+	Requester before;
+	Promise<int> promise;
+	Future<int> future = promise.GetFuture();
+	EXPECT_TRUE(future.is_valid());
+	EXPECT_FALSE(future.IsReady());
+	future.Then(continuation_thread.message_loop(), &before, &Requester::OnResult);
+	thread.message_loop()->PostTask(base::MakeRunnableMethod(&before, &Requester::SetValue, promise, 5));
+	before.done_.Wait();
+	EXPECT_EQ(5, before.result_);
+	EXPECT_EQ(continuation_thread.message_loop(), before.reply_loop_);
+	EXPECT_TRUE(future.IsReady());
+	EXPECT_EQ(5, future.value());
+
+	Requester after;
+	Future<int> ready = base::PostTaskWithResult(thread.message_loop(), FROM_HERE, &after, &Requester::Compute);
+	thread.Stop();
+	EXPECT_TRUE(ready.IsReady());
+	ready.Then(continuation_thread.message_loop(), &after, &Requester::OnResult);
+	after.done_.Wait();
+	EXPECT_EQ(42, after.result_);
+	EXPECT_EQ(continuation_thread.message_loop(), after.reply_loop_);
+	continuation_thread.Stop();
+}
+
+TEST_WITH_EM(Future, FunctionContinuation) {
+	Thread thread;
+	thread.Start();
+	Future<int> future = base::PostTaskWithResult(thread.message_loop(), FROM_HERE, &Seven);
+	future.Then(thread.message_loop(), &OnFunctionResult);
+	thread.Stop();
+	EXPECT_EQ(7, function_result);
+}
+
+// The value never comes, the continuation is deleted with the state.
+TEST_WITH_EM(Future, BrokenPromise) {
+	Thread thread;
+	thread.Start();
+	Requester requester;
+	{
+		Promise<int> promise;
+		promise.GetFuture().Then(thread.message_loop(), &requester, &Requester::OnResult);
+	}
+	thread.Stop();
+	EXPECT_EQ(0, requester.result_);
+}
+
+TEST_WITH_EM(Future, ResultWithoutDefaultConstructor) {
+	Thread origin;
+	Thread target;
+	origin.Start();
+	target.Start();
+	WaitableEvent posted(false, false);
+	origin.message_loop()->PostTask(base::MakeRunnableFunction(&RequestPort, target.message_loop(), &posted));
+	posted.Wait();
+	Future<Port> future = base::PostTaskWithResult(target.message_loop(), FROM_HERE, &OpenPort);
+	future.Then(origin.message_loop(), &OnPortReady);
+	// the reply and the continuation are posted to the origin before the target stops.
+	target.Stop();
+	origin.Stop();
+	EXPECT_EQ(80, replied_port);
+	EXPECT_EQ(80, continued_port);
+	EXPECT_EQ(80, future.value().number());
+}
+
+namespace {
+	void RequestSeven(MessageLoop *target, bool *posted, int *result, WaitableEvent *done) {
+		*posted = base::PostTaskAndReplyWithResult(target, FROM_HERE, &Seven, [result, done](int value) {
+			*result = value;
+			done->Signal();
+		});
+		if (!*posted) {
+			done->Signal();
+		}
+	}
+}
+
+TEST_WITH_EM(Future, LambdaReply) {
+	Thread origin;
+	Thread target;
+	origin.Start();
+	target.Start();
+	bool posted = false;
+	int result = 0;
+	WaitableEvent done(false, false);
+	origin.message_loop()->PostTask(base::MakeRunnableFunction(&RequestSeven, target.message_loop(), &posted, &result,
+		&done));
+	done.Wait();
+	EXPECT_TRUE(posted);
+	EXPECT_EQ(7, result);
+	int continued = 0;
+	Future<int> future = base::PostTaskWithResult(target.message_loop(), FROM_HERE, &Seven);
+	future.Then(target.message_loop(), [&continued](const int &value) {
+		continued = value;
+	});
+	target.Stop();
+	origin.Stop();
+	EXPECT_EQ(7, continued);
+}
+
+// The target loop is full, so the request is rejected and the future is broken.
+TEST_WITH_EM(Future, RejectedRequestBreaksPromise) {
+	Thread origin;
+	Thread target;
+	origin.Start();
+	target.Start();
+	WaitableEvent started(false, false);
+	WaitableEvent release(false, false);
+	target.message_loop()->SetCapacity(1, MessageLoop::kRejectTask);
+	target.message_loop()->PostTask(base::MakeRunnableFunction(&Block, &started, &release));
+	started.Wait();
+	ASSERT_TRUE(target.message_loop()->PostTask(base::MakeRunnableFunction(&DoNothing)));
+
+	Requester requester;
+	Future<int> future = base::PostTaskWithResult(target.message_loop(), FROM_HERE, &requester, &Requester::Compute);
+	EXPECT_TRUE(future.IsBroken());
+	EXPECT_FALSE(future.IsReady());
+	// the continuation is deleted, it never runs.
+	future.Then(origin.message_loop(), &requester, &Requester::OnResult);
+
+	bool posted = true;
+	int result = 0;
+	WaitableEvent done(false, false);
+	origin.message_loop()->PostTask(base::MakeRunnableFunction(&RequestSeven, target.message_loop(), &posted, &result,
+		&done));
+	done.Wait();
+	EXPECT_FALSE(posted);
+
+	release.Signal();
+	// room for the quit task of Stop.
+	target.message_loop()->SetCapacity(0, MessageLoop::kBlockProducer);
+	target.Stop();
+	origin.Stop();
+	EXPECT_EQ(0, requester.result_);
+	EXPECT_EQ(0, result);
+}
@@ -0,0 +1,30 @@
+#include "base/framework/location.h"
+
+#include <string.h>
+#include <sstream>
+
+namespace base {
+	namespace {
+		// Most locations of a module share their file literal, so the addresses save the most calls.
+		int CompareNames(const char *left, const char *right) {
+			return left == right ? 0 : strcmp(left, right);
+		}
+	}
+
+	bool Location::operator<(const Location &other) const {
+		int result = CompareNames(file_name_, other.file_name_);
+		if (result != 0) {
+			return result < 0;
+		}
+		if (line_number_ != other.line_number_) {
+			return line_number_ < other.line_number_;
+		}
+		return CompareNames(function_name_, other.function_name_) < 0;
+	}
+
+	std::string Location::ToString() const {
+		std::stringstream stream;
+		stream << function_name_ << "@" << file_name_ << ":" << line_number_;
+		return stream.str();
+	}
+}
@@ -0,0 +1,51 @@
+/*
+ * The place in the code where a task was posted, captured by FROM_HERE.
+ * For example,
+ * loop->PostTask(FROM_HERE, base::MakeRunnableMethod(this, &Foo::Bar));
+ * The names are string literals, so a Location is cheap to copy and never owns anything.
+ */
+
+#ifndef BASE_FRAMEWORK_LOCATION_H__
+#define BASE_FRAMEWORK_LOCATION_H__
+
+#include <string>
+
+namespace base {
+	class Location {
+	public:
+		Location() : function_name_("Unknown"), file_name_("Unknown"), line_number_(-1) {
+		}
+
+		Location(const char *function_name, const char *file_name, int line_number)
+			: function_name_(function_name), file_name_(file_name), line_number_(line_number) {
+		}
+
+		const char* function_name() const {
+			return function_name_;
+		}
+
+		const char* file_name() const {
+			return file_name_;
+		}
+
+		int line_number() const {
+			return line_number_;
+		}
+
+		// Compared by the names and the line, the same literal can have different addresses in different
+		// modules, or even in one when the linker does not pool the strings.
+		bool operator<(const Location &other) const;
+
+		// function@file:line
+		std::string ToString() const;
+
+	private:
+		const char *function_name_;
+		const char *file_name_;
+		int line_number_;
+	};
+}
+
+#define FROM_HERE base::Location(__FUNCTION__, __FILE__, __LINE__)
+
+#endif// BASE_FRAMEWORK_LOCATION_H__
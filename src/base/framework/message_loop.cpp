@@ -1,17 +1,69 @@
 #include "base/framework/message_loop.h"
+#include <limits.h>
+#include "base/framework/timing_wheel.h"
+#include "base/synchronization/waitable_event.h"
 #include "base/thread/thread_local.h"
 
 namespace base {
-	MessageLoop::MessageLoop(MessageLoopType type) : type_(type), state_(nullptr), next_sequence_num_(0) {
+	namespace {
+		// Runs the task on the target loop, then posts itself back to run the reply when the target loop
+		// retires it.
+		class ReplyRelay : public Task {
+		public:
+			ReplyRelay(std::unique_ptr<Task> task, std::unique_ptr<Task> reply, MessageLoop *reply_loop)
+				: task_(std::move(task)), reply_(std::move(reply)), reply_loop_(reply_loop), replying_(false) {
+			}
+
+			virtual void Run() {
+				if (!replying_) {
+					if (!task_->IsCanceled()) {
+						task_->Run();
+					}
+					task_.reset();
+				}else if (!reply_->IsCanceled()) {
+					reply_->Run();
+				}
+			}
+
+			virtual void Retire() {
+				if (replying_ || task_ != nullptr) {
+					// the reply has run, or the relay was canceled before the task could run.
+					delete this;
+					return;
+				}
+				replying_ = true;
+				reply_loop_->PostTask(posted_from(), std::unique_ptr<Task>(this));
+			}
+
+		private:
+			std::unique_ptr<Task> task_;
+			std::unique_ptr<Task> reply_;
+			MessageLoop *reply_loop_;
+			bool replying_;
+		};
+	}
+
+	MessageLoop::MessageLoop(MessageLoopType type)
+		: type_(type), state_(nullptr), idle_head_(nullptr), idle_tail_(nullptr), starvation_policy_(kWeightedRoundRobin), aging_limit_(64), work_batch_size_(1),
+		run_count_(0),
+		collect_lane_stats_(false), collect_task_timing_(false), delayed_queue_type_(kHeapDelayedQueue), next_sequence_num_(0),
+		posted_count_(0), taken_count_(0), capacity_(0), overload_policy_(kBlockProducer), high_water_mark_(0), rejected_count_(0),
+		blocked_count_(0), dropped_count_(0), waiting_producers_(0), space_available_(new WaitableEvent(false, false)),
+		purged_canceled_count_(internal::CanceledCount()) {
+		work_lanes_[kHighPriority].weight_ = 16;
+		work_lanes_[kNormalPriority].weight_ = 4;
+		work_lanes_[kBestEffortPriority].weight_ = 1;
 		if (type_ == kDefaultMessageLoop) {
 			pump_ = std::shared_ptr<MessagePump>(new DefaultMessagePump());
 		}else if (type_ == kUIMessageLoop) {
 			pump_ = std::shared_ptr<MessagePump>(new UIMessagePump());
 		}else if (type_ == kIOMessageLoop) {
-			//TODO(tangjie):create io message pump;
+			pump_ = std::shared_ptr<MessagePump>(new IOMessagePump());
 		}
 		task_observers_ = std::shared_ptr<ObserverList<TaskObserver>>(new ObserverList<TaskObserver>());
 		destruction_observers_ = std::shared_ptr<ObserverList<DestructionObserver>>(new ObserverList<DestructionObserver>());
+		task_timing_collector_ = std::shared_ptr<TaskTimingCollector>(new TaskTimingCollector());
+		delayed_work_queue_ = std::shared_ptr<DelayedTaskQueue>(new HeapDelayedTaskQueue());
 		assert(	internal::LocalStorage<MessageLoop>::GetInstance()->Get() == nullptr);
 		//TODO(tangjie): Add log for error.
 		internal::LocalStorage<MessageLoop>::GetInstance()->Set(this);
@@ -42,6 +94,12 @@ namespace base {
 		return internal::LocalStorage<MessageLoop>::GetInstance()->Get();
 	}
 
+	void MessageLoop::DestructionObserver::PreDestroyCurrentMessageLoop() {
+	}
+
+	MessageLoop::DestructionObserver::~DestructionObserver() {
+	}
+
 	void MessageLoop::AddDestructionObserver(DestructionObserver *observer) {
 		assert(this == current());
 		destruction_observers_->AddObserver(observer);
@@ -62,12 +120,21 @@ namespace base {
 		task_observers_->RemoveObserver(observer);
 	}
 
-	void MessageLoop::PreProcessTask() {
-		FOR_EACH_OBSERVER(TaskObserver, task_observers_, PreProcessTask());
+	void MessageLoop::TaskObserver::PreProcessTask(const Task &task) {
 	}
 
-	void MessageLoop::PostPrecessTask() {
-		FOR_EACH_OBSERVER(TaskObserver, task_observers_, PostPrecessTask());
+	void MessageLoop::TaskObserver::PostPrecessTask(const Task &task) {
+	}
+
+	MessageLoop::TaskObserver::~TaskObserver() {
+	}
+
+	void MessageLoop::PreProcessTask(const Task &task) {
+		FOR_EACH_OBSERVER(TaskObserver, task_observers_, PreProcessTask(task));
+	}
+
+	void MessageLoop::PostPrecessTask(const Task &task) {
+		FOR_EACH_OBSERVER(TaskObserver, task_observers_, PostPrecessTask(task));
 	}
 
 	void MessageLoop::Run() {
@@ -101,21 +168,257 @@ namespace base {
 	void MessageLoop::QuitNow() {
 		assert(this == current());
 		if (state_ != nullptr) {
+			state_->quit_now_ = true;
 			pump_->Quit();
 		}
 	}
 
-	void MessageLoop::PostTask(std::shared_ptr<Task> task) {
-		if (task != nullptr) {
-			PendingTask pending_task(task, CalculateDelayedRuntime(0));
-			AddToIncomingQueue(pending_task);
+	bool MessageLoop::PostTask(std::unique_ptr<Task> task) {
+		return PostDelayTask(std::move(task), 0, kNormalPriority);
+	}
+
+	bool MessageLoop::PostDelayTask(std::unique_ptr<Task> task, int64_t delay_ms) {
+		return PostDelayTask(std::move(task), delay_ms, kNormalPriority);
+	}
+
+	bool MessageLoop::PostTask(std::unique_ptr<Task> task, TaskPriority priority) {
+		return PostDelayTask(std::move(task), 0, priority);
+	}
+
+	bool MessageLoop::PostDelayTask(std::unique_ptr<Task> task, int64_t delay_ms, TaskPriority priority) {
+		return PostDelayTaskInternal(std::move(task), delay_ms, priority, true);
+	}
+
+	bool MessageLoop::PostDelayTaskInternal(std::unique_ptr<Task> task, int64_t delay_ms, TaskPriority priority, bool bounded) {
+		if (task == nullptr) {
+			return false;
+		}
+		assert(priority >= kHighPriority && priority < kTaskPriorityCount);
+		task->set_delayed_run_time(CalculateDelayedRuntime(delay_ms));
+		task->set_priority(priority);
+		if (task->delayed_run_time().IsNull() && !AdmitTasks(1, bounded)) {
+			return false;
+		}
+		if (collect_lane_stats_ || collect_task_timing_) {
+			task->set_post_time(TimeTicks::HightResolutionNow());
+		}
+		AddToIncomingQueue(task.release());
+		return true;
+	}
+
+	bool MessageLoop::PostTask(const Location &from_here, std::unique_ptr<Task> task) {
+		return PostTask(from_here, std::move(task), kNormalPriority);
+	}
+
+	bool MessageLoop::PostDelayTask(const Location &from_here, std::unique_ptr<Task> task, int64_t delay_ms) {
+		if (task == nullptr) {
+			return false;
+		}
+		task->set_posted_from(from_here);
+		return PostDelayTask(std::move(task), delay_ms, kNormalPriority);
+	}
+
+	bool MessageLoop::PostTask(const Location &from_here, std::unique_ptr<Task> task, TaskPriority priority) {
+		if (task == nullptr) {
+			return false;
 		}
+		task->set_posted_from(from_here);
+		return PostDelayTask(std::move(task), 0, priority);
 	}
 
-	void MessageLoop::PostDelayTask(std::shared_ptr<Task> task, int64_t delay_ms) {
+	void MessageLoop::PostContinuation(const Location &from_here, std::unique_ptr<Task> task, int64_t delay_ms) {
+		assert(task != nullptr);
+		task->set_posted_from(from_here);
+		PostDelayTaskInternal(std::move(task), delay_ms, kNormalPriority, false);
+	}
+
+	bool MessageLoop::PostDelayTaskWithLeeway(std::unique_ptr<Task> task, int64_t delay_ms, int64_t leeway_ms) {
+		if (task == nullptr) {
+			return false;
+		}
+		assert(leeway_ms >= 0);
+		task->set_leeway(TimeSpan::FromMilliseconds(leeway_ms));
+		return PostDelayTask(std::move(task), delay_ms, kNormalPriority);
+	}
+
+	bool MessageLoop::PostTasks(TaskBatch *batch) {
+		if (batch->empty()) {
+			// nothing to reject.
+			return true;
+		}
+		LONG immediate_count = 0;
+		for (Task *task = batch->newest_; task != nullptr; task = task->next()) {
+			if (task->delayed_run_time().IsNull()) {
+				++immediate_count;
+			}
+		}
+		if (immediate_count > 0 && !AdmitTasks(immediate_count, true)) {
+			while (batch->newest_ != nullptr) {
+				Task *next = batch->newest_->next();
+				delete batch->newest_;
+				batch->newest_ = next;
+			}
+			batch->oldest_ = nullptr;
+			batch->size_ = 0;
+			return false;
+		}
+		if (collect_lane_stats_ || collect_task_timing_) {
+			TimeTicks now = TimeTicks::HightResolutionNow();
+			for (Task *task = batch->newest_; task != nullptr; task = task->next()) {
+				task->set_post_time(now);
+			}
+		}
+		if (incoming_queue_.PushList(batch->newest_, batch->oldest_)) {
+			pump_->ScheduleWork();
+		}
+		batch->newest_ = batch->oldest_ = nullptr;
+		batch->size_ = 0;
+		return true;
+	}
+
+	bool MessageLoop::PostTasks(std::vector<std::unique_ptr<Task>> tasks) {
+		TaskBatch batch;
+		for (size_t i = 0; i < tasks.size(); ++i) {
+			batch.Add(std::move(tasks[i]));
+		}
+		return PostTasks(&batch);
+	}
+
+	bool MessageLoop::PostTaskAndReply(const Location &from_here, std::unique_ptr<Task> task, std::unique_ptr<Task> reply) {
+		assert(task != nullptr && reply != nullptr);
+		MessageLoop *reply_loop = current();
+		assert(reply_loop != nullptr);
+		return PostTask(from_here, std::unique_ptr<Task>(new ReplyRelay(std::move(task), std::move(reply), reply_loop)));
+	}
+
+	void MessageLoop::PostIdleTask(std::unique_ptr<IdleTask> task) {
+		if (task == nullptr) {
+			return;
+		}
+		if (collect_task_timing_) {
+			task->set_post_time(TimeTicks::HightResolutionNow());
+		}
+		// the loop may be sleeping with nothing else to do.
+		if (idle_incoming_queue_.Push(task.release())) {
+			pump_->ScheduleWork();
+		}
+	}
+
+	void MessageLoop::PostIdleTask(const Location &from_here, std::unique_ptr<IdleTask> task) {
 		if (task != nullptr) {
-			PendingTask pending_task(task, CalculateDelayedRuntime(delay_ms));
-			AddToIncomingQueue(pending_task);
+			task->set_posted_from(from_here);
+			PostIdleTask(std::move(task));
+		}
+	}
+
+	void MessageLoop::SetDelayedQueueType(DelayedQueueType type) {
+		assert(this == current());
+		if (type == delayed_queue_type_) {
+			return;
+		}
+		std::shared_ptr<DelayedTaskQueue> queue;
+		if (type == kTimingWheelDelayedQueue) {
+			queue = std::shared_ptr<DelayedTaskQueue>(new TimingWheel());
+		}else {
+			queue = std::shared_ptr<DelayedTaskQueue>(new HeapDelayedTaskQueue());
+		}
+		// the tasks keep their sequence num, so they keep their order in the new queue.
+		Task *task = delayed_work_queue_->TakeAll();
+		while (task != nullptr) {
+			Task *next = task->next();
+			queue->Push(task);
+			task = next;
+		}
+		delayed_work_queue_ = queue;
+		delayed_queue_type_ = type;
+		if (!delayed_work_queue_->empty()) {
+			pump_->ScheduleDelayWork(GetWakeupTime(delayed_work_queue_->NextRunTime()));
+		}
+	}
+
+	void MessageLoop::SetStarvationPolicy(StarvationPolicy policy) {
+		assert(this == current());
+		starvation_policy_ = policy;
+	}
+
+	void MessageLoop::SetLaneWeight(TaskPriority priority, int weight) {
+		assert(this == current());
+		assert(weight > 0);
+		work_lanes_[priority].weight_ = weight;
+	}
+
+	void MessageLoop::SetAgingLimit(int task_count) {
+		assert(this == current());
+		assert(task_count > 0);
+		aging_limit_ = task_count;
+	}
+
+	void MessageLoop::SetWorkBatch(int max_tasks, int64_t budget_us) {
+		assert(this == current());
+		assert(max_tasks > 0 && budget_us >= 0);
+		work_batch_size_ = max_tasks;
+		work_batch_budget_ = TimeSpan::FromMicroseconds(budget_us);
+	}
+
+	void MessageLoop::SetPollingMode(int64_t spin_us) {
+		assert(this == current());
+		assert(type_ == kDefaultMessageLoop && spin_us >= 0);
+		down_cast<DefaultMessagePump*>(pump_.get())->SetSpinBudget(TimeSpan::FromMicroseconds(spin_us));
+	}
+
+	void MessageLoop::EnableLaneStats(bool enable) {
+		assert(this == current());
+		collect_lane_stats_ = enable;
+	}
+
+	void MessageLoop::SetTimerSlack(int64_t slack_ms) {
+		assert(this == current());
+		assert(slack_ms >= 0);
+		timer_slack_ = TimeSpan::FromMilliseconds(slack_ms);
+	}
+
+	void MessageLoop::EnableTaskTiming(bool enable) {
+		collect_task_timing_ = enable;
+	}
+
+	void MessageLoop::SetCapacity(size_t capacity, OverloadPolicy policy) {
+		assert(capacity <= LONG_MAX);
+		overload_policy_ = policy;
+		InterlockedExchange(&capacity_, static_cast<LONG>(capacity));
+		// the waiting producers check the new capacity.
+		space_available_->Signal();
+	}
+
+	MessageLoop::QueueStats MessageLoop::queue_stats() const {
+		QueueStats stats;
+		stats.pending_count_ = posted_count_ - taken_count_;
+		stats.high_water_mark_ = high_water_mark_;
+		stats.rejected_count_ = rejected_count_;
+		stats.blocked_count_ = blocked_count_;
+		stats.dropped_count_ = dropped_count_;
+		return stats;
+	}
+
+	MessagePump::WakeupStats MessageLoop::wakeup_stats() const {
+		assert(this == current());
+		return pump_->wakeup_stats();
+	}
+
+	DefaultMessagePump::SpinStats MessageLoop::spin_stats() const {
+		assert(this == current());
+		assert(type_ == kDefaultMessageLoop);
+		return down_cast<DefaultMessagePump*>(pump_.get())->spin_stats();
+	}
+
+	MessageLoop::LaneStats MessageLoop::lane_stats(TaskPriority priority) const {
+		assert(this == current());
+		return work_lanes_[priority].stats_;
+	}
+
+	void MessageLoop::ResetLaneStats() {
+		assert(this == current());
+		for (int i = 0; i < kTaskPriorityCount; ++i) {
+			work_lanes_[i].stats_ = LaneStats();
 		}
 	}
 
@@ -129,125 +432,440 @@ namespace base {
 
 	bool MessageLoop::DeletePendingTasks() {
 		//TODO(tangjie): add nestable task process.
-		bool did_work = !work_queue_.empty();
-		while (!work_queue_.empty()) {
-			PendingTask pending_task = work_queue_.front();
-			work_queue_.pop();
-			if (!pending_task.delayed_run_time_.IsNull()) {
-				AddToDelayedQueue(pending_task);
+		bool did_work = false;
+		for (int i = 0; i < kTaskPriorityCount; ++i) {
+			WorkLane &lane = work_lanes_[i];
+			did_work |= lane.head_ != nullptr;
+			while (lane.head_ != nullptr) {
+				Task *pending_task = lane.head_;
+				lane.head_ = pending_task->next();
+				delete pending_task;
+				OnTaskTaken();
 			}
+			lane.tail_ = nullptr;
+		}
+		ReloadIdleQueue();
+		did_work |= idle_head_ != nullptr;
+		while (idle_head_ != nullptr) {
+			Task *pending_task = idle_head_;
+			idle_head_ = pending_task->next();
+			delete pending_task;
 		}
-		did_work |= delayed_work_queue_.empty();
-		while(!delayed_work_queue_.empty()) {
-			delayed_work_queue_.pop();
+		idle_tail_ = nullptr;
+		did_work |= !delayed_work_queue_->empty();
+		Task *pending_task = delayed_work_queue_->TakeAll();
+		while (pending_task != nullptr) {
+			Task *next = pending_task->next();
+			delete pending_task;
+			pending_task = next;
 		}
 		return did_work;
 	}
 
-	void MessageLoop::AddToIncomingQueue(const PendingTask &task) {
-		std::shared_ptr<MessagePump> pump;
-		{
-			AutoLock lock(incoming_queue_lock_);
-			bool was_empty = incoming_queue_.empty();
-			incoming_queue_.push(task);
-			if (!was_empty) {
+	bool MessageLoop::AdmitTasks(LONG count, bool bounded) {
+		bool blocked = false;
+		for (;;) {
+			LONG capacity = capacity_;
+			if (capacity == 0 || overload_policy_ == kDropOldestBestEffort || !bounded) {
+				UpdateHighWaterMark(InterlockedExchangeAdd(&posted_count_, count) + count - taken_count_);
+				return true;
+			}
+			LONG posted = posted_count_;
+			LONG pending = posted - taken_count_;
+			// the loop thread can not wait for itself.
+			if (pending < capacity || (overload_policy_ == kBlockProducer && current() == this)) {
+				if (InterlockedCompareExchange(&posted_count_, posted + count, posted) == posted) {
+					UpdateHighWaterMark(pending + count);
+					if (blocked && waiting_producers_ > 0 && pending + count < capacity) {
+						// there may be room for the next one too.
+						space_available_->Signal();
+					}
+					return true;
+				}
+				continue;
+			}
+			if (overload_policy_ == kRejectTask) {
+				InterlockedIncrement(&rejected_count_);
+				return false;
+			}
+			if (!blocked) {
+				blocked = true;
+				InterlockedIncrement(&blocked_count_);
+			}
+			InterlockedIncrement(&waiting_producers_);
+			// the loop signals for each task it takes once it sees the waiter, check again after showing up.
+			if (posted_count_ - taken_count_ >= capacity_ && capacity_ != 0) {
+				space_available_->Wait();
+			}
+			InterlockedDecrement(&waiting_producers_);
+		}
+	}
+
+	void MessageLoop::UpdateHighWaterMark(LONG pending) {
+		for (;;) {
+			LONG mark = high_water_mark_;
+			if (pending <= mark || InterlockedCompareExchange(&high_water_mark_, pending, mark) == mark) {
 				return;
 			}
-			pump = pump_;
 		}
-		pump->ScheduleWork();
 	}
 
-	void MessageLoop::AddToDelayedQueue(const PendingTask &task) {
-		PendingTask pending_task(task);
-		pending_task.sequence_num_ = next_sequence_num_++;
-		delayed_work_queue_.push(pending_task);
+	void MessageLoop::OnTaskTaken() {
+		// only the loop thread writes it, but the store must not pass the load of waiting_producers_ below, or
+		// a producer which has just shown up and still sees the queue full waits for a signal never sent.
+		InterlockedIncrement(&taken_count_);
+		if (waiting_producers_ > 0) {
+			space_available_->Signal();
+		}
+	}
+
+	void MessageLoop::DropBestEffortTasks() {
+		WorkLane &lane = work_lanes_[kBestEffortPriority];
+		while (posted_count_ - taken_count_ > capacity_ && lane.head_ != nullptr) {
+			Task *task = lane.head_;
+			lane.head_ = task->next();
+			if (lane.head_ == nullptr) {
+				lane.tail_ = nullptr;
+			}
+			delete task;
+			++dropped_count_;
+			OnTaskTaken();
+		}
+	}
+
+	void MessageLoop::AddToIncomingQueue(Task *task) {
+		// Only the producer which finds the queue empty has to wake the loop up, the loop will take
+		// the tasks pushed after it together with its own.
+		if (incoming_queue_.Push(task)) {
+			pump_->ScheduleWork();
+		}
+	}
+
+	void MessageLoop::AddToDelayedQueue(Task *task) {
+		task->set_sequence_num(next_sequence_num_++);
+		delayed_work_queue_->Push(task);
+	}
+
+	void MessageLoop::AddToWorkLane(Task *task) {
+		WorkLane &lane = work_lanes_[task->priority()];
+		task->set_sequence_num(run_count_);
+		task->set_next(nullptr);
+		if (lane.tail_ != nullptr) {
+			lane.tail_->set_next(task);
+		}else {
+			lane.head_ = task;
+		}
+		lane.tail_ = task;
 	}
 
 	bool MessageLoop::DoWork() {
 		//TODO(tangjie): add nestable task process.
-		for (; ;) {
+		// Reload before each task, so a task posted to a higher lane needn't wait for the lower lanes to run out.
+		ReloadWorkQueue();
+		Task *task = TakeWork();
+		if (task == nullptr) {
+			return false;
+		}
+		if (work_batch_size_ == 1) {
+			RecordQueueingDelay(task);
+			return DeferOrRunPendingTask(task);
+		}
+		TimeTicks budget_end;
+		if (work_batch_budget_ > TimeSpan()) {
+			budget_end = TimeTicks::HightResolutionNow() + work_batch_budget_;
+		}
+		for (int i = 0; ; ) {
+			RecordQueueingDelay(task);
+			DeferOrRunPendingTask(task);
+			if (++i == work_batch_size_ || state_->quit_now_) {
+				break;
+			}
+			if (!budget_end.IsNull() && !(TimeTicks::HightResolutionNow() < budget_end)) {
+				break;
+			}
 			ReloadWorkQueue();
-			if (work_queue_.empty()) {
+			task = TakeWork();
+			if (task == nullptr) {
 				break;
 			}
-			do {
-				PendingTask task = work_queue_.front();
-				work_queue_.pop();
-				if (!task.delayed_run_time_.IsNull()) {
-					AddToDelayedQueue(task);
-					// if task is the first one which was pushed into queue. need to schedule delay work.
-					if (delayed_work_queue_.top().sequence_num_ == task.sequence_num_) {
-						pump_->ScheduleDelayWork(task.delayed_run_time_);
+		}
+		return true;
+	}
+
+	Task* MessageLoop::TakeWork() {
+		int picked = -1;
+		if (starvation_policy_ == kAging) {
+			for (int i = 0; i < kTaskPriorityCount; ++i) {
+				Task *head = work_lanes_[i].head_;
+				if (head == nullptr) {
+					continue;
+				}
+				if (picked < 0) {
+					picked = i;
+				}
+				if (i > picked && static_cast<unsigned>(run_count_ - head->sequence_num()) >= static_cast<unsigned>(aging_limit_)) {
+					// the lowest lane which is starving goes first.
+					picked = i;
+				}
+			}
+		}else {
+			for (int round = 0; round < 2 && picked < 0; ++round) {
+				for (int i = 0; i < kTaskPriorityCount; ++i) {
+					WorkLane &lane = work_lanes_[i];
+					if (lane.head_ != nullptr && lane.credit_ > 0) {
+						--lane.credit_;
+						picked = i;
+						break;
 					}
-				}else {
-					if (DeferOrRunPendingTask(task)) {
-						return true;
+				}
+				if (picked < 0) {
+					// every lane which has tasks has used up its turn, start a new round.
+					for (int i = 0; i < kTaskPriorityCount; ++i) {
+						work_lanes_[i].credit_ = work_lanes_[i].weight_;
 					}
 				}
-			}while(!work_queue_.empty());
+			}
+		}
+		if (picked < 0) {
+			return nullptr;
+		}
+		WorkLane &lane = work_lanes_[picked];
+		Task *task = lane.head_;
+		lane.head_ = task->next();
+		if (lane.head_ == nullptr) {
+			lane.tail_ = nullptr;
+		}
+		task->set_next(nullptr);
+		OnTaskTaken();
+		return task;
+	}
+
+	void MessageLoop::RecordQueueingDelay(Task *task) {
+		if (!collect_lane_stats_ || task->post_time().IsNull()) {
+			return;
+		}
+		int64_t delay_us = (TimeTicks::HightResolutionNow() - task->post_time()).ToMicroseconds();
+		LaneStats &stats = work_lanes_[task->priority()].stats_;
+		++stats.task_count_;
+		stats.total_delay_us_ += delay_us;
+		if (delay_us > stats.max_delay_us_) {
+			stats.max_delay_us_ = delay_us;
 		}
-		return false;
 	}
 
 	bool MessageLoop::DoDelayWork(TimeTicks *next_delayed_work_time) {
 		//TODO(tangjie): add nestable task process.
-		if (delayed_work_queue_.empty()) {
+		PurgeCanceledTasks();
+		if (delayed_work_queue_->empty()) {
 			recent_time_ = *next_delayed_work_time = TimeTicks();
 			return false;
 		}
-		TimeTicks next_time = delayed_work_queue_.top().delayed_run_time_;
+		TimeTicks next_time = delayed_work_queue_->NextRunTime();
 		if (next_time > recent_time_) {
 			recent_time_ = TimeTicks::Now();
 			if (next_time > recent_time_) {
-				*next_delayed_work_time = next_time;
+				*next_delayed_work_time = GetWakeupTime(next_time);
 				return false;
 			}
 		}
-		PendingTask task = delayed_work_queue_.top();
-		delayed_work_queue_.pop();
-		if (!delayed_work_queue_.empty()) {
-			*next_delayed_work_time = delayed_work_queue_.top().delayed_run_time_;
+		// the timing wheel may report a time before any task is due, then nothing is popped.
+		Task *task = delayed_work_queue_->PopDue(recent_time_);
+		*next_delayed_work_time = GetWakeupTime(delayed_work_queue_->NextRunTime());
+		if (task == nullptr) {
+			return false;
 		}
 		return DeferOrRunPendingTask(task);
 	}
 
+	void MessageLoop::PurgeCanceledTasks() {
+		LONG canceled_count = internal::CanceledCount();
+		// the count covers the tasks canceled on all the loops, so the purge may find less than it expects.
+		// A purge costs O(n) but needs n / 4 cancels since the last one, so each cancel pays O(1).
+		unsigned long canceled = static_cast<unsigned long>(canceled_count - purged_canceled_count_);
+		if (canceled == 0 || canceled < delayed_work_queue_->size() / 4) {
+			return;
+		}
+		purged_canceled_count_ = canceled_count;
+		Task *task = delayed_work_queue_->TakeCanceled();
+		while (task != nullptr) {
+			Task *next = task->next();
+			delete task;
+			task = next;
+		}
+	}
+
+	TimeTicks MessageLoop::GetWakeupTime(TimeTicks next_time) {
+		if (next_time.IsNull()) {
+			return next_time;
+		}
+		TimeSpan leeway = delayed_work_queue_->NextLeeway();
+		if (leeway < timer_slack_) {
+			leeway = timer_slack_;
+		}
+		// Wake up at the roundest millisecond within the leeway, the one which is a multiple of the
+		// greatest power of 2. The loops and the tasks whose windows overlap tend to pick the same one.
+		int64_t earliest = (next_time - TimeTicks()).ToMillisecondsRoundedsUp();
+		int64_t latest = (next_time + leeway - TimeTicks()).ToMilliseconds();
+		if (latest <= earliest) {
+			return next_time;
+		}
+		int64_t granularity = 1;
+		while (granularity * 2 <= latest) {
+			granularity *= 2;
+		}
+		for (; granularity > 1; granularity /= 2) {
+			int64_t wakeup = latest / granularity * granularity;
+			if (wakeup >= earliest) {
+				return TimeTicks() + TimeSpan::FromMilliseconds(wakeup);
+			}
+		}
+		return TimeTicks() + TimeSpan::FromMilliseconds(latest);
+	}
+
 	bool MessageLoop::DoIdleWork() {
 		//TODO(tangjie): add nestable task process.
 		if (state_->quit_received_) {
 			pump_->Quit();
+			return false;
+		}
+		ReloadIdleQueue();
+		// a task posted meanwhile goes first.
+		if (idle_head_ == nullptr || !incoming_queue_.empty()) {
+			return false;
+		}
+		TimeTicks now = TimeTicks::Now();
+		TimeTicks deadline = now + TimeSpan::FromMilliseconds(kMaxIdlePeriodMs);
+		TimeTicks next_time = delayed_work_queue_->NextRunTime();
+		if (!next_time.IsNull() && next_time < deadline) {
+			deadline = next_time;
 		}
-		return false;
+		if (!(now < deadline)) {
+			return false;
+		}
+		IdleTask *task = static_cast<IdleTask*>(idle_head_);
+		idle_head_ = task->next();
+		if (idle_head_ == nullptr) {
+			idle_tail_ = nullptr;
+		}
+		task->set_next(nullptr);
+		task->set_deadline(deadline);
+		RunTask(task);
+		// go round the loop again, the idle task may have posted work or there may be another one.
+		return true;
 	}
 
-	bool MessageLoop::DeferOrRunPendingTask(const PendingTask& task) {
+	bool MessageLoop::DeferOrRunPendingTask(Task *task) {
 		//TODO(tangjie): add nestable task process.
 		RunTask(task);
 		return true;
 	}
 
-	bool MessageLoop::RunTask(const PendingTask &task) {
-		PendingTask pending_task = task;
-		PreProcessTask();
-		pending_task.task_->Run();
-		PostPrecessTask();
+	bool MessageLoop::RunTask(Task *task) {
+		if (!task->IsCanceled()) {
+			if (collect_task_timing_) {
+				RunTaskWithTiming(task);
+			}else {
+				PreProcessTask(*task);
+				task->Run();
+				PostPrecessTask(*task);
+			}
+		}
+		task->Retire();
+		++run_count_;
 		return true;
 	}
 
+	void MessageLoop::RunTaskWithTiming(Task *task) {
+		TimeTicks start_time = TimeTicks::HightResolutionNow();
+		TimeSpan queueing;
+		if (!task->delayed_run_time().IsNull()) {
+			// the delayed run time comes from the other clock.
+			queueing = TimeTicks::Now() - task->delayed_run_time();
+		}else if (!task->post_time().IsNull()) {
+			queueing = start_time - task->post_time();
+		}
+		if (queueing < TimeSpan()) {
+			queueing = TimeSpan();
+		}
+		TimeTicks thread_start_time = TimeTicks::ThreadNow();
+		PreProcessTask(*task);
+		task->Run();
+		PostPrecessTask(*task);
+		TimeSpan cpu = TimeTicks::ThreadNow() - thread_start_time;
+		task_timing_collector_->Record(task->posted_from(), queueing, TimeTicks::HightResolutionNow() - start_time, cpu);
+	}
+
 	void MessageLoop::ReloadWorkQueue() {
-		if (!work_queue_.empty()) {
+		if (incoming_queue_.empty()) {
 			return;
 		}
-		{
-			AutoLock lock(incoming_queue_lock_);
-			if (incoming_queue_.empty()) {
-				return;
+		TimeTicks next_time = delayed_work_queue_->NextRunTime();
+		bool delayed = false;
+		Task *task = incoming_queue_.PopAll();
+		while (task != nullptr) {
+			Task *next = task->next();
+			if (!task->delayed_run_time().IsNull()) {
+				AddToDelayedQueue(task);
+				delayed = true;
+			}else {
+				AddToWorkLane(task);
+			}
+			task = next;
+		}
+		if (overload_policy_ == kDropOldestBestEffort && capacity_ != 0) {
+			DropBestEffortTasks();
+		}
+		// if the tasks make the delayed queue due earlier. need to schedule delay work.
+		if (delayed) {
+			TimeTicks new_next_time = delayed_work_queue_->NextRunTime();
+			if (next_time.IsNull() || new_next_time < next_time) {
+				pump_->ScheduleDelayWork(GetWakeupTime(new_next_time));
 			}
-			incoming_queue_.Swap(&work_queue_);
-			assert(incoming_queue_.empty());
 		}
 	}
 
+	void MessageLoop::ReloadIdleQueue() {
+		if (idle_incoming_queue_.empty()) {
+			return;
+		}
+		Task *task = idle_incoming_queue_.PopAll();
+		if (idle_tail_ != nullptr) {
+			idle_tail_->set_next(task);
+		}else {
+			idle_head_ = task;
+		}
+		while (task->next() != nullptr) {
+			task = task->next();
+		}
+		idle_tail_ = task;
+	}
+
+	TaskBatch::~TaskBatch() {
+		while (newest_ != nullptr) {
+			Task *next = newest_->next();
+			delete newest_;
+			newest_ = next;
+		}
+	}
+
+	void TaskBatch::Add(std::unique_ptr<Task> task, int64_t delay_ms, TaskPriority priority) {
+		if (task == nullptr) {
+			return;
+		}
+		task->set_delayed_run_time(MessageLoop::CalculateDelayedRuntime(delay_ms));
+		task->set_priority(priority);
+		task->set_next(newest_);
+		newest_ = task.release();
+		if (oldest_ == nullptr) {
+			oldest_ = newest_;
+		}
+		++size_;
+	}
+
+	bool TaskBatch::Flush(MessageLoop *loop) {
+		return loop->PostTasks(this);
+	}
+
 	MessageLoop::AutoRunState::AutoRunState(MessageLoop *loop) : loop_(loop) {
 		//TODO(tangjie): add nestable task process.
 		prevous_state_ = loop_->state_;
@@ -258,6 +876,7 @@ namespace base {
 		}
 		loop_->state_ = this;
 		quit_received_ = false;
+		quit_now_ = false;
 		dispatcher_ = nullptr;
 	}
 
@@ -265,22 +884,4 @@ namespace base {
 		loop_->state_ = prevous_state_;
 	}
 
-	MessageLoop::PendingTask::PendingTask(std::shared_ptr<Task> task, TimeTicks delayed_run_time) : task_(task), delayed_run_time_(delayed_run_time) {
-
-	}
-
-	MessageLoop::PendingTask::~PendingTask() {
-
-	}
-
-	bool MessageLoop::PendingTask::operator<(const PendingTask &other) const {
-		if (delayed_run_time_ > other.delayed_run_time_) {
-			return true;
-		}
-		if (delayed_run_time_ < other.delayed_run_time_) {
-			return false;
-		}
-		return sequence_num_ > other.sequence_num_;
-	}
-
 }
\ No newline at end of file
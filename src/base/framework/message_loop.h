@@ -4,19 +4,59 @@
 #ifndef BASE_FRAMEWORK_MESSAGE_LOOP_H__
 #define BASE_FRAMEWORK_MESSAGE_LOOP_H__
 
-#include <queue>
+#include <vector>
 #include "base/base_types.h"
+#include "base/framework/delayed_task_queue.h"
 #include "base/framework/observer_list.h"
 #include "base/framework/task.h"
+#include "base/framework/task_timing.h"
 #include "base/framework/message_pump_default.h"
+#include "base/framework/message_pump_io.h"
 #include "base/framework/message_pump_ui.h"
-#include "base/synchronization/lock.h"
+#include "base/synchronization/mpsc_queue.h"
 #include "base/util/noncopyable.h"
 
 namespace base {
+	class MessageLoop;
 	class UIMessageLoop;
 	class IOMessageLoop;
+	class WaitableEvent;
 	typedef UIMessagePump::Dispatcher Dispatcher;
+
+	// A producer collects a burst of tasks into a TaskBatch and posts them to a loop at once, the loop
+	// is woken up at most one time for the whole batch. A TaskBatch is used by one thread only.
+	// For example,
+	// base::TaskBatch batch;
+	// for (...) {
+	//     batch.Add(base::MakeRunnableMethod(...));
+	// }
+	// batch.Flush(loop);
+	class TaskBatch : public noncopyable {
+	public:
+		TaskBatch() : newest_(nullptr), oldest_(nullptr), size_(0) {
+		}
+
+		// The tasks which were never flushed are deleted.
+		~TaskBatch();
+		void Add(std::unique_ptr<Task> task, int64_t delay_ms = 0, TaskPriority priority = kNormalPriority);
+		// Return false if the loop rejected the tasks, see MessageLoop::SetCapacity.
+		bool Flush(MessageLoop *loop);
+		size_t size() const {
+			return size_;
+		}
+
+		bool empty() const {
+			return size_ == 0;
+		}
+
+	private:
+		friend class MessageLoop;
+		// The tasks are linked from the newest one to the oldest one, the order MpscQueue::PushList wants.
+		Task *newest_;
+		Task *oldest_;
+		size_t size_;
+	};
+
 	class MessageLoop : public MessagePump::Delegate, public noncopyable {
 	public:
 		enum MessageLoopType {
@@ -25,6 +65,56 @@ namespace base {
 			kIOMessageLoop
 		};
 
+		// How the lanes share the loop when the higher ones never run out of tasks.
+		enum StarvationPolicy {
+			// Each lane may run as many tasks as its weight before the lower lanes get their turn.
+			kWeightedRoundRobin,
+			// The higher lanes go first, but the first task of a lower lane runs as soon as the loop has
+			// run the aging limit of tasks since it entered the lane.
+			kAging
+		};
+
+		// The queueing delay of the tasks which ran from a lane, from being posted to being run.
+		struct LaneStats {
+			LaneStats() : task_count_(0), total_delay_us_(0), max_delay_us_(0) {
+			}
+
+			int64_t task_count_;
+			int64_t total_delay_us_;
+			int64_t max_delay_us_;
+		};
+
+		// What a post does when the tasks which wait to run have reached the capacity of the loop.
+		enum OverloadPolicy {
+			// Wait until the loop has run enough of them. A post from the loop thread itself never waits.
+			kBlockProducer,
+			// Delete the task and return false.
+			kRejectTask,
+			// Take the task, the loop deletes its oldest best effort tasks to get back to the capacity. The
+			// other tasks are never dropped.
+			kDropOldestBestEffort
+		};
+
+		struct QueueStats {
+			QueueStats() : pending_count_(0), high_water_mark_(0), rejected_count_(0), blocked_count_(0), dropped_count_(0) {
+			}
+
+			// The tasks which wait to run now, and the most there have been.
+			int64_t pending_count_;
+			int64_t high_water_mark_;
+			int64_t rejected_count_;
+			// The posts which had to wait.
+			int64_t blocked_count_;
+			int64_t dropped_count_;
+		};
+
+		enum DelayedQueueType {
+			// A binary heap, exact to the microsecond.
+			kHeapDelayedQueue,
+			// A hierarchical timing wheel with a resolution of 1ms, see timing_wheel.h.
+			kTimingWheelDelayedQueue
+		};
+
 		explicit MessageLoop(MessageLoopType type = kDefaultMessageLoop);
 		virtual ~MessageLoop();
 		static MessageLoop* current();
@@ -42,28 +132,111 @@ namespace base {
 		void AddDestructionObserver(DestructionObserver *observer);
 		void RemoveDestructionObserver(DestructionObserver *observer);
 
+		// The observers see the task which is running, its posted_from() tells where it came from.
 		class TaskObserver {
 		public:
-			virtual void PreProcessTask();
-			virtual void PostPrecessTask();
+			virtual void PreProcessTask(const Task &task);
+			virtual void PostPrecessTask(const Task &task);
 		protected:
 			virtual ~TaskObserver();
 		};
 		void AddTaskObserver(TaskObserver *observer);
 		void RemoveTaskObserver(TaskObserver *observer);
-		void PreProcessTask();
-		void PostPrecessTask();
+		void PreProcessTask(const Task &task);
+		void PostPrecessTask(const Task &task);
 		void Run();
 		void RunAllPending();
 		void RunInternal();
 		void Quit();
 		void QuitNow();
-		void PostTask(std::shared_ptr<Task> task);
-		void PostDelayTask(std::shared_ptr<Task> task, int64_t delay_ms);
+		// The loop takes the ownership of the task, it will be deleted after it runs or when the loop
+		// is destructed. Return false if the loop rejected the task, it is deleted then, see SetCapacity.
+		bool PostTask(std::unique_ptr<Task> task);
+		bool PostDelayTask(std::unique_ptr<Task> task, int64_t delay_ms);
+		bool PostTask(std::unique_ptr<Task> task, TaskPriority priority);
+		bool PostDelayTask(std::unique_ptr<Task> task, int64_t delay_ms, TaskPriority priority);
+		// The same as above, and the task remembers from_here, which should be FROM_HERE.
+		bool PostTask(const Location &from_here, std::unique_ptr<Task> task);
+		bool PostDelayTask(const Location &from_here, std::unique_ptr<Task> task, int64_t delay_ms);
+		bool PostTask(const Location &from_here, std::unique_ptr<Task> task, TaskPriority priority);
+		// Post a task which carries on work the loop has taken already, like a suspended coroutine, and
+		// must not be lost to the overload policy. It counts against the capacity, but it is never rejected
+		// and the poster never waits.
+		void PostContinuation(const Location &from_here, std::unique_ptr<Task> task, int64_t delay_ms);
+		// The task may run up to leeway_ms after its delay, so the loop can wake up once for it and
+		// the other tasks due around the same time.
+		bool PostDelayTaskWithLeeway(std::unique_ptr<Task> task, int64_t delay_ms, int64_t leeway_ms);
+		// Post all the tasks of the batch in their order with one atomic operation and at most one
+		// wakeup of the loop, the batch is empty after that. The batch is taken or rejected as a whole.
+		bool PostTasks(TaskBatch *batch);
+		bool PostTasks(std::vector<std::unique_ptr<Task>> tasks);
+		// Run |task| on this loop, then run |reply| on the loop of the calling thread. Both of them travel in
+		// one relay task, which is the only allocation, and |task| is deleted on this loop. The relay holds a
+		// plain pointer to the loop of the caller, so that loop must outlive the run of |task|. A relay which
+		// is still in the queue of a loop when the loop is destructed is deleted there with both halves, and so
+		// is a reply which the loop of the caller rejects, see SetCapacity.
+		// See future.h for getting a result back.
+		bool PostTaskAndReply(const Location &from_here, std::unique_ptr<Task> task, std::unique_ptr<Task> reply);
+		// Run |task| in any gap of the loop, when it has no task to run now. The task gets the time of the
+		// next delayed task as its deadline, clipped to kMaxIdlePeriodMs from now, so a short gap gives a
+		// short deadline, and the loop checks for the other tasks between two idle tasks. Can be called on
+		// any thread. The idle tasks do not keep the loop running, RunAllPending and Quit leave them pending.
+		void PostIdleTask(std::unique_ptr<IdleTask> task);
+		void PostIdleTask(const Location &from_here, std::unique_ptr<IdleTask> task);
+		// The longest time given to an idle task, so the tasks posted meanwhile wait no longer than that.
+		static const int64_t kMaxIdlePeriodMs = 50;
+		// Change the structure which holds the delayed tasks, the pending ones are moved into the new one.
+		void SetDelayedQueueType(DelayedQueueType type);
+		DelayedQueueType delayed_queue_type() const {
+			return delayed_queue_type_;
+		}
+
+		// The functions below can only be called on the loop thread. The default policy is weighted
+		// round robin with the weights 16, 4 and 1, the default aging limit is 64 tasks.
+		void SetStarvationPolicy(StarvationPolicy policy);
+		void SetLaneWeight(TaskPriority priority, int weight);
+		void SetAgingLimit(int task_count);
+		// Let DoWork run up to |max_tasks| tasks, and no longer than |budget_us| if it is not 0, before the loop
+		// looks at its delayed tasks, its IO and its idle tasks again. 1 task by default, which keeps the timers
+		// and the IO the most precise, a larger batch saves their checks for a loop which runs many small tasks.
+		// The budget costs a clock reading for each task.
+		void SetWorkBatch(int max_tasks, int64_t budget_us);
+		// Let a default loop spin for posted tasks up to |spin_us| before it goes to sleep, see
+		// message_pump_default.h. It saves the wakeup of a loop which gets its tasks a few microseconds apart, at
+		// the cost of a busy core. 0, the default, turns it off.
+		void SetPollingMode(int64_t spin_us);
+		// Collecting the queueing delay costs a clock reading for each task, so it is off by default.
+		void EnableLaneStats(bool enable);
+		// The least leeway of all the delayed tasks of the loop, 0 by default.
+		void SetTimerSlack(int64_t slack_ms);
+		// Aggregate the timing of the tasks by where they were posted from, see task_timing.h. It costs
+		// three clock readings for each task, so it is off by default. Can be called on any thread, and so
+		// can the collector.
+		void EnableTaskTiming(bool enable);
+		TaskTimingCollector* task_timing_collector() const {
+			return task_timing_collector_.get();
+		}
+
+		// Bound the tasks which wait to run, so an overloaded loop sheds load by the policy instead of
+		// growing without limit. Only the tasks without delay count, and a batch may go over the capacity
+		// once it is taken. 0 means no bound, the default. Can be called on any thread, and so can
+		// queue_stats().
+		void SetCapacity(size_t capacity, OverloadPolicy policy);
+		QueueStats queue_stats() const;
+
+		MessagePump::WakeupStats wakeup_stats() const;
+		// Only for a default loop.
+		DefaultMessagePump::SpinStats spin_stats() const;
+		LaneStats lane_stats(TaskPriority priority) const;
+		void ResetLaneStats();
 	protected:
+		friend class TaskBatch;
+
 		struct RunState {
 			int run_depth_;
 			bool quit_received_;
+			// QuitNow was called, DoWork stops its batch.
+			bool quit_now_;
 			Dispatcher *dispatcher_;
 		};
 
@@ -76,45 +249,91 @@ namespace base {
 			RunState *prevous_state_;
 		};
 
-		struct PendingTask {
-			PendingTask(std::shared_ptr<Task> task, TimeTicks delayed_run_time);
-			~PendingTask();
-			bool operator<(const PendingTask &other) const;
-			std::shared_ptr<Task> task_;
-			int sequence_num_;
-			TimeTicks delayed_run_time_;
-		};
-
-		class TaskQueue : public std::queue<PendingTask> {
-		public:
-			void Swap(TaskQueue *queue) {
-				c.swap(queue->c);
-			}
-		};
-
-		typedef std::priority_queue<PendingTask> DelayedTaskQueue;
-		TimeTicks CalculateDelayedRuntime(int64_t delay_ms);
+		static TimeTicks CalculateDelayedRuntime(int64_t delay_ms);
 		virtual bool DoWork();
 		virtual bool DoDelayWork(TimeTicks *next_delayed_work_time);
 		virtual bool DoIdleWork();
 		bool DeletePendingTasks();
-		void AddToIncomingQueue(const PendingTask &task);
-		void AddToDelayedQueue(const PendingTask &task);
+		// Count |count| more tasks without delay against the capacity, or wait, or return false by the policy.
+		// The policy is not applied to the tasks which are not |bounded|.
+		bool AdmitTasks(LONG count, bool bounded);
+		bool PostDelayTaskInternal(std::unique_ptr<Task> task, int64_t delay_ms, TaskPriority priority, bool bounded);
+		void UpdateHighWaterMark(LONG pending);
+		// Called on the loop thread for each task without delay which leaves the lanes.
+		void OnTaskTaken();
+		// See kDropOldestBestEffort.
+		void DropBestEffortTasks();
+		void AddToIncomingQueue(Task *task);
+		void AddToDelayedQueue(Task *task);
+		void AddToWorkLane(Task *task);
+		// Move the tasks from the incoming queue into the lanes and the delayed queue.
 		void ReloadWorkQueue();
-		bool DeferOrRunPendingTask(const PendingTask& task);
-		bool RunTask(const PendingTask &task);
+		void ReloadIdleQueue();
+		// Take the task to run next from the lanes according to the starvation policy.
+		Task* TakeWork();
+		void RecordQueueingDelay(Task *task);
+		void RunTaskWithTiming(Task *task);
+		// Delete the canceled tasks of the delayed queue once there may be enough of them.
+		void PurgeCanceledTasks();
+		// Choose the time to wake up for the delayed task due at next_time, see SetTimerSlack.
+		TimeTicks GetWakeupTime(TimeTicks next_time);
+		// The functions below take the ownership of the task.
+		bool DeferOrRunPendingTask(Task *task);
+		bool RunTask(Task *task);
+		struct WorkLane {
+			WorkLane() : head_(nullptr), tail_(nullptr), weight_(1), credit_(0) {
+			}
+
+			// The tasks in FIFO order, linked by Task::next().
+			Task *head_;
+			Task *tail_;
+			int weight_;
+			int credit_;
+			LaneStats stats_;
+		};
 	protected:
 		MessageLoopType type_;
 		RunState *state_;
 		std::shared_ptr<MessagePump> pump_;
 		std::shared_ptr<ObserverList<DestructionObserver>> destruction_observers_;
 		std::shared_ptr<ObserverList<TaskObserver>> task_observers_;
-		TaskQueue incoming_queue_;
-		TaskQueue work_queue_;
-		DelayedTaskQueue delayed_work_queue_;
+		// Tasks posted from any thread, the loop takes them all away at once and sorts them into the lanes.
+		MpscQueue<Task> incoming_queue_;
+		WorkLane work_lanes_[kTaskPriorityCount];
+		// The idle tasks posted from any thread, and the ones the loop has taken, in FIFO order.
+		MpscQueue<Task> idle_incoming_queue_;
+		Task *idle_head_;
+		Task *idle_tail_;
+		StarvationPolicy starvation_policy_;
+		int aging_limit_;
+		int work_batch_size_;
+		TimeSpan work_batch_budget_;
+		// The number of tasks the loop has run, the tasks in the lanes are stamped with it for aging.
+		int run_count_;
+		// Read by the posting threads.
+		volatile bool collect_lane_stats_;
+		volatile bool collect_task_timing_;
+		std::shared_ptr<TaskTimingCollector> task_timing_collector_;
+		DelayedQueueType delayed_queue_type_;
+		std::shared_ptr<DelayedTaskQueue> delayed_work_queue_;
 		int next_sequence_num_;
+		TimeSpan timer_slack_;
+		// The tasks without delay posted and taken away from the lanes, the difference is what waits to run.
+		// The taken count is only written by the loop thread.
+		volatile LONG posted_count_;
+		volatile LONG taken_count_;
+		volatile LONG capacity_;
+		volatile OverloadPolicy overload_policy_;
+		volatile LONG high_water_mark_;
+		volatile LONG rejected_count_;
+		volatile LONG blocked_count_;
+		volatile LONG dropped_count_;
+		volatile LONG waiting_producers_;
+		// Signaled when a task is taken while producers wait.
+		std::shared_ptr<WaitableEvent> space_available_;
+		// internal::CanceledCount() at the last purge.
+		LONG purged_canceled_count_;
 		TimeTicks recent_time_;
-		LockImpl incoming_queue_lock_;
 	};
 
 	class UIMessageLoop : public MessageLoop {
@@ -139,6 +358,51 @@ namespace base {
 			return down_cast<UIMessagePump*>(pump_.get());
 		}
 	};
+
+	// The functions below can only be called on the loop thread, see message_pump_io.h.
+	class IOMessageLoop : public MessageLoop {
+	public:
+		typedef IOMessagePump::IOHandler IOHandler;
+		typedef IOMessagePump::IOContext IOContext;
+		typedef IOMessagePump::IOObserver IOObserver;
+		typedef IOMessagePump::Watcher Watcher;
+		typedef IOMessagePump::SocketWatcher SocketWatcher;
+		typedef IOMessagePump::WatchMode WatchMode;
+		IOMessageLoop() : MessageLoop(kIOMessageLoop) {
+		}
+
+		static IOMessageLoop* current() {
+			return down_cast<IOMessageLoop*>(MessageLoop::current());
+		}
+
+		bool RegisterIOHandler(HANDLE handle, IOHandler *handler, bool skip_completion_on_success = false) {
+			return GetPump()->RegisterIOHandler(handle, handler, skip_completion_on_success);
+		}
+
+		bool WaitForIOCompletion(DWORD time_out, IOHandler *filter) {
+			return GetPump()->WaitForIOCompletion(time_out, filter);
+		}
+
+		bool WatchSocket(SOCKET socket, bool persistent, WatchMode mode, SocketWatcher *controller, Watcher *watcher) {
+			return GetPump()->WatchSocket(socket, persistent, mode, controller, watcher);
+		}
+
+		IOMessagePump::IOStats io_stats() const {
+			return down_cast<IOMessagePump*>(pump_.get())->io_stats();
+		}
+
+		void AddIOObserver(IOObserver *observer) {
+			GetPump()->AddIOObserver(observer);
+		}
+
+		void RemoveIOObserver(IOObserver *observer) {
+			GetPump()->RemoveIOObserver(observer);
+		}
+	protected:
+		IOMessagePump* GetPump() {
+			return down_cast<IOMessagePump*>(pump_.get());
+		}
+	};
 }
 
 #endif //BASE_FRAMEWORK_MESSAGE_LOOP_H__
\ No newline at end of file
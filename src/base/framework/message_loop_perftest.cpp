@@ -0,0 +1,340 @@
+#include <stdlib.h>
+#include <algorithm>
+#include <sstream>
+#include <vector>
+#include "base/framework/message_loop.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/test/perf_reporter.h"
+#include "base/test/test_with_exit_manager.h"
+#include "base/thread/thread.h"
+
+using base::MessageLoop;
+using base::Thread;
+using base::WaitableEvent;
+
+namespace {
+	class Counter {
+	public:
+		Counter(LONG total, WaitableEvent *done) : count_(0), total_(total), done_(done) {
+		}
+
+		void Increase() {
+			if (InterlockedIncrement(&count_) == total_) {
+				done_->Signal();
+			}
+		}
+
+	private:
+		volatile LONG count_;
+		LONG total_;
+		WaitableEvent *done_;
+	};
+
+	class Producer {
+	public:
+		Producer(MessageLoop *target, Counter *counter, WaitableEvent *start, int count)
+			: target_(target), counter_(counter), start_(start), count_(count) {
+		}
+
+		void Produce() {
+			start_->Wait();
+			for (int i = 0; i < count_; ++i) {
+				target_->PostTask(base::MakeRunnableMethod(counter_, &Counter::Increase));
+			}
+		}
+
+		void ProduceBatches() {
+			start_->Wait();
+			base::TaskBatch batch;
+			for (int i = 0; i < count_; ++i) {
+				batch.Add(base::MakeRunnableMethod(counter_, &Counter::Increase));
+				if (batch.size() == kBatchSize) {
+					batch.Flush(target_);
+				}
+			}
+			batch.Flush(target_);
+		}
+
+		void ProduceBestEffort() {
+			start_->Wait();
+			for (int i = 0; i < count_; ++i) {
+				target_->PostTask(base::MakeRunnableMethod(counter_, &Counter::Increase), base::kBestEffortPriority);
+			}
+		}
+
+		static const size_t kBatchSize = 256;
+
+	private:
+		MessageLoop *target_;
+		Counter *counter_;
+		WaitableEvent *start_;
+		int count_;
+	};
+
+	void Nothing() {
+	}
+
+	void ReportLaneStats(WaitableEvent *reported) {
+		const char *kNames[] = {"high", "normal", "best effort"};
+		MessageLoop *loop = MessageLoop::current();
+		for (int i = 0; i < base::kTaskPriorityCount; ++i) {
+			MessageLoop::LaneStats stats = loop->lane_stats(static_cast<base::TaskPriority>(i));
+			std::cout << kNames[i] << " lane: " << stats.task_count_ << " tasks";
+			if (stats.task_count_ > 0) {
+				std::cout << ", average delay " << stats.total_delay_us_ / stats.task_count_ << "us, max delay " << stats.max_delay_us_ << "us";
+			}
+			std::cout << std::endl;
+		}
+		reported->Signal();
+	}
+
+	void ReportWakeups(int64_t slack_ms, WaitableEvent *reported) {
+		base::MessagePump::WakeupStats stats = MessageLoop::current()->wakeup_stats();
+		std::cout << "timer slack " << slack_ms << "ms: " << stats.timer_wakeups_ << " timer wakeups, "
+			<< stats.work_wakeups_ << " work wakeups" << std::endl;
+		reported->Signal();
+	}
+
+	// Pings bounce between two loops, many of them at once, so each loop finds several tasks to run.
+	class Pinger {
+	public:
+		Pinger(MessageLoop *first, MessageLoop *second, LONG total, WaitableEvent *done)
+			: first_(first), second_(second), count_(0), total_(total), done_(done) {
+		}
+
+		void Bounce() {
+			LONG count = InterlockedIncrement(&count_);
+			if (count == total_) {
+				done_->Signal();
+			}
+			if (count < total_) {
+				MessageLoop *other = MessageLoop::current() == first_ ? second_ : first_;
+				other->PostTask(base::MakeRunnableMethod(this, &Pinger::Bounce));
+			}
+		}
+
+	private:
+		MessageLoop *first_;
+		MessageLoop *second_;
+		volatile LONG count_;
+		LONG total_;
+		WaitableEvent *done_;
+	};
+
+	void RunPings(int max_tasks, int64_t budget_us) {
+		const LONG kTotalPings = 1 << 20;
+		const int kPingsInFlight = 64;
+		Thread first;
+		Thread second;
+		first.Start();
+		second.Start();
+		first.message_loop()->PostTask(base::MakeRunnableMethod(first.message_loop(), &MessageLoop::SetWorkBatch, max_tasks, budget_us));
+		second.message_loop()->PostTask(base::MakeRunnableMethod(second.message_loop(), &MessageLoop::SetWorkBatch, max_tasks, budget_us));
+		WaitableEvent done(false, false);
+		Pinger pinger(first.message_loop(), second.message_loop(), kTotalPings, &done);
+		std::stringstream name;
+		name << "ping with a work batch of " << max_tasks << " tasks";
+		if (budget_us > 0) {
+			name << " within " << budget_us << "us";
+		}
+		std::string watch_name = name.str();
+		base::PerfReporter reporter(kTotalPings);
+		base::StopWatch watch(base::StringPiece(watch_name), &reporter);
+		watch.Start();
+		for (int i = 0; i < kPingsInFlight; ++i) {
+			first.message_loop()->PostTask(base::MakeRunnableMethod(&pinger, &Pinger::Bounce));
+		}
+		done.Wait();
+		watch.Stop();
+		watch.Report();
+		second.Stop();
+		first.Stop();
+	}
+
+	// One ping bounces between two loops, so each hop finds the other loop waiting for it.
+	class PingPong {
+	public:
+		PingPong(MessageLoop *first, MessageLoop *second, int total, WaitableEvent *done)
+			: first_(first), second_(second), total_(total), done_(done) {
+			latencies_.reserve(total);
+		}
+
+		void Send() {
+			MessageLoop *other = MessageLoop::current() == first_ ? second_ : first_;
+			sent_ = base::TimeTicks::HightResolutionNow();
+			other->PostTask(base::MakeRunnableMethod(this, &PingPong::Receive));
+		}
+
+		void Receive() {
+			latencies_.push_back((base::TimeTicks::HightResolutionNow() - sent_).ToMicroseconds());
+			if (static_cast<int>(latencies_.size()) == total_) {
+				done_->Signal();
+			}else {
+				Send();
+			}
+		}
+
+		// Only after done.
+		int64_t Percentile(int percent) {
+			std::sort(latencies_.begin(), latencies_.end());
+			return latencies_[(latencies_.size() - 1) * percent / 100];
+		}
+
+	private:
+		MessageLoop *first_;
+		MessageLoop *second_;
+		int total_;
+		WaitableEvent *done_;
+		base::TimeTicks sent_;
+		std::vector<int64_t> latencies_;
+	};
+
+	void ReportSpinStats(WaitableEvent *reported) {
+		base::DefaultMessagePump::SpinStats stats = MessageLoop::current()->spin_stats();
+		std::cout << "  " << stats.spin_hits_ << " spin hits, " << stats.parks_ << " parks" << std::endl;
+		reported->Signal();
+	}
+
+	void RunPingPong(int64_t spin_us) {
+		const int kHops = 100000;
+		Thread first;
+		Thread second;
+		first.Start();
+		second.Start();
+		first.message_loop()->PostTask(base::MakeRunnableMethod(first.message_loop(), &MessageLoop::SetPollingMode, spin_us));
+		second.message_loop()->PostTask(base::MakeRunnableMethod(second.message_loop(), &MessageLoop::SetPollingMode, spin_us));
+		WaitableEvent done(false, false);
+		PingPong ping_pong(first.message_loop(), second.message_loop(), kHops, &done);
+		std::stringstream name;
+		name << "ping-pong spinning " << spin_us << "us";
+		std::string watch_name = name.str();
+		base::PerfReporter reporter(kHops);
+		base::StopWatch watch(base::StringPiece(watch_name), &reporter);
+		watch.Start();
+		first.message_loop()->PostTask(base::MakeRunnableMethod(&ping_pong, &PingPong::Send));
+		done.Wait();
+		watch.Stop();
+		watch.Report();
+		std::cout << "  hop latency p50 " << ping_pong.Percentile(50) << "us, p99 " << ping_pong.Percentile(99) << "us" << std::endl;
+		WaitableEvent reported(false, false);
+		second.message_loop()->PostTask(base::MakeRunnableFunction(&ReportSpinStats, &reported));
+		reported.Wait();
+		second.Stop();
+		first.Stop();
+	}
+
+	// Run the producers against one consumer loop and report the throughput.
+	void RunProducers(const std::string &watch_name, int producer_count, int tasks_per_producer, void (Producer::*produce)()) {
+		WaitableEvent start(true, false);
+		WaitableEvent done(false, false);
+		Counter counter(tasks_per_producer * producer_count, &done);
+		Thread consumer;
+		consumer.Start();
+		std::vector<std::shared_ptr<Thread>> threads;
+		std::vector<std::shared_ptr<Producer>> producers;
+		for (int i = 0; i < producer_count; ++i) {
+			producers.push_back(std::shared_ptr<Producer>(new Producer(consumer.message_loop(), &counter, &start, tasks_per_producer)));
+			threads.push_back(std::shared_ptr<Thread>(new Thread()));
+			threads.back()->Start();
+			threads.back()->message_loop()->PostTask(base::MakeRunnableMethod(producers.back().get(), produce));
+		}
+		base::PerfReporter reporter(tasks_per_producer * producer_count);
+		base::StopWatch watch(base::StringPiece(watch_name), &reporter);
+		watch.Start();
+		start.Signal();
+		done.Wait();
+		watch.Stop();
+		watch.Report();
+		for (int i = 0; i < producer_count; ++i) {
+			threads[i]->Stop();
+		}
+		consumer.Stop();
+	}
+}
+
+// Many threads post to one hot loop, the throughput should not collapse as the producers grow.
+TEST_WITH_EM(MessageLoopPerfTest, PostTaskContention) {
+	const int kTotalTasks = 1 << 20;
+	for (int producer_count = 1; producer_count <= 32; producer_count *= 2) {
+		std::stringstream name;
+		name << "PostTask with " << producer_count << " producers";
+		RunProducers(name.str(), producer_count, kTotalTasks / producer_count, &Producer::Produce);
+	}
+}
+
+// The same bursts posted with TaskBatch, one atomic operation and at most one wakeup for each batch.
+TEST_WITH_EM(MessageLoopPerfTest, PostTasksBatched) {
+	const int kTotalTasks = 1 << 20;
+	for (int producer_count = 1; producer_count <= 32; producer_count *= 2) {
+		std::stringstream name;
+		name << "PostTasks of " << Producer::kBatchSize << " with " << producer_count << " producers";
+		RunProducers(name.str(), producer_count, kTotalTasks / producer_count, &Producer::ProduceBatches);
+	}
+}
+
+// The best effort lane is flooded by several producers while a control task is posted to the high lane
+// every millisecond, the queueing delay of the high lane should stay within 100us.
+TEST_WITH_EM(MessageLoopPerfTest, HighLaneLatencyUnderLoad) {
+	const int kProducers = 4;
+	const int kTasksPerProducer = 1 << 18;
+	WaitableEvent start(true, false);
+	WaitableEvent done(false, false);
+	WaitableEvent reported(false, false);
+	Counter counter(kProducers * kTasksPerProducer, &done);
+	Thread consumer;
+	consumer.Start();
+	MessageLoop *loop = consumer.message_loop();
+	loop->PostTask(base::MakeRunnableMethod(loop, &MessageLoop::EnableLaneStats, true));
+	std::vector<std::shared_ptr<Thread>> threads;
+	std::vector<std::shared_ptr<Producer>> producers;
+	for (int i = 0; i < kProducers; ++i) {
+		producers.push_back(std::shared_ptr<Producer>(new Producer(loop, &counter, &start, kTasksPerProducer)));
+		threads.push_back(std::shared_ptr<Thread>(new Thread()));
+		threads.back()->Start();
+		threads.back()->message_loop()->PostTask(base::MakeRunnableMethod(producers.back().get(), &Producer::ProduceBestEffort));
+	}
+	start.Signal();
+	while (!done.WaitForTime(1)) {
+		loop->PostTask(base::MakeRunnableFunction(&Nothing), base::kHighPriority);
+	}
+	loop->PostTask(base::MakeRunnableFunction(&ReportLaneStats, &reported), base::kHighPriority);
+	reported.Wait();
+	for (int i = 0; i < kProducers; ++i) {
+		threads[i]->Stop();
+	}
+	consumer.Stop();
+}
+
+// An idle loop with 1000 timers spread over one second, the wakeups drop as the slack grows.
+TEST_WITH_EM(MessageLoopPerfTest, TimerSlackWakeups) {
+	const int kTimers = 1000;
+	const int64_t kSlacks[] = {0, 4, 16, 64};
+	for (size_t i = 0; i < sizeof(kSlacks) / sizeof(kSlacks[0]); ++i) {
+		WaitableEvent reported(false, false);
+		Thread thread;
+		thread.Start();
+		MessageLoop *loop = thread.message_loop();
+		loop->PostTask(base::MakeRunnableMethod(loop, &MessageLoop::SetTimerSlack, kSlacks[i]));
+		srand(1);
+		for (int j = 0; j < kTimers; ++j) {
+			loop->PostDelayTask(base::MakeRunnableFunction(&Nothing), rand() % 1000);
+		}
+		loop->PostDelayTask(base::MakeRunnableFunction(&ReportWakeups, kSlacks[i], &reported), 1000);
+		reported.Wait();
+		thread.Stop();
+	}
+}
+
+// DoWork runs a batch of tasks before the loop checks its timers and IO again.
+TEST_WITH_EM(MessageLoopPerfTest, PingWorkBatch) {
+	RunPings(1, 0);
+	RunPings(16, 0);
+	RunPings(64, 0);
+	RunPings(64, 200);
+}
+
+// The hop latency of a loop which sleeps at once, and of one which spins for the next task first.
+TEST_WITH_EM(MessageLoopPerfTest, PingPongPolling) {
+	RunPingPong(0);
+	RunPingPong(50);
+}
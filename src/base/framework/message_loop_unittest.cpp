@@ -0,0 +1,464 @@
+#include <vector>
+#include "base/framework/message_loop.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/test/test_tasks.h"
+#include "base/thread/thread.h"
+#include "base/test/test_with_exit_manager.h"
+
+using base::MessageLoop;
+using base::TaskBatch;
+using base::Thread;
+using base::WaitableEvent;
+using base::test::Block;
+
+namespace {
+	// Recorded for an idle task.
+	const int kIdleId = 100;
+
+	// Records the ids of the tasks in the order they run on the loop thread.
+	class Recorder : public base::test::Recorder {
+	public:
+		void RecordOnTime(int id, base::TimeTicks run_time) {
+			if (base::TimeTicks::Now() >= run_time) {
+				Record(id);
+			}
+		}
+
+		void RecordSlowly(int id, int64_t sleep_ms) {
+			Record(id);
+			base::ThreadHelper::Sleep(sleep_ms);
+		}
+
+		// Records the time left to the deadline.
+		void RecordIdle(base::TimeTicks deadline) {
+			Record(kIdleId);
+			idle_budgets_.push_back(deadline - base::TimeTicks::Now());
+		}
+
+		void CopyWakeupStats(base::MessagePump::WakeupStats *stats) {
+			*stats = MessageLoop::current()->wakeup_stats();
+		}
+
+		void EnableLaneStats(WaitableEvent *enabled) {
+			MessageLoop::current()->EnableLaneStats(true);
+			enabled->Signal();
+		}
+
+		void CopyLaneStats(base::TaskPriority priority, MessageLoop::LaneStats *stats) {
+			*stats = MessageLoop::current()->lane_stats(priority);
+		}
+
+		const std::vector<base::TimeSpan>& idle_budgets() const {
+			return idle_budgets_;
+		}
+
+	private:
+		std::vector<base::TimeSpan> idle_budgets_;
+	};
+
+	class Deleted : public base::Task {
+	public:
+		explicit Deleted(int *count) : count_(count) {
+		}
+
+		virtual ~Deleted() {
+			++*count_;
+		}
+
+		virtual void Run() {
+		}
+
+	private:
+		int *count_;
+	};
+}
+
+TEST_WITH_EM(MessageLoop, PostTasksInOrder) {
+	Recorder recorder;
+	Thread thread;
+	thread.Start();
+	TaskBatch batch;
+	EXPECT_TRUE(batch.empty());
+	for (int i = 0; i < 100; ++i) {
+		batch.Add(base::MakeRunnableMethod(&recorder, &Recorder::Record, i));
+	}
+	EXPECT_EQ(100u, batch.size());
+	thread.message_loop()->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Record, -1));
+	batch.Flush(thread.message_loop());
+	EXPECT_TRUE(batch.empty());
+	// an empty batch posts nothing, and is not rejected.
+	EXPECT_TRUE(batch.Flush(thread.message_loop()));
+	std::vector<std::unique_ptr<base::Task>> tasks;
+	for (int i = 100; i < 110; ++i) {
+		tasks.push_back(base::MakeRunnableMethod(&recorder, &Recorder::Record, i));
+	}
+	thread.message_loop()->PostTasks(std::move(tasks));
+	thread.message_loop()->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Done));
+	recorder.Wait();
+	thread.Stop();
+	ASSERT_EQ(111u, recorder.ids().size());
+	for (int i = -1; i < 110; ++i) {
+		EXPECT_EQ(i, recorder.ids()[i + 1]);
+	}
+}
+
+TEST_WITH_EM(MessageLoop, PostTasksWithDelay) {
+	Recorder recorder;
+	Thread thread;
+	thread.Start();
+	TaskBatch batch;
+	batch.Add(base::MakeRunnableMethod(&recorder, &Recorder::Done), 50);
+	batch.Add(base::MakeRunnableMethod(&recorder, &Recorder::Record, 2), 20);
+	batch.Add(base::MakeRunnableMethod(&recorder, &Recorder::Record, 1));
+	batch.Flush(thread.message_loop());
+	recorder.Wait();
+	thread.Stop();
+	ASSERT_EQ(2u, recorder.ids().size());
+	EXPECT_EQ(1, recorder.ids()[0]);
+	EXPECT_EQ(2, recorder.ids()[1]);
+}
+
+TEST(TaskBatch, DeleteUnflushedTasks) {
+	int deleted = 0;
+	{
+		TaskBatch batch;
+		batch.Add(std::unique_ptr<base::Task>(new Deleted(&deleted)));
+		batch.Add(std::unique_ptr<base::Task>(new Deleted(&deleted)), 10);
+	}
+	EXPECT_EQ(2, deleted);
+}
+
+TEST_WITH_EM(MessageLoop, WeightedRoundRobin) {
+	Recorder recorder;
+	WaitableEvent entered(false, false);
+	WaitableEvent release(false, false);
+	Thread thread;
+	thread.Start();
+	MessageLoop *loop = thread.message_loop();
+	// the blocking task takes the first turn of the high lane.
+	loop->PostTask(base::MakeRunnableFunction(&Block, &entered, &release), base::kHighPriority);
+	entered.Wait();
+	for (int i = 0; i < 40; ++i) {
+		loop->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Record, static_cast<int>(base::kBestEffortPriority)), base::kBestEffortPriority);
+		loop->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Record, static_cast<int>(base::kNormalPriority)), base::kNormalPriority);
+		loop->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Record, static_cast<int>(base::kHighPriority)), base::kHighPriority);
+	}
+	loop->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Done), base::kBestEffortPriority);
+	release.Signal();
+	recorder.Wait();
+	thread.Stop();
+	ASSERT_EQ(120u, recorder.ids().size());
+	const int kExpected[][2] = {
+		{base::kHighPriority, 15}, {base::kNormalPriority, 4}, {base::kBestEffortPriority, 1},
+		{base::kHighPriority, 16}, {base::kNormalPriority, 4}, {base::kBestEffortPriority, 1},
+		{base::kHighPriority, 9}, {base::kNormalPriority, 4}
+	};
+	size_t index = 0;
+	for (size_t i = 0; i < sizeof(kExpected) / sizeof(kExpected[0]); ++i) {
+		for (int j = 0; j < kExpected[i][1]; ++j, ++index) {
+			EXPECT_EQ(kExpected[i][0], recorder.ids()[index]);
+		}
+	}
+}
+
+TEST_WITH_EM(MessageLoop, Aging) {
+	Recorder recorder;
+	WaitableEvent entered(false, false);
+	WaitableEvent release(false, false);
+	Thread thread;
+	thread.Start();
+	MessageLoop *loop = thread.message_loop();
+	loop->PostTask(base::MakeRunnableMethod(loop, &MessageLoop::SetStarvationPolicy, MessageLoop::kAging));
+	loop->PostTask(base::MakeRunnableMethod(loop, &MessageLoop::SetAgingLimit, 8));
+	loop->PostTask(base::MakeRunnableFunction(&Block, &entered, &release));
+	entered.Wait();
+	loop->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Record, -1), base::kBestEffortPriority);
+	for (int i = 0; i < 20; ++i) {
+		loop->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Record, i), base::kHighPriority);
+	}
+	loop->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Done), base::kBestEffortPriority);
+	release.Signal();
+	recorder.Wait();
+	thread.Stop();
+	ASSERT_EQ(21u, recorder.ids().size());
+	// the best effort task waits for 8 tasks at most.
+	for (int i = 0; i < 8; ++i) {
+		EXPECT_EQ(i, recorder.ids()[i]);
+	}
+	EXPECT_EQ(-1, recorder.ids()[8]);
+}
+
+TEST_WITH_EM(MessageLoop, LaneStats) {
+	Recorder recorder;
+	WaitableEvent entered(false, false);
+	WaitableEvent release(false, false);
+	MessageLoop::LaneStats high_stats;
+	MessageLoop::LaneStats normal_stats;
+	Thread thread;
+	thread.Start();
+	MessageLoop *loop = thread.message_loop();
+	WaitableEvent enabled(false, false);
+	// the posting thread reads the switch, so the tasks are posted once it is on.
+	loop->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::EnableLaneStats, &enabled));
+	enabled.Wait();
+	loop->PostTask(base::MakeRunnableFunction(&Block, &entered, &release));
+	entered.Wait();
+	for (int i = 0; i < 10; ++i) {
+		loop->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Record, i), base::kHighPriority);
+	}
+	base::ThreadHelper::Sleep(10);
+	release.Signal();
+	loop->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::CopyLaneStats, base::kHighPriority, &high_stats));
+	loop->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::CopyLaneStats, base::kNormalPriority, &normal_stats));
+	loop->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Done));
+	recorder.Wait();
+	thread.Stop();
+	EXPECT_EQ(10, high_stats.task_count_);
+	EXPECT_GE(high_stats.max_delay_us_, 10000);
+	EXPECT_GE(high_stats.total_delay_us_, high_stats.max_delay_us_);
+	// the blocking task and the two copying tasks.
+	EXPECT_EQ(3, normal_stats.task_count_);
+}
+
+// The timers due within 32ms share a few wakeups when they allow 64ms of leeway.
+TEST_WITH_EM(MessageLoop, TimerLeeway) {
+	const int kCount = 32;
+	Recorder recorder;
+	base::MessagePump::WakeupStats stats;
+	Thread thread;
+	thread.Start();
+	MessageLoop *loop = thread.message_loop();
+	base::TimeTicks now = base::TimeTicks::Now();
+	for (int i = 1; i <= kCount; ++i) {
+		base::TimeTicks run_time = now + base::TimeSpan::FromMilliseconds(i);
+		loop->PostDelayTaskWithLeeway(base::MakeRunnableMethod(&recorder, &Recorder::RecordOnTime, i, run_time), i, 64);
+	}
+	loop->PostDelayTaskWithLeeway(base::MakeRunnableMethod(&recorder, &Recorder::CopyWakeupStats, &stats), kCount, 64);
+	loop->PostDelayTaskWithLeeway(base::MakeRunnableMethod(&recorder, &Recorder::Done), kCount, 64);
+	recorder.Wait();
+	thread.Stop();
+	// none of them runs early.
+	EXPECT_EQ(static_cast<size_t>(kCount), recorder.ids().size());
+	EXPECT_LE(stats.timer_wakeups_, 2);
+}
+
+TEST_WITH_EM(MessageLoop, TimerSlack) {
+	const int kCount = 32;
+	Recorder recorder;
+	base::MessagePump::WakeupStats stats;
+	Thread thread;
+	thread.Start();
+	MessageLoop *loop = thread.message_loop();
+	loop->PostTask(base::MakeRunnableMethod(loop, &MessageLoop::SetTimerSlack, 64));
+	base::TimeTicks now = base::TimeTicks::Now();
+	for (int i = 1; i <= kCount; ++i) {
+		base::TimeTicks run_time = now + base::TimeSpan::FromMilliseconds(i);
+		loop->PostDelayTask(base::MakeRunnableMethod(&recorder, &Recorder::RecordOnTime, i, run_time), i);
+	}
+	loop->PostDelayTask(base::MakeRunnableMethod(&recorder, &Recorder::CopyWakeupStats, &stats), kCount);
+	loop->PostDelayTask(base::MakeRunnableMethod(&recorder, &Recorder::Done), kCount);
+	recorder.Wait();
+	thread.Stop();
+	EXPECT_EQ(static_cast<size_t>(kCount), recorder.ids().size());
+	EXPECT_LE(stats.timer_wakeups_, 2);
+}
+
+namespace {
+	void PostRecords(MessageLoop *loop, Recorder *recorder, int count) {
+		for (int i = 0; i < count; ++i) {
+			loop->PostTask(base::MakeRunnableMethod(recorder, &Recorder::Record, i));
+		}
+		loop->PostTask(base::MakeRunnableMethod(recorder, &Recorder::Done));
+	}
+}
+
+TEST_WITH_EM(MessageLoop, CapacityRejectTask) {
+	Recorder recorder;
+	WaitableEvent entered(false, false);
+	WaitableEvent release(false, false);
+	Thread thread;
+	thread.Start();
+	MessageLoop *loop = thread.message_loop();
+	loop->PostTask(base::MakeRunnableFunction(&Block, &entered, &release));
+	entered.Wait();
+	loop->SetCapacity(4, MessageLoop::kRejectTask);
+	for (int i = 0; i < 4; ++i) {
+		EXPECT_TRUE(loop->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Record, i)));
+	}
+	EXPECT_FALSE(loop->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Record, 4)));
+	// delayed tasks do not count.
+	EXPECT_TRUE(loop->PostDelayTask(base::MakeRunnableMethod(&recorder, &Recorder::Record, 5), 10));
+	TaskBatch batch;
+	batch.Add(base::MakeRunnableMethod(&recorder, &Recorder::Record, 6));
+	EXPECT_FALSE(batch.Flush(loop));
+	EXPECT_TRUE(batch.empty());
+	MessageLoop::QueueStats stats = loop->queue_stats();
+	EXPECT_EQ(4, stats.pending_count_);
+	EXPECT_EQ(4, stats.high_water_mark_);
+	EXPECT_EQ(2, stats.rejected_count_);
+	release.Signal();
+	loop->PostDelayTask(base::MakeRunnableMethod(&recorder, &Recorder::Done), 20);
+	recorder.Wait();
+	thread.Stop();
+	ASSERT_EQ(5u, recorder.ids().size());
+	for (int i = 0; i < 5; ++i) {
+		EXPECT_EQ(i == 4 ? 5 : i, recorder.ids()[i]);
+	}
+}
+
+TEST_WITH_EM(MessageLoop, CapacityDropOldestBestEffort) {
+	Recorder recorder;
+	WaitableEvent entered(false, false);
+	WaitableEvent release(false, false);
+	Thread thread;
+	thread.Start();
+	MessageLoop *loop = thread.message_loop();
+	loop->PostTask(base::MakeRunnableFunction(&Block, &entered, &release));
+	entered.Wait();
+	loop->SetCapacity(3, MessageLoop::kDropOldestBestEffort);
+	for (int i = 0; i < 4; ++i) {
+		EXPECT_TRUE(loop->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Record, i), base::kBestEffortPriority));
+	}
+	EXPECT_TRUE(loop->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Record, 10)));
+	EXPECT_TRUE(loop->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Done), base::kBestEffortPriority));
+	EXPECT_EQ(6, loop->queue_stats().high_water_mark_);
+	release.Signal();
+	recorder.Wait();
+	MessageLoop::QueueStats stats = loop->queue_stats();
+	thread.Stop();
+	EXPECT_EQ(3, stats.dropped_count_);
+	EXPECT_EQ(0, stats.pending_count_);
+	ASSERT_EQ(2u, recorder.ids().size());
+	EXPECT_EQ(10, recorder.ids()[0]);
+	EXPECT_EQ(3, recorder.ids()[1]);
+}
+
+TEST_WITH_EM(MessageLoop, CapacityBlockProducer) {
+	const int kCount = 5;
+	Recorder recorder;
+	WaitableEvent entered(false, false);
+	WaitableEvent release(false, false);
+	Thread thread;
+	Thread producer;
+	thread.Start();
+	producer.Start();
+	MessageLoop *loop = thread.message_loop();
+	loop->PostTask(base::MakeRunnableFunction(&Block, &entered, &release));
+	entered.Wait();
+	loop->SetCapacity(2, MessageLoop::kBlockProducer);
+	producer.message_loop()->PostTask(base::MakeRunnableFunction(&PostRecords, loop, &recorder, kCount));
+	Sleep(50);
+	MessageLoop::QueueStats stats = loop->queue_stats();
+	EXPECT_EQ(2, stats.pending_count_);
+	EXPECT_EQ(1, stats.blocked_count_);
+	release.Signal();
+	recorder.Wait();
+	stats = loop->queue_stats();
+	producer.Stop();
+	thread.Stop();
+	EXPECT_EQ(2, stats.high_water_mark_);
+	ASSERT_EQ(static_cast<size_t>(kCount), recorder.ids().size());
+	for (int i = 0; i < kCount; ++i) {
+		EXPECT_EQ(i, recorder.ids()[i]);
+	}
+}
+
+TEST_WITH_EM(MessageLoop, IdleTaskRunsAfterTasks) {
+	Recorder recorder;
+	WaitableEvent entered(false, false);
+	WaitableEvent release(false, false);
+	Thread thread;
+	thread.Start();
+	MessageLoop *loop = thread.message_loop();
+	loop->PostTask(base::MakeRunnableFunction(&Block, &entered, &release));
+	entered.Wait();
+	loop->PostIdleTask(FROM_HERE, base::MakeIdleTask(&recorder, &Recorder::RecordIdle));
+	loop->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Record, 1));
+	loop->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Record, 2));
+	loop->PostIdleTask(base::MakeIdleTask([&recorder](base::TimeTicks deadline) {
+		recorder.Done();
+	}));
+	release.Signal();
+	recorder.Wait();
+	thread.Stop();
+	ASSERT_EQ(3u, recorder.ids().size());
+	EXPECT_EQ(1, recorder.ids()[0]);
+	EXPECT_EQ(2, recorder.ids()[1]);
+	EXPECT_EQ(kIdleId, recorder.ids()[2]);
+	ASSERT_EQ(1u, recorder.idle_budgets().size());
+	EXPECT_LE(recorder.idle_budgets()[0], base::TimeSpan::FromMilliseconds(50));
+	EXPECT_LE(base::TimeSpan(), recorder.idle_budgets()[0]);
+}
+
+TEST_WITH_EM(MessageLoop, IdleTaskDeadlineBeforeDelayedTask) {
+	Recorder recorder;
+	Thread thread;
+	thread.Start();
+	MessageLoop *loop = thread.message_loop();
+	loop->PostDelayTask(base::MakeRunnableMethod(&recorder, &Recorder::Done), 20);
+	loop->PostIdleTask(base::MakeIdleTask(&recorder, &Recorder::RecordIdle));
+	recorder.Wait();
+	thread.Stop();
+	ASSERT_EQ(1u, recorder.idle_budgets().size());
+	// the budget ends when the delayed task is due.
+	EXPECT_LE(recorder.idle_budgets()[0], base::TimeSpan::FromMilliseconds(20));
+}
+
+TEST_WITH_EM(MessageLoop, IdleTaskNotRunOnQuit) {
+	Recorder recorder;
+	{
+		Thread thread;
+		thread.Start();
+		MessageLoop *loop = thread.message_loop();
+		WaitableEvent entered(false, false);
+		WaitableEvent release(false, false);
+		loop->PostTask(base::MakeRunnableFunction(&Block, &entered, &release));
+		entered.Wait();
+		loop->PostIdleTask(base::MakeIdleTask(&recorder, &Recorder::RecordIdle));
+		loop->PostTask(base::MakeRunnableMethod(loop, &MessageLoop::Quit));
+		release.Signal();
+		thread.Stop();
+	}
+	EXPECT_TRUE(recorder.ids().empty());
+}
+
+namespace {
+	// Post a delayed task which is due by the time the loop gets to it, and the tasks below, while the loop is
+	// blocked. Return the position at which the delayed task ran among the others.
+	size_t RunWorkBatch(int max_tasks, int64_t budget_us, int64_t task_ms) {
+		const int kDelayedId = -1;
+		Recorder recorder;
+		WaitableEvent entered(false, false);
+		WaitableEvent release(false, false);
+		Thread thread;
+		thread.Start();
+		MessageLoop *loop = thread.message_loop();
+		loop->PostTask(base::MakeRunnableMethod(loop, &MessageLoop::SetWorkBatch, max_tasks, budget_us));
+		loop->PostTask(base::MakeRunnableFunction(&Block, &entered, &release));
+		entered.Wait();
+		loop->PostDelayTask(base::MakeRunnableMethod(&recorder, &Recorder::Record, kDelayedId), 1);
+		for (int i = 0; i < 10; ++i) {
+			loop->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::RecordSlowly, i, task_ms));
+		}
+		loop->PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Done));
+		base::ThreadHelper::Sleep(5);
+		release.Signal();
+		recorder.Wait();
+		thread.Stop();
+		for (size_t i = 0; i < recorder.ids().size(); ++i) {
+			if (recorder.ids()[i] == kDelayedId) {
+				return i;
+			}
+		}
+		return recorder.ids().size();
+	}
+}
+
+TEST_WITH_EM(MessageLoop, WorkBatch) {
+	// the delayed task is looked at after each task.
+	EXPECT_EQ(1u, RunWorkBatch(1, 0, 0));
+	// the blocking task is the first one of its batch.
+	EXPECT_EQ(3u, RunWorkBatch(4, 0, 0));
+	// the budget is used up by the first slow task.
+	EXPECT_EQ(1u, RunWorkBatch(100, 1000, 2));
+}
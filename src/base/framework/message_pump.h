@@ -30,6 +30,16 @@ namespace base {
 			virtual bool DoIdleWork() = 0;
 		};
 
+		// How many times the pump woke up from waiting, because a delayed work became due or because
+		// ScheduleWork was called.
+		struct WakeupStats {
+			WakeupStats() : timer_wakeups_(0), work_wakeups_(0) {
+			}
+
+			int64_t timer_wakeups_;
+			int64_t work_wakeups_;
+		};
+
 		MessagePump();
 		virtual ~MessagePump();
 		virtual void DoRunLoop() = 0;
@@ -38,8 +48,21 @@ namespace base {
 		virtual void Quit();
 		virtual void ScheduleWork() = 0;
 		virtual void ScheduleDelayWork(const TimeTicks &delayed_work_time) = 0;
+		// Can only be called on the thread which runs the pump.
+		WakeupStats wakeup_stats() const {
+			return wakeup_stats_;
+		}
+
 	protected:
 		int GetCurrentDelay() const;
+		void RecordWakeup(bool timed_out) {
+			if (timed_out) {
+				++wakeup_stats_.timer_wakeups_;
+			}else {
+				++wakeup_stats_.work_wakeups_;
+			}
+		}
+
 		struct RunState {
 			int run_depth_;
 			bool should_quit_;
@@ -49,6 +72,7 @@ namespace base {
 		RunState* state_;
 		long have_work_;
 		TimeTicks delayed_work_time_;
+		WakeupStats wakeup_stats_;
 	};
 }
 
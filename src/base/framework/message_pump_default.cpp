@@ -1,7 +1,23 @@
 ﻿#include "base/framework/message_pump_default.h"
 
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
 namespace base {
-	DefaultMessagePump::DefaultMessagePump() : keep_running_(true), event_(false, false) {
+	DefaultMessagePump::DefaultMessagePump()
+		: keep_running_(true), event_(false, false), state_(kRunning), signal_count_(0) {
+		timer_ = CreateWaitableTimerEx(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+		if (timer_ == nullptr) {
+			// the system has no high resolution timers.
+			timer_ = CreateWaitableTimer(nullptr, FALSE, nullptr);
+		}
+	}
+
+	DefaultMessagePump::~DefaultMessagePump() {
+		if (timer_ != nullptr) {
+			CloseHandle(timer_);
+		}
 	}
 
 	void DefaultMessagePump::Quit() {
@@ -29,25 +45,86 @@ namespace base {
 			if (more_work_is_plausible) {
 				continue;
 			}
+			if (spin_budget_ > TimeSpan() && SpinForWork()) {
+				++spin_stats_.spin_hits_;
+				InterlockedExchange(&state_, kRunning);
+				continue;
+			}
+			// From now on ScheduleWork signals the event, unless it has been called since the loop woke up,
+			// then the work it scheduled may not have been done yet.
+			if (InterlockedCompareExchange(&state_, kSleeping, kRunning) != kRunning) {
+				InterlockedExchange(&state_, kRunning);
+				continue;
+			}
 			if (delayed_work_time_.IsNull()) {
+				++spin_stats_.parks_;
 				event_.Wait();
+				RecordWakeup(false);
 			}else {
 				TimeSpan span = delayed_work_time_ - TimeTicks::Now();
 				if (span > TimeSpan()) {
-					event_.WaitForTime(span.ToMilliseconds());
+					++spin_stats_.parks_;
+					RecordWakeup(WaitFor(span));
 				}else {
 					delayed_work_time_ = TimeTicks();
 				}
 			}
+			InterlockedExchange(&state_, kRunning);
 		}
 		keep_running_ = true;
 	}
 
+	bool DefaultMessagePump::SpinForWork() {
+		TimeSpan budget = spin_budget_;
+		// no spinning past the delayed work.
+		if (!delayed_work_time_.IsNull() && delayed_work_time_ - TimeTicks::Now() < budget) {
+			budget = delayed_work_time_ - TimeTicks::Now();
+		}
+		TimeTicks end = TimeTicks::HightResolutionNow() + budget;
+		for (; ;) {
+			// reading the clock costs more than a pause, look at it once in a while.
+			for (int i = 0; i < 64; ++i) {
+				if (state_ == kWorkScheduled) {
+					return true;
+				}
+				YieldProcessor();
+			}
+			if (TimeTicks::HightResolutionNow() >= end) {
+				return state_ == kWorkScheduled;
+			}
+		}
+	}
+
+	bool DefaultMessagePump::WaitFor(TimeSpan span) {
+		// a negative due time is relative, in units of 100ns.
+		LARGE_INTEGER due_time;
+		due_time.QuadPart = -span.ToMicroseconds() * 10;
+		if (timer_ == nullptr || !SetWaitableTimer(timer_, &due_time, 0, nullptr, nullptr, FALSE)) {
+			// round up, or the loop wakes up before the time and has to wait again.
+			return !event_.WaitForTime(span.ToMillisecondsRoundedsUp());
+		}
+		HANDLE handles[] = {event_.handle(), timer_};
+		DWORD result = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+		if (result == WAIT_OBJECT_0) {
+			CancelWaitableTimer(timer_);
+			return false;
+		}
+		assert(result == WAIT_OBJECT_0 + 1);
+		return true;
+	}
+
 	void DefaultMessagePump::ScheduleDelayWork(const TimeTicks &next_time) {
 		delayed_work_time_ = next_time;
 	}
 
 	void DefaultMessagePump::ScheduleWork() {
-		event_.Signal();
+		// a plain read first, so the producers of a busy loop do not fight over the cache line.
+		if (state_ == kWorkScheduled) {
+			return;
+		}
+		if (InterlockedExchange(&state_, kWorkScheduled) == kSleeping) {
+			InterlockedIncrement(&signal_count_);
+			event_.Signal();
+		}
 	}
 }
\ No newline at end of file
@@ -9,11 +9,15 @@
 #include "base/synchronization/waitable_event.h"
 #include "base/time/time.h"
 namespace base {
+	// ScheduleWork only signals the event when the loop is sleeping or about to sleep, the producers
+	// posting to a busy loop never make a system call. The delayed work is waited for with a waitable
+	// timer in units of 100ns instead of a wait rounded to milliseconds. The timer is a high resolution
+	// one where the system has them, Windows 10 1803 and later, elsewhere it still fires on the system
+	// tick, about 15.6ms unless timeBeginPeriod has been called.
 	class DefaultMessagePump : public MessagePump {
 	public:
 		DefaultMessagePump();
-		virtual ~DefaultMessagePump(){
-		}
+		virtual ~DefaultMessagePump();
 		virtual void DoRunLoop() {
 			// we override run not use DoRunLoop;
 		}
@@ -21,10 +25,50 @@ namespace base {
 		virtual void Quit();
 		virtual void ScheduleWork();
 		virtual void ScheduleDelayWork(const TimeTicks &next_time);
+		// How many times the pump found work while spinning, and how many times it went to sleep.
+		struct SpinStats {
+			SpinStats() : spin_hits_(0), parks_(0) {
+			}
+
+			int64_t spin_hits_;
+			int64_t parks_;
+		};
+
+		// With a budget the pump polls for posted work that long before it goes to sleep, a loop
+		// which gets its work within the budget is never woken up by the event. Zero, the default,
+		// sleeps at once. Can only be called on the thread which runs the pump.
+		void SetSpinBudget(TimeSpan budget) {
+			spin_budget_ = budget;
+		}
+		SpinStats spin_stats() const {
+			return spin_stats_;
+		}
+		// How many times ScheduleWork had to signal the event, it can be read on any thread.
+		LONG signal_count() const {
+			return signal_count_;
+		}
+
 	private:
+		enum State {
+			kRunning,
+			// ScheduleWork was called while the loop was running, the loop will not sleep.
+			kWorkScheduled,
+			// The loop is sleeping or has decided to, ScheduleWork must signal the event.
+			kSleeping
+		};
+
+		// Spin until ScheduleWork is called or the budget is used up, return true in the first case.
+		bool SpinForWork();
+		// Wait for the event or for the span, return true if it timed out.
+		bool WaitFor(TimeSpan span);
 		bool keep_running_;
 		TimeTicks delayed_work_time_;
 		WaitableEvent event_;
+		HANDLE timer_;
+		volatile LONG state_;
+		volatile LONG signal_count_;
+		TimeSpan spin_budget_;
+		SpinStats spin_stats_;
 	};
 }
 #endif// BASE_FRAMEWORK_MESSAGE_PUMP_DEFAULT_H__
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "base/framework/message_pump_default.h"
+#include "base/thread/thread.h"
+#include "base/test/test_with_exit_manager.h"
+
+using base::DefaultMessagePump;
+using base::TimeSpan;
+using base::TimeTicks;
+
+namespace {
+	// Runs the pump for a fixed number of DoWork calls with the hooks below.
+	class Delegate : public base::MessagePump::Delegate {
+	public:
+		explicit Delegate(DefaultMessagePump *pump) : pump_(pump), work_count_(0), quit_after_(1) {
+		}
+
+		virtual bool DoWork() {
+			if (++work_count_ >= quit_after_) {
+				pump_->Quit();
+				return false;
+			}
+			OnWork();
+			return false;
+		}
+
+		virtual bool DoDelayWork(TimeTicks *next_time) {
+			*next_time = delayed_work_time_;
+			return false;
+		}
+
+		virtual bool DoIdleWork() {
+			return false;
+		}
+
+		virtual void OnWork() {
+		}
+
+		DefaultMessagePump *pump_;
+		int work_count_;
+		int quit_after_;
+		TimeTicks delayed_work_time_;
+	};
+
+	class SelfScheduling : public Delegate {
+	public:
+		explicit SelfScheduling(DefaultMessagePump *pump) : Delegate(pump) {
+		}
+
+		virtual void OnWork() {
+			// the loop is running, none of them needs a signal.
+			for (int i = 0; i < 100; ++i) {
+				pump_->ScheduleWork();
+			}
+		}
+	};
+
+	class Waker {
+	public:
+		explicit Waker(DefaultMessagePump *pump) : pump_(pump) {
+		}
+
+		void Wake() {
+			pump_->ScheduleWork();
+		}
+
+	private:
+		DefaultMessagePump *pump_;
+	};
+}
+
+TEST_WITH_EM(DefaultMessagePump, NoSignalWhileRunning) {
+	DefaultMessagePump pump;
+	SelfScheduling delegate(&pump);
+	delegate.quit_after_ = 2;
+	// the second DoWork comes without waiting, the pump would sleep forever otherwise.
+	pump.Run(&delegate);
+	EXPECT_EQ(2, delegate.work_count_);
+	EXPECT_EQ(0, pump.signal_count());
+	EXPECT_EQ(0, pump.wakeup_stats().work_wakeups_);
+}
+
+TEST_WITH_EM(DefaultMessagePump, SignalWhenSleeping) {
+	DefaultMessagePump pump;
+	Delegate delegate(&pump);
+	delegate.quit_after_ = 2;
+	Waker waker(&pump);
+	base::Thread thread;
+	thread.Start();
+	thread.message_loop()->PostDelayTask(base::MakeRunnableMethod(&waker, &Waker::Wake), 20);
+	pump.Run(&delegate);
+	thread.Stop();
+	EXPECT_EQ(2, delegate.work_count_);
+	EXPECT_EQ(1, pump.signal_count());
+	EXPECT_EQ(1, pump.wakeup_stats().work_wakeups_);
+}
+
+TEST_WITH_EM(DefaultMessagePump, TimedWaitNeverEarly) {
+	DefaultMessagePump pump;
+	Delegate delegate(&pump);
+	delegate.quit_after_ = 2;
+	delegate.delayed_work_time_ = TimeTicks::Now() + TimeSpan::FromMilliseconds(15);
+	pump.Run(&delegate);
+	EXPECT_GE(TimeTicks::Now(), delegate.delayed_work_time_);
+	EXPECT_EQ(1, pump.wakeup_stats().timer_wakeups_);
+	EXPECT_EQ(0, pump.signal_count());
+}
+
+TEST_WITH_EM(DefaultMessagePump, SpinHit) {
+	DefaultMessagePump pump;
+	pump.SetSpinBudget(TimeSpan::FromSeconds(10));
+	Delegate delegate(&pump);
+	delegate.quit_after_ = 2;
+	Waker waker(&pump);
+	base::Thread thread;
+	thread.Start();
+	thread.message_loop()->PostDelayTask(base::MakeRunnableMethod(&waker, &Waker::Wake), 20);
+	// the work comes while the pump spins, it never sleeps.
+	pump.Run(&delegate);
+	thread.Stop();
+	EXPECT_EQ(2, delegate.work_count_);
+	EXPECT_EQ(1, pump.spin_stats().spin_hits_);
+	EXPECT_EQ(0, pump.spin_stats().parks_);
+	EXPECT_EQ(0, pump.signal_count());
+}
+
+TEST_WITH_EM(DefaultMessagePump, SpinThenPark) {
+	DefaultMessagePump pump;
+	pump.SetSpinBudget(TimeSpan::FromMicroseconds(100));
+	Delegate delegate(&pump);
+	delegate.quit_after_ = 2;
+	Waker waker(&pump);
+	base::Thread thread;
+	thread.Start();
+	thread.message_loop()->PostDelayTask(base::MakeRunnableMethod(&waker, &Waker::Wake), 50);
+	pump.Run(&delegate);
+	thread.Stop();
+	EXPECT_EQ(2, delegate.work_count_);
+	EXPECT_EQ(0, pump.spin_stats().spin_hits_);
+	EXPECT_EQ(1, pump.spin_stats().parks_);
+	EXPECT_EQ(1, pump.signal_count());
+}
@@ -1,11 +1,36 @@
-﻿#include "base/framework/message_pump_io.h"
+﻿#include <winsock2.h>
+#include "base/framework/message_pump_io.h"
+
+#pragma comment(lib, "ws2_32.lib")
 
 namespace base {
-	IOMessagePump::IOMessagePump() {
+	namespace {
+		typedef ULONG (WINAPI *RtlNtStatusToDosErrorFunction)(LONG status);
+
+		// GetQueuedCompletionStatusEx leaves the status of each operation in its OVERLAPPED as a NTSTATUS.
+		DWORD GetIOError(const OVERLAPPED *overlapped) {
+			static RtlNtStatusToDosErrorFunction function = reinterpret_cast<RtlNtStatusToDosErrorFunction>(
+				GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "RtlNtStatusToDosError"));
+			LONG status = static_cast<LONG>(overlapped->Internal);
+			if (status >= 0) {
+				return ERROR_SUCCESS;
+			}
+			return function != nullptr ? function(status) : ERROR_GEN_FAILURE;
+		}
+	}
+
+	IOMessagePump::IOMessagePump() : entry_count_(0), next_entry_(0) {
 		io_observers_ = std::shared_ptr<ObserverList<IOObserver>>(new ObserverList<IOObserver>());
 		port_ = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, NULL, 1);
 	}
 
+	IOMessagePump::~IOMessagePump() {
+		// every IO loop has a port of its own.
+		if (port_ != nullptr) {
+			CloseHandle(port_);
+		}
+	}
+
 	void IOMessagePump::AddIOObserver(IOObserver *observer) {
 		io_observers_->AddObserver(observer);
 	}
@@ -22,6 +47,10 @@ namespace base {
 			}
 
 			more_work_is_plausible |= WaitForIOCompletion(0, nullptr);
+			// the rest of the batch is handled in the same pass, it needs no more system calls.
+			while (HasDequeuedItems() && !state_->should_quit_) {
+				WaitForIOCompletion(0, nullptr);
+			}
 			if (state_->should_quit_) {
 				break;
 			}
@@ -52,7 +81,7 @@ namespace base {
 		if (time_out < 0) {
 			time_out = INFINITE;
 		}
-		WaitForIOCompletion(time_out, nullptr);
+		RecordWakeup(!WaitForIOCompletion(time_out, nullptr));
 	}
 
 	bool IOMessagePump::WaitForIOCompletion(DWORD time_out, IOHandler *filter) {
@@ -84,17 +113,23 @@ namespace base {
 
 	bool IOMessagePump::GetIOItem(DWORD time_out, IOItem *item) {
 		memset(item, 0, sizeof(*item));
-		ULONG_PTR key = NULL;
-		OVERLAPPED *overlapped = nullptr;
-		if (!GetQueuedCompletionStatus(port_, &item->bytes_transfered_, &key, &overlapped, time_out)) {
-			if (overlapped == nullptr) {
+		if (!HasDequeuedItems()) {
+			next_entry_ = entry_count_ = 0;
+			if (!GetQueuedCompletionStatusEx(port_, entries_, kMaxCompletionsPerDequeue, &entry_count_, time_out, FALSE)) {
+				entry_count_ = 0;
 				return false;
 			}
-			item->error_ = GetLastError();
-			item->bytes_transfered_ = 0;
+			++io_stats_.dequeue_count_;
+		}
+		const OVERLAPPED_ENTRY &entry = entries_[next_entry_++];
+		item->context_ = reinterpret_cast<IOContext*>(entry.lpOverlapped);
+		item->handler_ = reinterpret_cast<IOHandler*>(entry.lpCompletionKey);
+		item->bytes_transfered_ = entry.dwNumberOfBytesTransferred;
+		// the packets of ScheduleWork carry the pump instead of an OVERLAPPED.
+		if (item->handler_ != reinterpret_cast<IOHandler*>(this)) {
+			item->error_ = GetIOError(entry.lpOverlapped);
+			++io_stats_.completion_count_;
 		}
-		item->context_ = reinterpret_cast<IOContext*>(overlapped);
-		item->handler_ = reinterpret_cast<IOHandler*>(key);
 		return true;
 	}
 
@@ -127,9 +162,132 @@ namespace base {
 		FOR_EACH_OBSERVER(IOObserver, io_observers_, PostProcessIOEvent());
 	}
 
-	void IOMessagePump::RegisterIOHandler(HANDLE handle, IOHandler *filter) {
+	bool IOMessagePump::RegisterIOHandler(HANDLE handle, IOHandler *filter, bool skip_completion_on_success) {
 		HANDLE port = CreateIoCompletionPort(handle, port_, reinterpret_cast<ULONG_PTR>(filter), 1);
 		assert(port);
+		if (!skip_completion_on_success) {
+			return true;
+		}
+		return SetFileCompletionNotificationModes(handle, FILE_SKIP_COMPLETION_PORT_ON_SUCCESS) != FALSE;
+	}
+
+	bool IOMessagePump::WatchSocket(SOCKET socket, bool persistent, WatchMode mode, SocketWatcher *controller, Watcher *watcher) {
+		assert(socket != INVALID_SOCKET && controller != nullptr && watcher != nullptr);
+		controller->StopWatching();
+		long network_events = 0;
+		if (mode & kWatchRead) {
+			network_events |= FD_READ | FD_ACCEPT | FD_CLOSE;
+		}
+		if (mode & kWatchWrite) {
+			network_events |= FD_WRITE | FD_CONNECT | FD_CLOSE;
+		}
+		controller->event_ = WSACreateEvent();
+		if (controller->event_ == WSA_INVALID_EVENT) {
+			controller->event_ = nullptr;
+			return false;
+		}
+		if (WSAEventSelect(socket, controller->event_, network_events) != 0) {
+			WSACloseEvent(controller->event_);
+			controller->event_ = nullptr;
+			return false;
+		}
+		controller->socket_ = socket;
+		controller->mode_ = mode;
+		controller->persistent_ = persistent;
+		controller->watcher_ = watcher;
+		controller->pump_ = this;
+		controller->context_ = new IOContext;
+		memset(controller->context_, 0, sizeof(*controller->context_));
+		controller->context_->handler_ = controller;
+		if (!controller->Arm()) {
+			controller->StopWatching();
+			return false;
+		}
+		return true;
+	}
+
+	IOMessagePump::SocketWatcher::SocketWatcher()
+		: socket_(INVALID_SOCKET), mode_(kWatchRead), persistent_(false), event_(nullptr), wait_handle_(nullptr), context_(nullptr),
+		posted_(0), watcher_(nullptr), pump_(nullptr), was_destroyed_(nullptr) {
+	}
+
+	IOMessagePump::SocketWatcher::~SocketWatcher() {
+		StopWatching();
+		if (was_destroyed_ != nullptr) {
+			*was_destroyed_ = true;
+		}
+	}
+
+	bool IOMessagePump::SocketWatcher::StopWatching() {
+		if (event_ == nullptr) {
+			return false;
+		}
+		if (wait_handle_ != nullptr) {
+			// wait for the callback, so posted_ tells whether the context is still in the port.
+			UnregisterWaitEx(wait_handle_, INVALID_HANDLE_VALUE);
+			wait_handle_ = nullptr;
+		}
+		WSAEventSelect(socket_, nullptr, 0);
+		WSACloseEvent(event_);
+		event_ = nullptr;
+		if (posted_) {
+			context_->handler_ = nullptr;
+		}else {
+			delete context_;
+		}
+		context_ = nullptr;
+		posted_ = 0;
+		socket_ = INVALID_SOCKET;
+		watcher_ = nullptr;
+		return true;
+	}
+
+	bool IOMessagePump::SocketWatcher::Arm() {
+		return RegisterWaitForSingleObject(&wait_handle_, event_, &SocketWatcher::OnSignaled, this, INFINITE,
+			WT_EXECUTEONLYONCE | WT_EXECUTEINWAITTHREAD) != FALSE;
+	}
+
+	void CALLBACK IOMessagePump::SocketWatcher::OnSignaled(PVOID parameter, BOOLEAN timed_out) {
+		SocketWatcher *controller = static_cast<SocketWatcher*>(parameter);
+		InterlockedExchange(&controller->posted_, 1);
+		PostQueuedCompletionStatus(controller->pump_->port_, 0, reinterpret_cast<ULONG_PTR>(static_cast<IOHandler*>(controller)),
+			&controller->context_->overlapped_);
+	}
+
+	void IOMessagePump::SocketWatcher::OnIOCompleted(IOContext *context, DWORD bytes_transfered, DWORD error) {
+		assert(context == context_);
+		InterlockedExchange(&posted_, 0);
+		// read and reset the events, the wait has fired once and has to be registered again.
+		WSANETWORKEVENTS events;
+		if (WSAEnumNetworkEvents(socket_, event_, &events) != 0) {
+			events.lNetworkEvents = 0;
+		}
+		UnregisterWaitEx(wait_handle_, nullptr);
+		wait_handle_ = nullptr;
+		SOCKET socket = socket_;
+		WatchMode mode = mode_;
+		Watcher *watcher = watcher_;
+		if (!persistent_) {
+			StopWatching();
+		}else if (!Arm()) {
+			StopWatching();
+		}
+		bool was_destroyed = false;
+		was_destroyed_ = &was_destroyed;
+		long write_events = FD_WRITE | FD_CONNECT;
+		if ((mode & kWatchRead) == 0) {
+			// nobody reads, the send will find the socket closed.
+			write_events |= FD_CLOSE;
+		}
+		if ((mode & kWatchRead) && (events.lNetworkEvents & (FD_READ | FD_ACCEPT | FD_CLOSE))) {
+			watcher->OnSocketCanReadWithoutBlocking(socket);
+		}
+		if (!was_destroyed && (mode & kWatchWrite) && (events.lNetworkEvents & write_events)) {
+			watcher->OnSocketCanWriteWithoutBlocking(socket);
+		}
+		if (!was_destroyed) {
+			was_destroyed_ = nullptr;
+		}
 	}
 
 	void IOMessagePump::ScheduleWork() {
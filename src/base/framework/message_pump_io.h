@@ -10,6 +10,7 @@
 #include "base/framework/message_pump.h"
 #include "base/framework/observer_list.h"
 #include "base/time/time.h"
+#include "base/util/noncopyable.h"
 
 namespace base {
 	class IOMessagePump : public MessagePump {
@@ -117,16 +118,97 @@ namespace base {
 			IOHandler *handler_;
 		};
 
+		// Clients which call the non-blocking send and recv themselves, instead of issuing overlapped IO,
+		// implement this interface to be told when a socket is ready, the way a select loop does.
+		class Watcher {
+		public:
+			virtual ~Watcher() {
+			}
+
+			// Readable also means that a connection can be accepted or that the peer has closed.
+			virtual void OnSocketCanReadWithoutBlocking(SOCKET socket) = 0;
+			// Writable also means that a connect has finished, successfully or not.
+			virtual void OnSocketCanWriteWithoutBlocking(SOCKET socket) = 0;
+		};
+
+		enum WatchMode {
+			kWatchRead = 1,
+			kWatchWrite = 2,
+			kWatchReadWrite = kWatchRead | kWatchWrite
+		};
+
+		// Controls one watch of a socket, destroying it stops the watch. It can be destroyed in the
+		// callbacks of its Watcher.
+		//
+		// WSAEventSelect tells the readiness, a thread pool wait posts it to the completion port, so it
+		// is interleaved with the tasks and the IO completions on the loop thread. Each readiness costs a
+		// wakeup of the wait thread and a new registration of the wait, so it suits the sockets with
+		// little traffic, overlapped IO through RegisterIOHandler scales better. It has not been measured
+		// with many sockets. The readiness follows the rules of WSAEventSelect: readable is
+		// reported again after a recv which leaves data behind, writable is only reported again after
+		// a send failed with WSAEWOULDBLOCK, so the watcher should write until it does.
+		class SocketWatcher : public IOHandler, public noncopyable {
+		public:
+			SocketWatcher();
+			virtual ~SocketWatcher();
+			// The socket stays in the non-blocking mode.
+			bool StopWatching();
+			virtual void OnIOCompleted(IOContext *context, DWORD bytes_transfered, DWORD error);
+		private:
+			friend class IOMessagePump;
+			// Called on a thread of the pool when the event is signaled.
+			static void CALLBACK OnSignaled(PVOID parameter, BOOLEAN timed_out);
+			bool Arm();
+			SOCKET socket_;
+			WatchMode mode_;
+			bool persistent_;
+			HANDLE event_;
+			HANDLE wait_handle_;
+			// Posted to the port when the event is signaled. It is deleted by the pump if it was posted
+			// when the watch stopped.
+			IOContext *context_;
+			volatile LONG posted_;
+			Watcher *watcher_;
+			IOMessagePump *pump_;
+			// Set while the callbacks run, so the controller knows it was destroyed by them.
+			bool *was_destroyed_;
+		};
+
+		// How many completions were dispatched, and how many system calls took them from the port. One
+		// call takes up to kMaxCompletionsPerDequeue of them.
+		struct IOStats {
+			IOStats() : completion_count_(0), dequeue_count_(0) {
+			}
+
+			int64_t completion_count_;
+			int64_t dequeue_count_;
+		};
+
+		enum {
+			kMaxCompletionsPerDequeue = 64
+		};
+
 		IOMessagePump();
-		virtual ~IOMessagePump() {
-		}
+		virtual ~IOMessagePump();
 
 		virtual void ScheduleWork();
 		virtual void ScheduleDelayWork(const TimeTicks &delayed_work_time);
-		void RegisterIOHandler(HANDLE handle, IOHandler *filter);
+		// If skip_completion_on_success is true, an operation on the handle which succeeds at once posts
+		// no completion, the caller handles the result itself and saves the round trip through the port.
+		// Return false if the handle cannot skip, it is registered all the same then.
+		bool RegisterIOHandler(HANDLE handle, IOHandler *filter, bool skip_completion_on_success = false);
+		// Watch the socket until the controller stops it, or for one readiness if persistent is false.
+		// A socket can only be watched by one controller at a time, and the controller must be stopped
+		// before the socket is closed. Can only be called on the loop thread.
+		bool WatchSocket(SOCKET socket, bool persistent, WatchMode mode, SocketWatcher *controller, Watcher *watcher);
 		bool WaitForIOCompletion(DWORD time_out, IOHandler *filter);
 		void AddIOObserver(IOObserver *observer);
 		void RemoveIOObserver(IOObserver *observer);
+		// Can only be called on the thread which runs the pump.
+		IOStats io_stats() const {
+			return io_stats_;
+		}
+
 	private:
 		struct IOItem{
 			IOContext *context_;
@@ -137,7 +219,12 @@ namespace base {
 		void DoRunLoop();
 		void WaitForWork();
 		bool MatchCompleteIOItem(IOHandler *filter, IOItem *item);
+		// Take the next item dequeued by the last call, or dequeue a batch of them from the port.
 		bool GetIOItem(DWORD time_out, IOItem *item);
+		bool HasDequeuedItems() const {
+			return next_entry_ < entry_count_;
+		}
+
 		bool ProcessInternalIOItem(const IOItem &item);
 		void PreProcessIOEvent();
 		void PostProcessIOEvent();
@@ -145,6 +232,11 @@ namespace base {
 		// This list will be empty almost always. It stores IO completions that have
 		// not been delivered yet because somebody was doing cleanup.
 		std::list<IOItem> completed_io_;
+		// The completions dequeued at once, the ones from next_entry_ on have not been handled yet.
+		OVERLAPPED_ENTRY entries_[kMaxCompletionsPerDequeue];
+		ULONG entry_count_;
+		ULONG next_entry_;
+		IOStats io_stats_;
 		std::shared_ptr<ObserverList<IOObserver>> io_observers_;
 	};
 }
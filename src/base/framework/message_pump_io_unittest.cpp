@@ -0,0 +1,227 @@
+#include <winsock2.h>
+#include <string>
+#include "base/framework/message_loop.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/test/test_tasks.h"
+#include "base/thread/thread.h"
+#include "base/test/test_with_exit_manager.h"
+
+using base::IOMessageLoop;
+using base::WaitableEvent;
+using base::test::Block;
+
+namespace {
+	// A connected pair of loopback sockets.
+	class SocketPair {
+	public:
+		SocketPair() : client_(INVALID_SOCKET), server_(INVALID_SOCKET) {
+			WSADATA data;
+			WSAStartup(MAKEWORD(2, 2), &data);
+			SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+			sockaddr_in address;
+			memset(&address, 0, sizeof(address));
+			address.sin_family = AF_INET;
+			address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			address.sin_port = 0;
+			int length = sizeof(address);
+			if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 && listen(listener, 1) == 0 &&
+				getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length) == 0) {
+				client_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+				if (connect(client_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) {
+					server_ = accept(listener, nullptr, nullptr);
+				}
+			}
+			closesocket(listener);
+		}
+
+		~SocketPair() {
+			if (client_ != INVALID_SOCKET) {
+				closesocket(client_);
+			}
+			if (server_ != INVALID_SOCKET) {
+				closesocket(server_);
+			}
+			WSACleanup();
+		}
+
+		SOCKET client() const {
+			return client_;
+		}
+
+		SOCKET server() const {
+			return server_;
+		}
+
+	private:
+		SOCKET client_;
+		SOCKET server_;
+	};
+
+	// Lives on the IO thread, reads what arrives until it has the expected size.
+	class Reader : public IOMessageLoop::Watcher {
+	public:
+		Reader(size_t expected, WaitableEvent *done)
+			: expected_(expected), done_(done), read_count_(0), write_count_(0) {
+		}
+
+		void Watch(SOCKET socket, bool persistent, IOMessageLoop::WatchMode mode) {
+			EXPECT_TRUE(IOMessageLoop::current()->WatchSocket(socket, persistent, mode, &controller_, this));
+		}
+
+		void StopWatching() {
+			controller_.StopWatching();
+		}
+
+		virtual void OnSocketCanReadWithoutBlocking(SOCKET socket) {
+			++read_count_;
+			char buffer[256];
+			int size;
+			while ((size = recv(socket, buffer, sizeof(buffer), 0)) > 0) {
+				data_.append(buffer, size);
+			}
+			if (data_.size() >= expected_) {
+				done_->Signal();
+			}
+		}
+
+		virtual void OnSocketCanWriteWithoutBlocking(SOCKET socket) {
+			++write_count_;
+			done_->Signal();
+		}
+
+		const std::string& data() const {
+			return data_;
+		}
+
+		int read_count() const {
+			return read_count_;
+		}
+
+		int write_count() const {
+			return write_count_;
+		}
+
+	private:
+		IOMessageLoop::SocketWatcher controller_;
+		size_t expected_;
+		WaitableEvent *done_;
+		std::string data_;
+		int read_count_;
+		int write_count_;
+	};
+
+	// Many of them share one countdown, each one is done with its first readable socket.
+	class Countdown : public IOMessageLoop::Watcher {
+	public:
+		Countdown() : remaining_(nullptr), done_(nullptr) {
+		}
+
+		void Watch(SOCKET socket, int *remaining, WaitableEvent *done) {
+			remaining_ = remaining;
+			done_ = done;
+			EXPECT_TRUE(IOMessageLoop::current()->WatchSocket(socket, false, base::IOMessagePump::kWatchRead, &controller_, this));
+		}
+
+		virtual void OnSocketCanReadWithoutBlocking(SOCKET socket) {
+			if (--*remaining_ == 0) {
+				done_->Signal();
+			}
+		}
+
+		virtual void OnSocketCanWriteWithoutBlocking(SOCKET socket) {
+		}
+
+	private:
+		IOMessageLoop::SocketWatcher controller_;
+		int *remaining_;
+		WaitableEvent *done_;
+	};
+
+	void Signal(WaitableEvent *event) {
+		event->Signal();
+	}
+
+	void CopyIOStats(base::IOMessagePump::IOStats *stats) {
+		*stats = IOMessageLoop::current()->io_stats();
+	}
+}
+
+TEST_WITH_EM(IOMessageLoop, RunsTasks) {
+	base::Thread thread;
+	thread.StartWithOptions(base::Thread::Options(base::MessageLoop::kIOMessageLoop));
+	WaitableEvent done(false, false);
+	thread.message_loop()->PostDelayTask(base::MakeRunnableFunction(&Signal, &done), 10);
+	done.Wait();
+	thread.Stop();
+}
+
+TEST_WITH_EM(IOMessageLoop, PersistentReadWatch) {
+	SocketPair pair;
+	ASSERT_NE(INVALID_SOCKET, pair.server());
+	base::Thread thread;
+	thread.StartWithOptions(base::Thread::Options(base::MessageLoop::kIOMessageLoop));
+	WaitableEvent done(false, false);
+	Reader reader(15, &done);
+	thread.message_loop()->PostTask(base::MakeRunnableMethod(&reader, &Reader::Watch, pair.server(), true, base::IOMessagePump::kWatchRead));
+	for (int i = 0; i < 3; ++i) {
+		EXPECT_EQ(5, send(pair.client(), "hello", 5, 0));
+		Sleep(10);
+	}
+	done.Wait();
+	thread.message_loop()->PostTask(base::MakeRunnableMethod(&reader, &Reader::StopWatching));
+	thread.Stop();
+	EXPECT_EQ("hellohellohello", reader.data());
+	EXPECT_GE(reader.read_count(), 1);
+	EXPECT_EQ(0, reader.write_count());
+}
+
+TEST_WITH_EM(IOMessageLoop, OneShotWriteWatch) {
+	SocketPair pair;
+	ASSERT_NE(INVALID_SOCKET, pair.client());
+	base::Thread thread;
+	thread.StartWithOptions(base::Thread::Options(base::MessageLoop::kIOMessageLoop));
+	WaitableEvent done(false, false);
+	Reader reader(0, &done);
+	thread.message_loop()->PostTask(base::MakeRunnableMethod(&reader, &Reader::Watch, pair.client(), false, base::IOMessagePump::kWatchWrite));
+	done.Wait();
+	// the watch has stopped itself, nothing more is reported.
+	Sleep(20);
+	thread.Stop();
+	EXPECT_EQ(1, reader.write_count());
+	EXPECT_EQ(0, reader.read_count());
+}
+
+// The sockets become readable while the loop is busy, their completions are taken from the port in
+// one batch.
+TEST_WITH_EM(IOMessageLoop, BatchedCompletions) {
+	const int kCount = 20;
+	SocketPair pairs[kCount];
+	Countdown watchers[kCount];
+	base::Thread thread;
+	thread.StartWithOptions(base::Thread::Options(base::MessageLoop::kIOMessageLoop));
+	base::MessageLoop *loop = thread.message_loop();
+	int remaining = kCount;
+	WaitableEvent done(false, false);
+	for (int i = 0; i < kCount; ++i) {
+		ASSERT_NE(INVALID_SOCKET, pairs[i].server());
+		loop->PostTask(base::MakeRunnableMethod(&watchers[i], &Countdown::Watch, pairs[i].server(), &remaining, &done));
+	}
+	base::IOMessagePump::IOStats before;
+	loop->PostTask(base::MakeRunnableFunction(&CopyIOStats, &before));
+	WaitableEvent entered(false, false);
+	WaitableEvent release(false, false);
+	loop->PostTask(base::MakeRunnableFunction(&Block, &entered, &release));
+	entered.Wait();
+	for (int i = 0; i < kCount; ++i) {
+		EXPECT_EQ(1, send(pairs[i].client(), "x", 1, 0));
+	}
+	// let the waits post their completions.
+	Sleep(100);
+	release.Signal();
+	done.Wait();
+	base::IOMessagePump::IOStats after;
+	loop->PostTask(base::MakeRunnableFunction(&CopyIOStats, &after));
+	thread.Stop();
+	EXPECT_EQ(kCount, after.completion_count_ - before.completion_count_);
+	EXPECT_LT(after.dequeue_count_ - before.dequeue_count_, 4);
+}
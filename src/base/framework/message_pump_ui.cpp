@@ -155,6 +155,7 @@ namespace base {
 			delay = INFINITE;
 		}
 		DWORD result = MsgWaitForMultipleObjectsEx(0, nullptr, delay, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+		RecordWakeup(result == WAIT_TIMEOUT);
 		if (result == WAIT_OBJECT_0) {
 			MSG msg = { 0 };
 			DWORD queue_state = GetQueueStatus(QS_MOUSE);
@@ -0,0 +1,138 @@
+#include "base/framework/rate_limited_task_queue.h"
+#include <math.h>
+#include "base/framework/message_loop.h"
+
+namespace base {
+	RateLimitedTaskQueue::RateLimitedTaskQueue(MessageLoop *loop, double rate, double burst)
+		: loop_(loop), rate_(rate), burst_(burst), tokens_(burst), refill_time_(TimeTicks::HightResolutionNow()),
+		release_scheduled_(false) {
+		assert(loop_ != nullptr && rate_ > 0 && burst_ > 0);
+	}
+
+	RateLimitedTaskQueue::~RateLimitedTaskQueue() {
+		assert(MessageLoop::current() == loop_ || entries_.empty());
+		release_.Cancel();
+		for (size_t i = 0; i < entries_.size(); ++i) {
+			delete entries_[i].task_;
+		}
+	}
+
+	void RateLimitedTaskQueue::PostTask(std::unique_ptr<Task> task, double cost) {
+		assert(task != nullptr && cost >= 0);
+		Entry entry = {task.release(), cost, TimeTicks::HightResolutionNow()};
+		int64_t delay_ms = -1;
+		{
+			AutoLock lock(lock_);
+			Refill();
+			if (entries_.empty() && TryTake(entry)) {
+				++stats_.released_count_;
+			}else {
+				entries_.push_back(entry);
+				++stats_.backlog_count_;
+				stats_.backlog_cost_ += cost;
+				if (!release_scheduled_) {
+					release_scheduled_ = true;
+					delay_ms = NextReleaseDelay();
+				}
+				entry.task_ = nullptr;
+			}
+		}
+		if (entry.task_ != nullptr) {
+			PostToLoop(entry.task_);
+		}else if (delay_ms >= 0) {
+			ScheduleRelease(delay_ms);
+		}
+	}
+
+	void RateLimitedTaskQueue::PostTask(const Location &from_here, std::unique_ptr<Task> task, double cost) {
+		task->set_posted_from(from_here);
+		PostTask(std::move(task), cost);
+	}
+
+	RateLimitedTaskQueue::Stats RateLimitedTaskQueue::stats() const {
+		AutoLock lock(lock_);
+		return stats_;
+	}
+
+	void RateLimitedTaskQueue::Release() {
+		int64_t delay_ms = -1;
+		{
+			AutoLock lock(lock_);
+			Refill();
+			TimeTicks now = refill_time_;
+			while (!entries_.empty() && TryTake(entries_.front())) {
+				const Entry &entry = entries_.front();
+				int64_t wait_us = (now - entry.post_time_).ToMicroseconds();
+				--stats_.backlog_count_;
+				stats_.backlog_cost_ -= entry.cost_;
+				++stats_.released_count_;
+				stats_.total_wait_us_ += wait_us;
+				if (wait_us > stats_.max_wait_us_) {
+					stats_.max_wait_us_ = wait_us;
+				}
+				// posted with the lock held, the queue may be destroyed on another thread once the backlog is
+				// empty. The loop never blocks its own thread.
+				if (!loop_->PostTask(std::unique_ptr<Task>(entry.task_))) {
+					++stats_.dropped_count_;
+				}
+				entries_.pop_front();
+			}
+			if (entries_.empty()) {
+				release_scheduled_ = false;
+				stats_.backlog_cost_ = 0;
+			}else {
+				delay_ms = NextReleaseDelay();
+			}
+		}
+		if (delay_ms >= 0) {
+			ScheduleRelease(delay_ms);
+		}
+	}
+
+	void RateLimitedTaskQueue::ScheduleRelease(int64_t delay_ms) {
+		std::unique_ptr<CancelableTask> task = MakeRunnableMethod(this, &RateLimitedTaskQueue::Release);
+		{
+			AutoLock lock(lock_);
+			release_ = CancelHandle(task.get());
+		}
+		// never rejected, or the backlog would wait for the next PostTask. The tasks it releases are
+		// subject to the capacity of the loop.
+		loop_->PostContinuation(FROM_HERE, std::move(task), delay_ms);
+	}
+
+	void RateLimitedTaskQueue::PostToLoop(Task *task) {
+		if (!loop_->PostTask(std::unique_ptr<Task>(task))) {
+			AutoLock lock(lock_);
+			++stats_.dropped_count_;
+		}
+	}
+
+	void RateLimitedTaskQueue::Refill() {
+		TimeTicks now = TimeTicks::HightResolutionNow();
+		tokens_ += rate_ * (now - refill_time_).ToSecondsF();
+		if (tokens_ > burst_) {
+			tokens_ = burst_;
+		}
+		refill_time_ = now;
+	}
+
+	bool RateLimitedTaskQueue::TryTake(const Entry &entry) {
+		// a task which costs more than the burst waits for a full bucket.
+		double needed = entry.cost_ < burst_ ? entry.cost_ : burst_;
+		if (tokens_ < needed) {
+			return false;
+		}
+		tokens_ -= entry.cost_;
+		return true;
+	}
+
+	int64_t RateLimitedTaskQueue::NextReleaseDelay() const {
+		const Entry &entry = entries_.front();
+		double needed = entry.cost_ < burst_ ? entry.cost_ : burst_;
+		if (tokens_ >= needed) {
+			return 0;
+		}
+		// round up, or the release comes before the tokens and has to wait again.
+		return static_cast<int64_t>(ceil((needed - tokens_) * 1000 / rate_));
+	}
+}
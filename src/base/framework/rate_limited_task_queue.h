@@ -0,0 +1,96 @@
+/*
+ * A queue in front of a MessageLoop which releases its tasks to the loop at a limited rate, for work on
+ * a resource which must not get bursts, like the writes to a database. It is a token bucket: the bucket
+ * fills at |rate| units a second up to |burst| units, and a task is released when the bucket holds its
+ * cost. The tasks are released in the order they were posted. When the bucket runs short, the queue
+ * posts a delayed task to the loop for when the next task can go, so no thread sleeps for it.
+ *
+ * For example,
+ * base::RateLimitedTaskQueue writes(db_thread.message_loop(), 200, 20);     // 200 writes a second.
+ * writes.PostTask(FROM_HERE, base::MakeRunnableMethod(this, &Foo::Insert, row));
+ * writes.PostTask(FROM_HERE, base::MakeRunnableMethod(this, &Foo::Vacuum), 50);  // costs 50 writes.
+ *
+ * A task which costs more than the burst is released once the bucket is full, and leaves it in debt.
+ */
+
+#ifndef BASE_FRAMEWORK_RATE_LIMITED_TASK_QUEUE_H__
+#define BASE_FRAMEWORK_RATE_LIMITED_TASK_QUEUE_H__
+
+#include <deque>
+#include <memory>
+#include "base/base_types.h"
+#include "base/framework/cancel_token.h"
+#include "base/framework/location.h"
+#include "base/framework/task.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "base/util/noncopyable.h"
+
+namespace base {
+	class MessageLoop;
+
+	class RateLimitedTaskQueue : public noncopyable {
+	public:
+		struct Stats {
+			Stats() : backlog_count_(0), backlog_cost_(0), released_count_(0), dropped_count_(0), total_wait_us_(0),
+				max_wait_us_(0) {
+			}
+
+			// The tasks waiting for tokens.
+			int64_t backlog_count_;
+			double backlog_cost_;
+			int64_t released_count_;
+			// The released tasks which the loop rejected, see MessageLoop::SetCapacity.
+			int64_t dropped_count_;
+			// How long the released tasks waited in the queue.
+			int64_t total_wait_us_;
+			int64_t max_wait_us_;
+		};
+
+		// The bucket starts full.
+		RateLimitedTaskQueue(MessageLoop *loop, double rate, double burst);
+		// Must be destroyed on the thread of the loop unless the backlog is empty, the tasks not released yet
+		// are deleted.
+		~RateLimitedTaskQueue();
+		// Can be called on any thread. A task is posted to the loop at once while the queue is empty and the
+		// bucket holds its cost.
+		void PostTask(std::unique_ptr<Task> task, double cost = 1);
+		void PostTask(const Location &from_here, std::unique_ptr<Task> task, double cost = 1);
+		// Can be called on any thread.
+		Stats stats() const;
+
+	private:
+		struct Entry {
+			Task *task_;
+			double cost_;
+			TimeTicks post_time_;
+		};
+
+		// Runs on the loop, releases the tasks which the bucket can pay for and schedules itself for the rest.
+		void Release();
+		void ScheduleRelease(int64_t delay_ms);
+		// Post the released task to the loop and count it if the loop rejects it.
+		void PostToLoop(Task *task);
+		// The functions below are called with the lock held.
+		void Refill();
+		// Take the cost of the entry from the bucket if it holds enough.
+		bool TryTake(const Entry &entry);
+		// The time until the bucket holds enough for the first entry.
+		int64_t NextReleaseDelay() const;
+
+		MessageLoop *loop_;
+		double rate_;
+		double burst_;
+		mutable LockImpl lock_;
+		std::deque<Entry> entries_;
+		double tokens_;
+		TimeTicks refill_time_;
+		// A release is posted to the loop, the posters do not need to post one.
+		bool release_scheduled_;
+		Stats stats_;
+		// The release posted to the loop, canceled when the queue is destroyed.
+		CancelHandle release_;
+	};
+}
+
+#endif// BASE_FRAMEWORK_RATE_LIMITED_TASK_QUEUE_H__
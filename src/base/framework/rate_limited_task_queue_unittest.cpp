@@ -0,0 +1,133 @@
+#include <memory>
+#include <vector>
+#include "base/framework/rate_limited_task_queue.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/test/test_tasks.h"
+#include "base/test/test_with_exit_manager.h"
+#include "base/thread/thread.h"
+
+using base::MessageLoop;
+using base::RateLimitedTaskQueue;
+using base::Thread;
+using base::TimeTicks;
+using base::WaitableEvent;
+using base::test::Block;
+using base::test::DeleteTracker;
+using base::test::Hold;
+
+namespace {
+	// Also records the time each id runs at.
+	class Recorder : public base::test::Recorder {
+	public:
+		explicit Recorder(int total) : base::test::Recorder(total) {
+		}
+
+		void Record(int id) {
+			times_.push_back(TimeTicks::HightResolutionNow());
+			base::test::Recorder::Record(id);
+		}
+
+		std::vector<TimeTicks> times_;
+	};
+
+	void Destroy(std::unique_ptr<RateLimitedTaskQueue> *queue, WaitableEvent *done) {
+		queue->reset();
+		done->Signal();
+	}
+}
+
+TEST_WITH_EM(RateLimitedTaskQueue, BurstThenRate) {
+	const int kTasks = 25;
+	Thread thread;
+	thread.Start();
+	Recorder recorder(kTasks);
+	RateLimitedTaskQueue queue(thread.message_loop(), 100, 5);
+	TimeTicks start = TimeTicks::HightResolutionNow();
+	for (int i = 0; i < kTasks; ++i) {
+		queue.PostTask(FROM_HERE, base::MakeRunnableMethod(&recorder, &Recorder::Record, i));
+	}
+	recorder.Wait();
+	// the burst goes at once, the other 20 at 100 a second.
+	EXPECT_LT((recorder.times_[4] - start).ToMilliseconds(), 50);
+	EXPECT_GE((recorder.times_[kTasks - 1] - start).ToMilliseconds(), 180);
+	for (int i = 0; i < kTasks; ++i) {
+		EXPECT_EQ(i, recorder.ids()[i]);
+	}
+	RateLimitedTaskQueue::Stats stats = queue.stats();
+	EXPECT_EQ(0, stats.backlog_count_);
+	EXPECT_EQ(kTasks, stats.released_count_);
+	EXPECT_GE(stats.max_wait_us_, 180000);
+	EXPECT_GT(stats.total_wait_us_, 0);
+	thread.Stop();
+}
+
+TEST_WITH_EM(RateLimitedTaskQueue, Cost) {
+	Thread thread;
+	thread.Start();
+	Recorder recorder(3);
+	RateLimitedTaskQueue queue(thread.message_loop(), 100, 10);
+	TimeTicks start = TimeTicks::HightResolutionNow();
+	// the first one empties the bucket, the second one costs more than the burst and waits for a full
+	// bucket, the third one waits for the debt of the second.
+	queue.PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Record, 0), 10);
+	queue.PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Record, 1), 15);
+	queue.PostTask(base::MakeRunnableMethod(&recorder, &Recorder::Record, 2), 1);
+	RateLimitedTaskQueue::Stats stats = queue.stats();
+	EXPECT_EQ(2, stats.backlog_count_);
+	EXPECT_EQ(16, stats.backlog_cost_);
+	recorder.Wait();
+	EXPECT_GE((recorder.times_[1] - start).ToMilliseconds(), 90);
+	EXPECT_GE((recorder.times_[2] - start).ToMilliseconds(), 140);
+	EXPECT_EQ(0, queue.stats().backlog_count_);
+	thread.Stop();
+}
+
+TEST_WITH_EM(RateLimitedTaskQueue, DestroyDeletesBacklog) {
+	Thread thread;
+	thread.Start();
+	std::unique_ptr<RateLimitedTaskQueue> queue(new RateLimitedTaskQueue(thread.message_loop(), 1, 1));
+	bool first_ran = false;
+	bool second_ran = false;
+	bool second_deleted = false;
+	queue->PostTask(base::MakeRunnableFunction(&Hold, std::shared_ptr<DeleteTracker>(), &first_ran));
+	queue->PostTask(base::MakeRunnableFunction(&Hold, std::shared_ptr<DeleteTracker>(new DeleteTracker(&second_deleted)),
+		&second_ran));
+	WaitableEvent done(false, false);
+	thread.message_loop()->PostTask(base::MakeRunnableFunction(&Destroy, &queue, &done));
+	done.Wait();
+	thread.Stop();
+	EXPECT_TRUE(first_ran);
+	EXPECT_FALSE(second_ran);
+	EXPECT_TRUE(second_deleted);
+}
+
+// The loop is full when the first task is released, the second one waits for tokens until it has room.
+TEST_WITH_EM(RateLimitedTaskQueue, CountsRejectedTasks) {
+	Thread thread;
+	thread.Start();
+	WaitableEvent started(false, false);
+	WaitableEvent release(false, false);
+	thread.message_loop()->SetCapacity(1, MessageLoop::kRejectTask);
+	thread.message_loop()->PostTask(base::MakeRunnableFunction(&Block, &started, &release));
+	started.Wait();
+	bool first_ran = false;
+	bool second_ran = false;
+	ASSERT_TRUE(thread.message_loop()->PostTask(base::MakeRunnableFunction(&Hold, std::shared_ptr<DeleteTracker>(),
+		&first_ran)));
+	RateLimitedTaskQueue queue(thread.message_loop(), 100, 1);
+	queue.PostTask(base::MakeRunnableFunction(&Hold, std::shared_ptr<DeleteTracker>(), &first_ran));
+	queue.PostTask(base::MakeRunnableFunction(&Hold, std::shared_ptr<DeleteTracker>(), &second_ran));
+	EXPECT_EQ(1, queue.stats().dropped_count_);
+	EXPECT_EQ(1, queue.stats().backlog_count_);
+	release.Signal();
+	while (queue.stats().backlog_count_ != 0) {
+		Sleep(5);
+	}
+	// room for the quit task of Stop.
+	thread.message_loop()->SetCapacity(0, MessageLoop::kBlockProducer);
+	thread.Stop();
+	EXPECT_TRUE(second_ran);
+	RateLimitedTaskQueue::Stats stats = queue.stats();
+	EXPECT_EQ(2, stats.released_count_);
+	EXPECT_EQ(1, stats.dropped_count_);
+}
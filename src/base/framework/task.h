@@ -1,20 +1,127 @@
 /*
  * This file defined the task class and  runnable method builder.
+ * A task has only one owner. The builders return it in a std::unique_ptr and the MessageLoop takes the
+ * ownership when it is posted, the task object itself is linked into the queues of the loop, so posting
+ * and running a task costs only the allocation of the task, which comes from a per-thread pool.
  */
 
 #ifndef BASE_FRAMEWORK_TASK_H__
 #define BASE_FRAMEWORK_TASK_H__
 
 #include <memory>
+#include <type_traits>
+#include <utility>
+#include "base/framework/cancel_token.h"
+#include "base/framework/location.h"
+#include "base/memory/task_allocator.h"
+#include "base/synchronization/mpsc_queue.h"
+#include "base/time/time.h"
 #include "base/util/invoke_helper.h"
 
 namespace base {
-	class Task {
+	// The lanes of a MessageLoop, see MessageLoop::SetStarvationPolicy for how they share the loop.
+	enum TaskPriority {
+		kHighPriority,
+		kNormalPriority,
+		kBestEffortPriority,
+		kTaskPriorityCount
+	};
+
+	class Task : public MpscQueue<Task>::Node {
 	public:
+		Task() : sequence_num_(0), priority_(kNormalPriority) {
+		}
+
 		virtual ~Task() {
 		}
 
+		// The tasks come from the pool of the thread which makes them, see TaskAllocator.
+		static void* operator new(size_t size) {
+			return TaskAllocator::Allocate(size);
+		}
+
+		static void operator delete(void *task) {
+			TaskAllocator::Free(task);
+		}
+
 		virtual void Run() = 0;
+
+		// Called instead of delete by the loop which ran the task, or skipped it because it was canceled,
+		// once the loop is done with it. A task which has more to do on another loop, like the relay of
+		// PostTaskAndReply, posts itself there instead of being deleted.
+		virtual void Retire() {
+			delete this;
+		}
+
+		// The scheduling information is filled by the MessageLoop which the task was posted to.
+		TimeTicks delayed_run_time() const {
+			return delayed_run_time_;
+		}
+
+		void set_delayed_run_time(TimeTicks delayed_run_time) {
+			delayed_run_time_ = delayed_run_time;
+		}
+
+		// How late the task may run after its delayed run time, so its wakeup can be shared with others.
+		TimeSpan leeway() const {
+			return leeway_;
+		}
+
+		void set_leeway(TimeSpan leeway) {
+			leeway_ = leeway;
+		}
+
+		int sequence_num() const {
+			return sequence_num_;
+		}
+
+		void set_sequence_num(int sequence_num) {
+			sequence_num_ = sequence_num;
+		}
+
+		TaskPriority priority() const {
+			return priority_;
+		}
+
+		void set_priority(TaskPriority priority) {
+			priority_ = priority;
+		}
+
+		// Only set when the loop collects the queueing delay of its lanes or the timing of its tasks.
+		TimeTicks post_time() const {
+			return post_time_;
+		}
+
+		void set_post_time(TimeTicks post_time) {
+			post_time_ = post_time;
+		}
+
+		// Where the task was posted, see FROM_HERE.
+		const Location& posted_from() const {
+			return posted_from_;
+		}
+
+		void set_posted_from(const Location &posted_from) {
+			posted_from_ = posted_from;
+		}
+
+		// Set by CancelHandle or TaskGroup, see cancel_token.h.
+		void set_cancel_token(const CancelToken &cancel_token) {
+			cancel_token_ = cancel_token;
+		}
+
+		bool IsCanceled() const {
+			return cancel_token_.IsCanceled();
+		}
+
+	private:
+		CancelToken cancel_token_;
+		Location posted_from_;
+		TimeTicks delayed_run_time_;
+		TimeTicks post_time_;
+		TimeSpan leeway_;
+		int sequence_num_;
+		TaskPriority priority_;
 	};
 
 	class CancelableTask : public Task {
@@ -27,11 +134,79 @@ namespace base {
 		virtual void Cancel() = 0;
 	};
 
+	// Deferrable work, like trimming a cache, which MessageLoop::PostIdleTask runs when the loop has nothing
+	// else to do. It should be done by |deadline|, when the loop expects other work, and post itself again
+	// for what is left.
+	class IdleTask : public Task {
+	public:
+		IdleTask() {
+		}
+
+		virtual ~IdleTask() {
+		}
+
+		virtual void RunIdle(TimeTicks deadline) = 0;
+
+		virtual void Run() {
+			RunIdle(deadline_);
+		}
+
+		// Set by the loop right before it runs the task.
+		void set_deadline(TimeTicks deadline) {
+			deadline_ = deadline;
+		}
+
+	private:
+		TimeTicks deadline_;
+	};
+
+	template<class T>
+	class IdleMethod : public IdleTask {
+	public:
+		IdleMethod(T *obj, void (T::*method)(TimeTicks)) : obj_(obj), method_(method) {
+		}
+
+		virtual void RunIdle(TimeTicks deadline) {
+			(obj_->*method_)(deadline);
+		}
+
+	private:
+		T *obj_;
+		void (T::*method_)(TimeTicks);
+	};
+
+	template<class Func>
+	class IdleFunction : public IdleTask {
+	public:
+		explicit IdleFunction(Func &&func) : func_(std::move(func)) {
+		}
+
+		virtual void RunIdle(TimeTicks deadline) {
+			func_(deadline);
+		}
+
+	private:
+		Func func_;
+	};
+
+	// obj->method(deadline).
+	template<class T>
+	inline std::unique_ptr<IdleTask> MakeIdleTask(T *obj, void (T::*method)(TimeTicks)) {
+		return std::unique_ptr<IdleTask>(new IdleMethod<T>(obj, method));
+	}
+
+	// func(deadline), |func| is a function pointer or a functor.
+	template<class Func>
+	inline std::unique_ptr<IdleTask> MakeIdleTask(Func &&func) {
+		typedef typename std::decay<Func>::type Function;
+		return std::unique_ptr<IdleTask>(new IdleFunction<Function>(Function(std::forward<Func>(func))));
+	}
+
 	template<class T, class Method, class Params>
 	class RunnableMethod : public CancelableTask {
 	public:
-		RunnableMethod(T *obj, Method method, Params params) 
-			: obj_(obj), method_(method), params_(params) {
+		RunnableMethod(T *obj, Method method, Params &&params) 
+			: obj_(obj), method_(method), params_(std::move(params)) {
 		}
 
 		~RunnableMethod() {
@@ -56,73 +231,90 @@ namespace base {
 		Params params_;
 	};
 
+	// The arguments are moved into the task when they are rvalues and copied once otherwise.
 	template<class T, class Method>
-	inline std::shared_ptr<CancelableTask> MakeRunnableMethod(T *obj, Method method) {
-		return std::shared_ptr<CancelableTask>(new RunnableMethod<T, Method, std::tr1::tuple<std::tr1::_Nil>>(obj, method, std::tr1::make_tuple(std::tr1::_Nil_obj)));
+	inline std::unique_ptr<CancelableTask> MakeRunnableMethod(T *obj, Method method) {
+		return std::unique_ptr<CancelableTask>(new RunnableMethod<T, Method, internal::Params0>(obj, method, internal::Params0()));
 	}
 
 	template<class T, class Method, class A>
-	inline std::shared_ptr<CancelableTask> MakeRunnableMethod(T *obj, Method method, const A &a) {
-		return std::shared_ptr<CancelableTask>(new RunnableMethod<T, Method, std::tr1::tuple<A>>(obj, method, std::tr1::make_tuple(a)));
+	inline std::unique_ptr<CancelableTask> MakeRunnableMethod(T *obj, Method method, A &&a) {
+		typedef internal::Params1<typename std::decay<A>::type> Params;
+		return std::unique_ptr<CancelableTask>(new RunnableMethod<T, Method, Params>(obj, method, Params(std::forward<A>(a))));
 	}
 
 	template<class T, class Method, class A, class B>
-	inline std::shared_ptr<CancelableTask> MakeRunnableMethod(T *obj, Method method, const A &a, const B &b) {
-		return std::shared_ptr<CancelableTask>(new RunnableMethod<T, Method, std::tr1::tuple<A, B>>(obj, method, std::tr1::make_tuple(a, b)));
+	inline std::unique_ptr<CancelableTask> MakeRunnableMethod(T *obj, Method method, A &&a, B &&b) {
+		typedef internal::Params2<typename std::decay<A>::type, typename std::decay<B>::type> Params;
+		return std::unique_ptr<CancelableTask>(new RunnableMethod<T, Method, Params>(obj, method, Params(std::forward<A>(a), std::forward<B>(b))));
 	}
 
 	template<class T, class Method, class A, class B, class C>
-	inline std::shared_ptr<CancelableTask> MakeRunnableMethod(T *obj, Method method, const A &a, const B &b, const C &c) {
-		return std::shared_ptr<CancelableTask>(new RunnableMethod<T, Method, std::tr1::tuple<A, B, C>>(obj, method, std::tr1::make_tuple(a, b, c)));
+	inline std::unique_ptr<CancelableTask> MakeRunnableMethod(T *obj, Method method, A &&a, B &&b, C &&c) {
+		typedef internal::Params3<typename std::decay<A>::type, typename std::decay<B>::type, typename std::decay<C>::type> Params;
+		return std::unique_ptr<CancelableTask>(new RunnableMethod<T, Method, Params>(obj, method, Params(std::forward<A>(a), std::forward<B>(b), std::forward<C>(c))));
 	}
 
 	template<class T, class Method, class A, class B, class C, class D>
-	inline std::shared_ptr<CancelableTask> MakeRunnableMethod(T *obj, Method method, const A &a, const B &b, const C &c, const D &d) {
-		return std::shared_ptr<CancelableTask>(new RunnableMethod<T, Method, std::tr1::tuple<A, B, C, D>>(obj, method, std::tr1::make_tuple(a, b, c, d)));
+	inline std::unique_ptr<CancelableTask> MakeRunnableMethod(T *obj, Method method, A &&a, B &&b, C &&c, D &&d) {
+		typedef internal::Params4<typename std::decay<A>::type, typename std::decay<B>::type, typename std::decay<C>::type, typename std::decay<D>::type> Params;
+		return std::unique_ptr<CancelableTask>(new RunnableMethod<T, Method, Params>(obj, method, Params(std::forward<A>(a), std::forward<B>(b), std::forward<C>(c), std::forward<D>(d))));
 	}
 
 	template<class T, class Method, class A, class B, class C, class D, class E>
-	inline std::shared_ptr<CancelableTask> MakeRunnableMethod(T *obj, Method method, const A &a, const B &b, const C &c, const D &d, const E &e) {
-		return std::shared_ptr<CancelableTask>(new RunnableMethod<T, Method, std::tr1::tuple<A, B, C, D, E>>(obj, method, std::tr1::make_tuple(a, b, c, d, e)));
+	inline std::unique_ptr<CancelableTask> MakeRunnableMethod(T *obj, Method method, A &&a, B &&b, C &&c, D &&d, E &&e) {
+		typedef internal::Params5<typename std::decay<A>::type, typename std::decay<B>::type, typename std::decay<C>::type, typename std::decay<D>::type, typename std::decay<E>::type> Params;
+		return std::unique_ptr<CancelableTask>(new RunnableMethod<T, Method, Params>(obj, method, Params(std::forward<A>(a), std::forward<B>(b), std::forward<C>(c), std::forward<D>(d), std::forward<E>(e))));
 	}
 
 	template<class T, class Method, class A, class B, class C, class D, class E, class F>
-	inline std::shared_ptr<CancelableTask> MakeRunnableMethod(T *obj, Method method, const A &a, const B &b, const C &c, const D &d, const E &e, const F &f) {
-		return std::shared_ptr<CancelableTask>(new RunnableMethod<T, Method, std::tr1::tuple<A, B, C, D, E, F>>(obj, method, std::tr1::make_tuple(a, b, c, d, e, f)));
+	inline std::unique_ptr<CancelableTask> MakeRunnableMethod(T *obj, Method method, A &&a, B &&b, C &&c, D &&d, E &&e, F &&f) {
+		typedef internal::Params6<typename std::decay<A>::type, typename std::decay<B>::type, typename std::decay<C>::type, typename std::decay<D>::type, typename std::decay<E>::type, typename std::decay<F>::type> Params;
+		return std::unique_ptr<CancelableTask>(new RunnableMethod<T, Method, Params>(obj, method, Params(std::forward<A>(a), std::forward<B>(b), std::forward<C>(c), std::forward<D>(d), std::forward<E>(e), std::forward<F>(f))));
 	}
 
 	template<class T, class Method, class A, class B, class C, class D, class E, class F, class G>
-	inline std::shared_ptr<CancelableTask> MakeRunnableMethod(T *obj, Method method, const A &a, const B &b, const C &c, const D &d, const E &e, const F &f,
-		const G &g) {
-		return std::shared_ptr<CancelableTask>(new RunnableMethod<T, Method, std::tr1::tuple<A, B, C, D, E, F, G>>(obj, method, std::tr1::make_tuple(a, b, c, d, e, f,
-			g)));
+	inline std::unique_ptr<CancelableTask> MakeRunnableMethod(T *obj, Method method, A &&a, B &&b, C &&c, D &&d, E &&e, F &&f, G &&g) {
+		typedef internal::Params7<typename std::decay<A>::type, typename std::decay<B>::type, typename std::decay<C>::type, typename std::decay<D>::type, typename std::decay<E>::type, typename std::decay<F>::type, typename std::decay<G>::type> Params;
+		return std::unique_ptr<CancelableTask>(new RunnableMethod<T, Method, Params>(obj, method, Params(std::forward<A>(a), std::forward<B>(b), std::forward<C>(c), std::forward<D>(d), std::forward<E>(e), std::forward<F>(f), std::forward<G>(g))));
 	}
 
 	template<class T, class Method, class A, class B, class C, class D, class E, class F, class G, class H>
-	inline std::shared_ptr<CancelableTask> MakeRunnableMethod(T *obj, Method method, const A &a, const B &b, const C &c, const D &d, const E &e, const F &f,
-		const G &g, const H &h) {
-			return std::shared_ptr<CancelableTask>(new RunnableMethod<T, Method, std::tr1::tuple<A, B, C, D, E, F, G, H>>(obj, method, std::tr1::make_tuple(a, b, c, d, e, f,
-				g,h)));
+	inline std::unique_ptr<CancelableTask> MakeRunnableMethod(T *obj, Method method, A &&a, B &&b, C &&c, D &&d, E &&e, F &&f, G &&g, H &&h) {
+		typedef internal::Params8<typename std::decay<A>::type, typename std::decay<B>::type, typename std::decay<C>::type, typename std::decay<D>::type, typename std::decay<E>::type, typename std::decay<F>::type, typename std::decay<G>::type, typename std::decay<H>::type> Params;
+		return std::unique_ptr<CancelableTask>(new RunnableMethod<T, Method, Params>(obj, method, Params(std::forward<A>(a), std::forward<B>(b), std::forward<C>(c), std::forward<D>(d), std::forward<E>(e), std::forward<F>(f), std::forward<G>(g), std::forward<H>(h))));
 	}
 
 	template<class T, class Method, class A, class B, class C, class D, class E, class F, class G, class H, class I>
-	inline std::shared_ptr<CancelableTask> MakeRunnableMethod(T *obj, Method method, const A &a, const B &b, const C &c, const D &d, const E &e, const F &f,
-		const G &g, const H &h, const I &i) {
-			return std::shared_ptr<CancelableTask>(new RunnableMethod<T, Method, std::tr1::tuple<A, B, C, D, E, F, G, H, I>>(obj, method, std::tr1::make_tuple(a, b, c, d, e, f,
-				g,h, i)));
+	inline std::unique_ptr<CancelableTask> MakeRunnableMethod(T *obj, Method method, A &&a, B &&b, C &&c, D &&d, E &&e, F &&f, G &&g, H &&h, I &&i) {
+		typedef internal::Params9<typename std::decay<A>::type, typename std::decay<B>::type, typename std::decay<C>::type, typename std::decay<D>::type, typename std::decay<E>::type, typename std::decay<F>::type, typename std::decay<G>::type, typename std::decay<H>::type, typename std::decay<I>::type> Params;
+		return std::unique_ptr<CancelableTask>(new RunnableMethod<T, Method, Params>(obj, method, Params(std::forward<A>(a), std::forward<B>(b), std::forward<C>(c), std::forward<D>(d), std::forward<E>(e), std::forward<F>(f), std::forward<G>(g), std::forward<H>(h), std::forward<I>(i))));
+	}
+
+	namespace internal {
+		template<class Func>
+		inline bool IsNullFunction(const Func &func) {
+			return false;
+		}
+
+		template<class Func>
+		inline bool IsNullFunction(Func *func) {
+			return func == nullptr;
+		}
 	}
 
+	// |Func| is a function pointer or a functor, like a lambda which captures what it needs.
 	template<class Func, class Params>
 	class RunnableFunction : public CancelableTask {
 	public:
-		RunnableFunction(Func func, Params params) : func_(func), params_(params), was_canceled_(false) {
+		RunnableFunction(Func &&func, Params &&params) : func_(std::move(func)), params_(std::move(params)), was_canceled_(false) {
 		}
 
 		~RunnableFunction() {
 		}
 
 		virtual void Run() {
-			if (!was_canceled_ && func_) {
+			if (!was_canceled_ && !internal::IsNullFunction(func_)) {
 				DispatchToFunction(func_, params_);
 			}
 		}
@@ -138,59 +330,73 @@ namespace base {
 	};
 
 	template<class Func>
-	inline std::shared_ptr<CancelableTask> MakeRunnableFunction(Func func) {
-		return std::shared_ptr<CancelableTask>(new RunnableFunction<func, std::tr1::tuple<std::tr1::_Nil>>(func, std::tr1::make_tuple(std::tr1::_Nil_obj)));
+	inline std::unique_ptr<CancelableTask> MakeRunnableFunction(Func &&func) {
+		typedef typename std::decay<Func>::type Function;
+		return std::unique_ptr<CancelableTask>(new RunnableFunction<Function, internal::Params0>(Function(std::forward<Func>(func)),
+			internal::Params0()));
 	}
 
 	template<class Func, class A>
-	inline std::shared_ptr<CancelableTask> MakeRunnableFunction(Func func, const A &a) {
-		return std::shared_ptr<CancelableTask>(new RunnableFunction<func, std::tr1::tuple<A>>(func, std::tr1::make_tuple(a)));
+	inline std::unique_ptr<CancelableTask> MakeRunnableFunction(Func &&func, A &&a) {
+		typedef typename std::decay<Func>::type Function;
+		typedef internal::Params1<typename std::decay<A>::type> Params;
+		return std::unique_ptr<CancelableTask>(new RunnableFunction<Function, Params>(Function(std::forward<Func>(func)), Params(std::forward<A>(a))));
 	}
 
 	template<class Func, class A, class B>
-	inline std::shared_ptr<CancelableTask> MakeRunnableFunction(Func func, const A &a, const B &b) {
-		return std::shared_ptr<CancelableTask>(new RunnableFunction<func, std::tr1::tuple<A, B>>(func, std::tr1::make_tuple(a, b)));
+	inline std::unique_ptr<CancelableTask> MakeRunnableFunction(Func &&func, A &&a, B &&b) {
+		typedef typename std::decay<Func>::type Function;
+		typedef internal::Params2<typename std::decay<A>::type, typename std::decay<B>::type> Params;
+		return std::unique_ptr<CancelableTask>(new RunnableFunction<Function, Params>(Function(std::forward<Func>(func)), Params(std::forward<A>(a), std::forward<B>(b))));
 	}
 
 	template<class Func, class A, class B, class C>
-	inline std::shared_ptr<CancelableTask> MakeRunnableFunction(Func func, const A &a, const B &b, const C &c) {
-		return std::shared_ptr<CancelableTask>(new RunnableFunction<func, std::tr1::tuple<A, B, C>>(func, std::tr1::make_tuple(a, b, c)));
+	inline std::unique_ptr<CancelableTask> MakeRunnableFunction(Func &&func, A &&a, B &&b, C &&c) {
+		typedef typename std::decay<Func>::type Function;
+		typedef internal::Params3<typename std::decay<A>::type, typename std::decay<B>::type, typename std::decay<C>::type> Params;
+		return std::unique_ptr<CancelableTask>(new RunnableFunction<Function, Params>(Function(std::forward<Func>(func)), Params(std::forward<A>(a), std::forward<B>(b), std::forward<C>(c))));
 	}
 
 	template<class Func, class A, class B, class C, class D>
-	inline std::shared_ptr<CancelableTask> MakeRunnableFunction(Func func, const A &a, const B &b, const C &c, const D &d) {
-		return std::shared_ptr<CancelableTask>(new RunnableFunction<func, std::tr1::tuple<A, B, C, D>>(func, std::tr1::make_tuple(a, b, c, d)));
+	inline std::unique_ptr<CancelableTask> MakeRunnableFunction(Func &&func, A &&a, B &&b, C &&c, D &&d) {
+		typedef typename std::decay<Func>::type Function;
+		typedef internal::Params4<typename std::decay<A>::type, typename std::decay<B>::type, typename std::decay<C>::type, typename std::decay<D>::type> Params;
+		return std::unique_ptr<CancelableTask>(new RunnableFunction<Function, Params>(Function(std::forward<Func>(func)), Params(std::forward<A>(a), std::forward<B>(b), std::forward<C>(c), std::forward<D>(d))));
 	}
 
 	template<class Func, class A, class B, class C, class D, class E>
-	inline std::shared_ptr<CancelableTask> MakeRunnableFunction(Func func, const A &a, const B &b, const C &c, const D &d, const E &e) {
-		return std::shared_ptr<CancelableTask>(new RunnableFunction<func, std::tr1::tuple<A, B, C, D, E>>(func, std::tr1::make_tuple(a, b, c, d, e)));
+	inline std::unique_ptr<CancelableTask> MakeRunnableFunction(Func &&func, A &&a, B &&b, C &&c, D &&d, E &&e) {
+		typedef typename std::decay<Func>::type Function;
+		typedef internal::Params5<typename std::decay<A>::type, typename std::decay<B>::type, typename std::decay<C>::type, typename std::decay<D>::type, typename std::decay<E>::type> Params;
+		return std::unique_ptr<CancelableTask>(new RunnableFunction<Function, Params>(Function(std::forward<Func>(func)), Params(std::forward<A>(a), std::forward<B>(b), std::forward<C>(c), std::forward<D>(d), std::forward<E>(e))));
 	}
 
 	template<class Func, class A, class B, class C, class D, class E, class F>
-	inline std::shared_ptr<CancelableTask> MakeRunnableFunction(Func func, const A &a, const B &b, const C &c, const D &d, const E &e, const F &f) {
-		return std::shared_ptr<CancelableTask>(new RunnableFunction<func, std::tr1::tuple<A, B, C, D, E, F>>(func, std::tr1::make_tuple(a, b, c, d, e, f)));
+	inline std::unique_ptr<CancelableTask> MakeRunnableFunction(Func &&func, A &&a, B &&b, C &&c, D &&d, E &&e, F &&f) {
+		typedef typename std::decay<Func>::type Function;
+		typedef internal::Params6<typename std::decay<A>::type, typename std::decay<B>::type, typename std::decay<C>::type, typename std::decay<D>::type, typename std::decay<E>::type, typename std::decay<F>::type> Params;
+		return std::unique_ptr<CancelableTask>(new RunnableFunction<Function, Params>(Function(std::forward<Func>(func)), Params(std::forward<A>(a), std::forward<B>(b), std::forward<C>(c), std::forward<D>(d), std::forward<E>(e), std::forward<F>(f))));
 	}
 
 	template<class Func, class A, class B, class C, class D, class E, class F, class G>
-	inline std::shared_ptr<CancelableTask> MakeRunnableFunction(Func func, const A &a, const B &b, const C &c, const D &d, const E &e, const F &f,
-		const G &g) {
-		return std::shared_ptr<CancelableTask>(new RunnableFunction<func, std::tr1::tuple<A, B, C, D, E, F, G>>(func, std::tr1::make_tuple(a, b, c, d, e, f, 
-			g)));
+	inline std::unique_ptr<CancelableTask> MakeRunnableFunction(Func &&func, A &&a, B &&b, C &&c, D &&d, E &&e, F &&f, G &&g) {
+		typedef typename std::decay<Func>::type Function;
+		typedef internal::Params7<typename std::decay<A>::type, typename std::decay<B>::type, typename std::decay<C>::type, typename std::decay<D>::type, typename std::decay<E>::type, typename std::decay<F>::type, typename std::decay<G>::type> Params;
+		return std::unique_ptr<CancelableTask>(new RunnableFunction<Function, Params>(Function(std::forward<Func>(func)), Params(std::forward<A>(a), std::forward<B>(b), std::forward<C>(c), std::forward<D>(d), std::forward<E>(e), std::forward<F>(f), std::forward<G>(g))));
 	}
 
 	template<class Func, class A, class B, class C, class D, class E, class F, class G, class H>
-	inline std::shared_ptr<CancelableTask> MakeRunnableFunction(Func func, const A &a, const B &b, const C &c, const D &d, const E &e, const F &f,
-		const G &g, const H &h) {
-			return std::shared_ptr<CancelableTask>(new RunnableFunction<func, std::tr1::tuple<A, B, C, D, E, F, G, H>>(func, std::tr1::make_tuple(a, b, c, d, e, f, 
-				g, h)));
+	inline std::unique_ptr<CancelableTask> MakeRunnableFunction(Func &&func, A &&a, B &&b, C &&c, D &&d, E &&e, F &&f, G &&g, H &&h) {
+		typedef typename std::decay<Func>::type Function;
+		typedef internal::Params8<typename std::decay<A>::type, typename std::decay<B>::type, typename std::decay<C>::type, typename std::decay<D>::type, typename std::decay<E>::type, typename std::decay<F>::type, typename std::decay<G>::type, typename std::decay<H>::type> Params;
+		return std::unique_ptr<CancelableTask>(new RunnableFunction<Function, Params>(Function(std::forward<Func>(func)), Params(std::forward<A>(a), std::forward<B>(b), std::forward<C>(c), std::forward<D>(d), std::forward<E>(e), std::forward<F>(f), std::forward<G>(g), std::forward<H>(h))));
 	}
 
 	template<class Func, class A, class B, class C, class D, class E, class F, class G, class H, class I>
-	inline std::shared_ptr<CancelableTask> MakeRunnableFunction(Func func, const A &a, const B &b, const C &c, const D &d, const E &e, const F &f,
-		const G &g, const H &h, const I &i) {
-			return std::shared_ptr<CancelableTask>(new RunnableFunction<func, std::tr1::tuple<A, B, C, D, E, F, G, H, I>>(func, std::tr1::make_tuple(a, b, c, d, e, f, 
-				g, h, i)));
+	inline std::unique_ptr<CancelableTask> MakeRunnableFunction(Func &&func, A &&a, B &&b, C &&c, D &&d, E &&e, F &&f, G &&g, H &&h, I &&i) {
+		typedef typename std::decay<Func>::type Function;
+		typedef internal::Params9<typename std::decay<A>::type, typename std::decay<B>::type, typename std::decay<C>::type, typename std::decay<D>::type, typename std::decay<E>::type, typename std::decay<F>::type, typename std::decay<G>::type, typename std::decay<H>::type, typename std::decay<I>::type> Params;
+		return std::unique_ptr<CancelableTask>(new RunnableFunction<Function, Params>(Function(std::forward<Func>(func)), Params(std::forward<A>(a), std::forward<B>(b), std::forward<C>(c), std::forward<D>(d), std::forward<E>(e), std::forward<F>(f), std::forward<G>(g), std::forward<H>(h), std::forward<I>(i))));
 	}
 }
 #endif// BASE_FRAMEWORK_TASK_H__
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include <string>
+#include <vector>
+#include "base/framework/message_loop.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/test/perf_reporter.h"
+#include "base/test/test_with_exit_manager.h"
+#include "base/thread/thread.h"
+
+using base::Thread;
+using base::WaitableEvent;
+
+namespace {
+	const size_t kPayloadSize = 1024 * 1024;
+	const int kTaskCount = 200;
+
+	class Sink {
+	public:
+		Sink() : bytes_(0) {
+		}
+
+		void Consume(const std::vector<char> &payload) {
+			bytes_ += payload.size();
+		}
+
+		void Own(std::vector<char> payload) {
+			bytes_ += payload.size();
+		}
+
+		int64_t bytes_;
+	};
+
+	enum BindMode {
+		kCopy,
+		kMove,
+		kPassed
+	};
+
+	void PostPayloads(const char *name, BindMode mode) {
+		Thread thread;
+		thread.Start();
+		Sink sink;
+		base::PerfReporter reporter(kTaskCount);
+		base::StopWatch watch(base::StringPiece(name), &reporter);
+		watch.Start();
+		for (int i = 0; i < kTaskCount; ++i) {
+			std::vector<char> payload(kPayloadSize);
+			if (mode == kCopy) {
+				thread.message_loop()->PostTask(base::MakeRunnableMethod(&sink, &Sink::Consume, payload));
+			}else if (mode == kMove) {
+				thread.message_loop()->PostTask(base::MakeRunnableMethod(&sink, &Sink::Consume, std::move(payload)));
+			}else {
+				thread.message_loop()->PostTask(base::MakeRunnableMethod(&sink, &Sink::Own, base::Passed(std::move(payload))));
+			}
+		}
+		WaitableEvent done(false, false);
+		thread.message_loop()->PostTask(base::MakeRunnableMethod(&done, &WaitableEvent::Signal));
+		done.Wait();
+		watch.Stop();
+		watch.Report();
+		thread.Stop();
+		EXPECT_EQ(static_cast<int64_t>(kPayloadSize) * kTaskCount, sink.bytes_);
+	}
+}
+
+// A 1MB payload bound by copy, by move, and moved on into the call.
+TEST_WITH_EM(TaskPerfTest, CopyPayload) {
+	PostPayloads("1MB payload copied into the task", kCopy);
+}
+
+TEST_WITH_EM(TaskPerfTest, MovePayload) {
+	PostPayloads("1MB payload moved into the task", kMove);
+}
+
+TEST_WITH_EM(TaskPerfTest, PassPayload) {
+	PostPayloads("1MB payload moved into the call", kPassed);
+}
@@ -0,0 +1,66 @@
+#include "base/framework/task_timing.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace base {
+	namespace {
+		bool MoreRunTime(const TaskTiming &a, const TaskTiming &b) {
+			return a.total_run_us_ > b.total_run_us_;
+		}
+	}
+
+	void TaskTimingCollector::Record(const Location &location, TimeSpan queueing, TimeSpan run, TimeSpan cpu) {
+		int64_t queueing_us = queueing.ToMicroseconds();
+		int64_t run_us = run.ToMicroseconds();
+		AutoLock lock(lock_);
+		TaskTiming &timing = timings_[location];
+		if (timing.run_count_ == 0) {
+			timing.location_ = location;
+		}
+		++timing.run_count_;
+		timing.total_queueing_us_ += queueing_us;
+		if (queueing_us > timing.max_queueing_us_) {
+			timing.max_queueing_us_ = queueing_us;
+		}
+		timing.total_run_us_ += run_us;
+		if (run_us > timing.max_run_us_) {
+			timing.max_run_us_ = run_us;
+		}
+		timing.total_cpu_us_ += cpu.ToMicroseconds();
+	}
+
+	std::vector<TaskTiming> TaskTimingCollector::Snapshot() const {
+		std::vector<TaskTiming> timings;
+		AutoLock lock(lock_);
+		timings.reserve(timings_.size());
+		for (std::map<Location, TaskTiming>::const_iterator it = timings_.begin(); it != timings_.end(); ++it) {
+			timings.push_back(it->second);
+		}
+		return timings;
+	}
+
+	void TaskTimingCollector::Reset() {
+		AutoLock lock(lock_);
+		timings_.clear();
+	}
+
+	std::string TaskTimingCollector::Dump() const {
+		// format outside the lock, the loop only waits for the copy.
+		std::vector<TaskTiming> timings = Snapshot();
+		std::sort(timings.begin(), timings.end(), MoreRunTime);
+		std::stringstream stream;
+		for (size_t i = 0; i < timings.size(); ++i) {
+			const TaskTiming &timing = timings[i];
+			stream << timing.location_.ToString()
+				<< " count=" << timing.run_count_
+				<< " queueing_avg_us=" << timing.total_queueing_us_ / timing.run_count_
+				<< " queueing_max_us=" << timing.max_queueing_us_
+				<< " run_avg_us=" << timing.total_run_us_ / timing.run_count_
+				<< " run_max_us=" << timing.max_run_us_
+				<< " cpu_avg_us=" << timing.total_cpu_us_ / timing.run_count_
+				<< "\n";
+		}
+		return stream.str();
+	}
+}
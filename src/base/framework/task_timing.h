@@ -0,0 +1,62 @@
+/*
+ * Aggregate the timing of the tasks a MessageLoop runs by the location they were posted from, so the
+ * code paths which post the slow tasks can be found in a running program.
+ * The loop thread records into its own collector, the lock is only contended while another thread takes
+ * a snapshot, so the loop never stops for a dump.
+ * For example,
+ * loop->EnableTaskTiming(true);
+ * ....
+ * std::string report = loop->task_timing_collector()->Dump();    // on any thread.
+ */
+
+#ifndef BASE_FRAMEWORK_TASK_TIMING_H__
+#define BASE_FRAMEWORK_TASK_TIMING_H__
+
+#include <map>
+#include <string>
+#include <vector>
+#include "base/base_types.h"
+#include "base/framework/location.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "base/util/noncopyable.h"
+
+namespace base {
+	struct TaskTiming {
+		TaskTiming() : run_count_(0), total_queueing_us_(0), max_queueing_us_(0), total_run_us_(0), max_run_us_(0),
+			total_cpu_us_(0) {
+		}
+
+		Location location_;
+		int64_t run_count_;
+		// From being posted to being run. For a delayed task it is from its delayed run time, so it only
+		// counts how late the task ran.
+		int64_t total_queueing_us_;
+		int64_t max_queueing_us_;
+		// The wall time of Run.
+		int64_t total_run_us_;
+		int64_t max_run_us_;
+		// The CPU time the loop thread used in Run, in the resolution of the scheduler tick.
+		int64_t total_cpu_us_;
+	};
+
+	class TaskTimingCollector : public noncopyable {
+	public:
+		TaskTimingCollector() {
+		}
+
+		// Called on the loop thread only.
+		void Record(const Location &location, TimeSpan queueing, TimeSpan run, TimeSpan cpu);
+		// The functions below can be called on any thread.
+		std::vector<TaskTiming> Snapshot() const;
+		void Reset();
+		// One line for each location, the one with the most run time first.
+		std::string Dump() const;
+
+	private:
+		mutable LockImpl lock_;
+		std::map<Location, TaskTiming> timings_;
+	};
+}
+
+#endif// BASE_FRAMEWORK_TASK_TIMING_H__
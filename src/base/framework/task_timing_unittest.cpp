@@ -0,0 +1,141 @@
+#include <string>
+#include <vector>
+#include "base/framework/message_loop.h"
+#include "base/framework/task_timing.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/thread/thread.h"
+#include "base/test/test_with_exit_manager.h"
+
+using base::MessageLoop;
+using base::TaskTiming;
+using base::WaitableEvent;
+
+namespace {
+	class Worker {
+	public:
+		void Nothing() {
+		}
+
+		void Spin(int ms) {
+			base::TimeTicks end = base::TimeTicks::HightResolutionNow() + base::TimeSpan::FromMilliseconds(ms);
+			while (base::TimeTicks::HightResolutionNow() < end) {
+			}
+		}
+
+		void Signal(WaitableEvent *event) {
+			event->Signal();
+		}
+
+		void AddObserver(MessageLoop::TaskObserver *observer) {
+			MessageLoop::current()->AddTaskObserver(observer);
+		}
+
+		void RemoveObserver(MessageLoop::TaskObserver *observer) {
+			MessageLoop::current()->RemoveTaskObserver(observer);
+		}
+	};
+
+	class LineObserver : public MessageLoop::TaskObserver {
+	public:
+		virtual void PreProcessTask(const base::Task &task) {
+			lines_.push_back(task.posted_from().line_number());
+		}
+
+		const std::vector<int>& lines() const {
+			return lines_;
+		}
+
+	private:
+		std::vector<int> lines_;
+	};
+
+	const TaskTiming* FindLine(const std::vector<TaskTiming> &timings, int line) {
+		for (size_t i = 0; i < timings.size(); ++i) {
+			if (timings[i].location_.line_number() == line) {
+				return &timings[i];
+			}
+		}
+		return nullptr;
+	}
+}
+
+TEST(Location, FromHere) {
+	base::Location location = FROM_HERE;
+	EXPECT_EQ(__LINE__ - 1, location.line_number());
+	EXPECT_EQ(std::string(__FILE__), location.file_name());
+	EXPECT_NE(std::string::npos, location.ToString().find(__FILE__));
+}
+
+TEST(TaskTimingCollector, Record) {
+	base::TaskTimingCollector collector;
+	base::Location here = FROM_HERE;
+	collector.Record(here, base::TimeSpan::FromMicroseconds(10), base::TimeSpan::FromMicroseconds(100), base::TimeSpan());
+	collector.Record(here, base::TimeSpan::FromMicroseconds(30), base::TimeSpan::FromMicroseconds(300), base::TimeSpan());
+	std::vector<TaskTiming> timings = collector.Snapshot();
+	ASSERT_EQ(1u, timings.size());
+	EXPECT_EQ(2, timings[0].run_count_);
+	EXPECT_EQ(40, timings[0].total_queueing_us_);
+	EXPECT_EQ(30, timings[0].max_queueing_us_);
+	EXPECT_EQ(400, timings[0].total_run_us_);
+	EXPECT_EQ(300, timings[0].max_run_us_);
+	collector.Reset();
+	EXPECT_TRUE(collector.Snapshot().empty());
+}
+
+TEST_WITH_EM(TaskTiming, ByPostingLocation) {
+	Worker worker;
+	base::Thread thread;
+	thread.Start();
+	MessageLoop *loop = thread.message_loop();
+	loop->EnableTaskTiming(true);
+	for (int i = 0; i < 10; ++i) {
+		loop->PostTask(FROM_HERE, base::MakeRunnableMethod(&worker, &Worker::Nothing));
+	}
+	const int kNothingLine = __LINE__ - 2;
+	loop->PostTask(FROM_HERE, base::MakeRunnableMethod(&worker, &Worker::Spin, 30));
+	const int kSpinLine = __LINE__ - 1;
+	WaitableEvent done(false, false);
+	loop->PostTask(FROM_HERE, base::MakeRunnableMethod(&worker, &Worker::Signal, &done));
+	done.Wait();
+	// dumped while the loop keeps running.
+	std::vector<TaskTiming> timings = loop->task_timing_collector()->Snapshot();
+	const TaskTiming *nothing = FindLine(timings, kNothingLine);
+	const TaskTiming *spin = FindLine(timings, kSpinLine);
+	ASSERT_TRUE(nothing != nullptr);
+	ASSERT_TRUE(spin != nullptr);
+	EXPECT_EQ(10, nothing->run_count_);
+	EXPECT_EQ(1, spin->run_count_);
+	EXPECT_GE(spin->total_run_us_, 30000);
+	EXPECT_LT(nothing->max_run_us_, spin->max_run_us_);
+	EXPECT_EQ(0u, loop->task_timing_collector()->Dump().find(spin->location_.ToString()));
+	thread.Stop();
+}
+
+// The timings are keyed by location, and a name from another module is another literal.
+TEST_WITH_EM(TaskTiming, LocationsCompareByName) {
+	char file[] = "foo.cpp";
+	char same_file[] = "foo.cpp";
+	base::Location location("Run", file, 10);
+	base::Location same("Run", same_file, 10);
+	EXPECT_FALSE(location < same);
+	EXPECT_FALSE(same < location);
+	EXPECT_TRUE(location < base::Location("Run", "foo.cpp", 11));
+	EXPECT_TRUE(location < base::Location("Run", "goo.cpp", 1));
+	EXPECT_TRUE(base::Location("Quit", "foo.cpp", 10) < location);
+}
+
+TEST_WITH_EM(TaskTiming, ObserverSeesLocation) {
+	Worker worker;
+	LineObserver observer;
+	base::Thread thread;
+	thread.Start();
+	MessageLoop *loop = thread.message_loop();
+	loop->PostTask(base::MakeRunnableMethod(&worker, &Worker::AddObserver, static_cast<MessageLoop::TaskObserver*>(&observer)));
+	loop->PostTask(FROM_HERE, base::MakeRunnableMethod(&worker, &Worker::Nothing));
+	const int kLine = __LINE__ - 1;
+	loop->PostTask(FROM_HERE, base::MakeRunnableMethod(&worker, &Worker::RemoveObserver, static_cast<MessageLoop::TaskObserver*>(&observer)));
+	thread.Stop();
+	ASSERT_EQ(2u, observer.lines().size());
+	EXPECT_EQ(kLine, observer.lines()[0]);
+	EXPECT_EQ(kLine + 2, observer.lines()[1]);
+}
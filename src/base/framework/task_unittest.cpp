@@ -0,0 +1,123 @@
+#include <memory>
+#include <string>
+#include "base/framework/task.h"
+#include "base/test/test_with_exit_manager.h"
+
+namespace {
+	// Counts how it is copied and moved.
+	class Payload {
+	public:
+		Payload() : copies_(0), moves_(0) {
+		}
+
+		Payload(const Payload &other) : copies_(other.copies_ + 1), moves_(other.moves_) {
+		}
+
+		Payload(Payload &&other) : copies_(other.copies_), moves_(other.moves_ + 1) {
+		}
+
+		int copies_;
+		int moves_;
+	};
+
+	class Receiver {
+	public:
+		Receiver() : copies_(-1), value_(0) {
+		}
+
+		void TakeRef(const Payload &payload) {
+			copies_ = payload.copies_;
+		}
+
+		void TakeMutable(int &value) {
+			value_ = ++value;
+		}
+
+		void TakeOwnership(std::unique_ptr<int> value) {
+			value_ = *value;
+		}
+
+		void TakeMany(int a, const std::string &b, const Payload &c, double d) {
+			value_ = a + static_cast<int>(b.size()) + static_cast<int>(d);
+			copies_ = c.copies_;
+		}
+
+		int copies_;
+		int value_;
+	};
+
+	void AddTo(int *sum, int value) {
+		*sum += value;
+	}
+}
+
+TEST_WITH_EM(Task, RvalueIsMovedIn) {
+	Receiver receiver;
+	std::unique_ptr<base::CancelableTask> task = base::MakeRunnableMethod(&receiver, &Receiver::TakeRef, Payload());
+	task->Run();
+	EXPECT_EQ(0, receiver.copies_);
+}
+
+TEST_WITH_EM(Task, LvalueIsCopiedOnce) {
+	Receiver receiver;
+	Payload payload;
+	std::unique_ptr<base::CancelableTask> task = base::MakeRunnableMethod(&receiver, &Receiver::TakeRef, payload);
+	task->Run();
+	EXPECT_EQ(1, receiver.copies_);
+	// the bound params stay with the task.
+	task->Run();
+	EXPECT_EQ(1, receiver.copies_);
+}
+
+TEST_WITH_EM(Task, MutableReference) {
+	Receiver receiver;
+	std::unique_ptr<base::CancelableTask> task = base::MakeRunnableMethod(&receiver, &Receiver::TakeMutable, 1);
+	task->Run();
+	EXPECT_EQ(2, receiver.value_);
+	task->Run();
+	EXPECT_EQ(3, receiver.value_);
+}
+
+TEST_WITH_EM(Task, PassedMoveOnly) {
+	Receiver receiver;
+	std::unique_ptr<int> value(new int(42));
+	std::unique_ptr<base::CancelableTask> task = base::MakeRunnableMethod(&receiver, &Receiver::TakeOwnership,
+		base::Passed(std::move(value)));
+	EXPECT_TRUE(value == nullptr);
+	task->Run();
+	EXPECT_EQ(42, receiver.value_);
+}
+
+TEST_WITH_EM(Task, ManyParams) {
+	Receiver receiver;
+	std::unique_ptr<base::CancelableTask> task = base::MakeRunnableMethod(&receiver, &Receiver::TakeMany, 1, std::string("abc"),
+		Payload(), 2.5);
+	task->Run();
+	EXPECT_EQ(6, receiver.value_);
+	EXPECT_EQ(0, receiver.copies_);
+}
+
+TEST_WITH_EM(Task, Function) {
+	int sum = 0;
+	std::unique_ptr<base::CancelableTask> task = base::MakeRunnableFunction(&AddTo, &sum, 5);
+	task->Run();
+	EXPECT_EQ(5, sum);
+	task->Cancel();
+	task->Run();
+	EXPECT_EQ(5, sum);
+}
+
+TEST_WITH_EM(Task, Lambda) {
+	int sum = 0;
+	std::string text("hello");
+	std::unique_ptr<base::CancelableTask> task = base::MakeRunnableFunction([&sum, text](int value) {
+		sum += value + static_cast<int>(text.size());
+	}, 10);
+	task->Run();
+	EXPECT_EQ(15, sum);
+	std::unique_ptr<base::CancelableTask> no_params = base::MakeRunnableFunction([&sum]() {
+		sum = 0;
+	});
+	no_params->Run();
+	EXPECT_EQ(0, sum);
+}
@@ -0,0 +1,294 @@
+#include "base/framework/timing_wheel.h"
+
+#include <intrin.h>
+#include <string.h>
+
+namespace base {
+	namespace {
+		// The index of the highest set bit of a non-zero value.
+		int HighestBit(int64_t value) {
+			unsigned long index;
+			unsigned long high = static_cast<unsigned long>(value >> 32);
+			if (high != 0) {
+				_BitScanReverse(&index, high);
+				return static_cast<int>(index) + 32;
+			}
+			_BitScanReverse(&index, static_cast<unsigned long>(value));
+			return static_cast<int>(index);
+		}
+	}
+
+	TimingWheel::TimingWheel(TimeSpan resolution)
+		: resolution_(resolution.ToMicroseconds()), size_(0), ready_head_(nullptr), ready_tail_(nullptr) {
+		assert(resolution_ > 0);
+		current_tick_ = TimeTicks::Now().ToInternalValue() / resolution_;
+		memset(slots_, 0, sizeof(slots_));
+		memset(bitmaps_, 0, sizeof(bitmaps_));
+	}
+
+	TimingWheel::~TimingWheel() {
+		assert(size_ == 0);
+	}
+
+	void TimingWheel::Push(Task *task) {
+		task->set_next(nullptr);
+		Insert(task);
+		++size_;
+	}
+
+	TimeTicks TimingWheel::NextRunTime() {
+		if (ready_head_ != nullptr) {
+			return ready_head_->delayed_run_time();
+		}
+		int64_t tick;
+		if (!FindNextTick(&tick)) {
+			return TimeTicks();
+		}
+		return TimeTicks(tick * resolution_);
+	}
+
+	TimeSpan TimingWheel::NextLeeway() {
+		if (ready_head_ != nullptr) {
+			return ready_head_->leeway();
+		}
+		int64_t tick;
+		if (!FindNextTick(&tick)) {
+			return TimeSpan();
+		}
+		// the first task of a slot of level 0, the slots of the higher levels have to be cascaded in time.
+		Task *task = slots_[0][tick & (kSlots - 1)].head_;
+		if (task == nullptr || ToTick(task->delayed_run_time()) != tick) {
+			return TimeSpan();
+		}
+		return task->leeway();
+	}
+
+	Task* TimingWheel::PopDue(TimeTicks now) {
+		if (ready_head_ != nullptr) {
+			return PopReady();
+		}
+		int64_t now_tick = now.ToInternalValue() / resolution_;
+		int64_t tick;
+		while (current_tick_ <= now_tick) {
+			if (!FindNextTick(&tick) || tick > now_tick) {
+				// nothing happens until the tick, so we can move on without cascading anything.
+				current_tick_ = now_tick;
+				break;
+			}
+			current_tick_ = tick;
+			Cascade(tick);
+			int index = static_cast<int>(tick & (kSlots - 1));
+			if (slots_[0][index].head_ != nullptr) {
+				bool unordered = slots_[0][index].unordered_;
+				Task *list = DetachSlot(0, index);
+				ready_head_ = unordered ? SortBySequence(list) : list;
+				for (ready_tail_ = ready_head_; ready_tail_->next() != nullptr; ready_tail_ = ready_tail_->next()) {
+				}
+				return PopReady();
+			}
+		}
+		return nullptr;
+	}
+
+	Task* TimingWheel::TakeAll() {
+		Task *list = ready_head_;
+		ready_head_ = ready_tail_ = nullptr;
+		for (int level = 0; level < kLevels; ++level) {
+			for (int index = FindSlot(level, 0); index >= 0; index = FindSlot(level, index + 1)) {
+				Slot &slot = slots_[level][index];
+				slot.tail_->set_next(list);
+				list = DetachSlot(level, index);
+			}
+		}
+		size_ = 0;
+		return list;
+	}
+
+	Task* TimingWheel::TakeCanceled() {
+		Task *canceled = nullptr;
+		size_ -= RemoveCanceled(&ready_head_, &ready_tail_, &canceled);
+		for (int level = 0; level < kLevels; ++level) {
+			for (int index = FindSlot(level, 0); index >= 0; index = FindSlot(level, index + 1)) {
+				Slot &slot = slots_[level][index];
+				size_ -= RemoveCanceled(&slot.head_, &slot.tail_, &canceled);
+				if (slot.head_ == nullptr) {
+					DetachSlot(level, index);
+				}
+			}
+		}
+		return canceled;
+	}
+
+	int64_t TimingWheel::ToTick(TimeTicks time) const {
+		return (time.ToInternalValue() + resolution_ - 1) / resolution_;
+	}
+
+	void TimingWheel::Insert(Task *task) {
+		int64_t tick = ToTick(task->delayed_run_time());
+		if (tick < current_tick_) {
+			if (ready_tail_ != nullptr) {
+				ready_tail_->set_next(task);
+			}else {
+				ready_head_ = task;
+			}
+			ready_tail_ = task;
+			return;
+		}
+		int64_t diff = tick ^ current_tick_;
+		int level = diff < kSlots ? 0 : HighestBit(diff) / kBitsPerLevel;
+		int index = static_cast<int>((tick >> (level * kBitsPerLevel)) & (kSlots - 1));
+		Append(level, index, task);
+	}
+
+	void TimingWheel::Append(int level, int index, Task *task) {
+		Slot &slot = slots_[level][index];
+		if (slot.tail_ != nullptr) {
+			slot.unordered_ |= slot.tail_->sequence_num() > task->sequence_num();
+			slot.tail_->set_next(task);
+		}else {
+			slot.head_ = task;
+			bitmaps_[level][index >> 5] |= 1u << (index & 31);
+		}
+		slot.tail_ = task;
+	}
+
+	Task* TimingWheel::DetachSlot(int level, int index) {
+		Slot &slot = slots_[level][index];
+		Task *list = slot.head_;
+		slot.head_ = slot.tail_ = nullptr;
+		slot.unordered_ = false;
+		bitmaps_[level][index >> 5] &= ~(1u << (index & 31));
+		return list;
+	}
+
+	size_t TimingWheel::RemoveCanceled(Task **head, Task **tail, Task **canceled) {
+		size_t count = 0;
+		Task *previous = nullptr;
+		Task *task = *head;
+		while (task != nullptr) {
+			Task *next = task->next();
+			if (task->IsCanceled()) {
+				if (previous != nullptr) {
+					previous->set_next(next);
+				}else {
+					*head = next;
+				}
+				task->set_next(*canceled);
+				*canceled = task;
+				++count;
+			}else {
+				previous = task;
+			}
+			task = next;
+		}
+		*tail = previous;
+		return count;
+	}
+
+	void TimingWheel::Cascade(int64_t tick) {
+		// From the highest level, so the tasks cascaded from a level can be cascaded again by the lower levels.
+		for (int level = kLevels - 1; level > 0; --level) {
+			int shift = level * kBitsPerLevel;
+			if ((tick & ((static_cast<int64_t>(1) << shift) - 1)) != 0) {
+				continue;
+			}
+			int index = static_cast<int>((tick >> shift) & (kSlots - 1));
+			if (slots_[level][index].head_ == nullptr) {
+				continue;
+			}
+			Task *list = DetachSlot(level, index);
+			while (list != nullptr) {
+				Task *next = list->next();
+				list->set_next(nullptr);
+				Insert(list);
+				list = next;
+			}
+		}
+	}
+
+	bool TimingWheel::FindNextTick(int64_t *tick) const {
+		for (int level = 0; level < kLevels; ++level) {
+			int shift = level * kBitsPerLevel;
+			int digit = static_cast<int>((current_tick_ >> shift) & (kSlots - 1));
+			// Above level 0, the slot of the current tick is always empty since its tasks belong to the lower levels.
+			int index = FindSlot(level, level == 0 ? digit : digit + 1);
+			if (index < 0) {
+				continue;
+			}
+			int64_t block = 0;
+			if (level + 1 < kLevels) {
+				int block_shift = shift + kBitsPerLevel;
+				block = (current_tick_ >> block_shift) << block_shift;
+			}
+			*tick = block | (static_cast<int64_t>(index) << shift);
+			return true;
+		}
+		return false;
+	}
+
+	int TimingWheel::FindSlot(int level, int from) const {
+		if (from >= kSlots) {
+			return -1;
+		}
+		int word = from >> 5;
+		uint32_t bits = bitmaps_[level][word] & (~0u << (from & 31));
+		for (; ;) {
+			if (bits != 0) {
+				unsigned long index;
+				_BitScanForward(&index, bits);
+				return (word << 5) + static_cast<int>(index);
+			}
+			if (++word == kWordsPerBitmap) {
+				return -1;
+			}
+			bits = bitmaps_[level][word];
+		}
+	}
+
+	Task* TimingWheel::PopReady() {
+		Task *task = ready_head_;
+		ready_head_ = task->next();
+		if (ready_head_ == nullptr) {
+			ready_tail_ = nullptr;
+		}
+		task->set_next(nullptr);
+		--size_;
+		return task;
+	}
+
+	Task* TimingWheel::SortBySequence(Task *list) {
+		if (list == nullptr || list->next() == nullptr) {
+			return list;
+		}
+		// split the list into two halves.
+		Task *slow = list;
+		Task *fast = list->next();
+		while (fast != nullptr && fast->next() != nullptr) {
+			slow = slow->next();
+			fast = fast->next()->next();
+		}
+		Task *second = slow->next();
+		slow->set_next(nullptr);
+		Task *a = SortBySequence(list);
+		Task *b = SortBySequence(second);
+		Task *head = nullptr;
+		Task *tail = nullptr;
+		while (a != nullptr || b != nullptr) {
+			Task *task;
+			if (b == nullptr || (a != nullptr && a->sequence_num() <= b->sequence_num())) {
+				task = a;
+				a = a->next();
+			}else {
+				task = b;
+				b = b->next();
+			}
+			if (tail != nullptr) {
+				tail->set_next(task);
+			}else {
+				head = task;
+			}
+			tail = task;
+		}
+		return head;
+	}
+}
@@ -0,0 +1,85 @@
+/*
+ * A hierarchical timing wheel which can be used as the delayed task queue of a MessageLoop. Push and
+ * PopDue cost O(1) no matter how many tasks are pending, while the heap costs O(log n) for each, so it
+ * suits the loops which keep a huge number of pending timeouts.
+ *
+ * The time is divided into ticks of the resolution of the wheel. A task becomes due at the end of the
+ * tick which contains its delayed run time, so it never runs early but may run up to one tick late,
+ * and the tasks due in the same tick run in the order they were posted.
+ *
+ * The wheel has kLevels levels of kSlots slots. Level 0 holds the tasks due in the same block of kSlots
+ * ticks as the current tick, one slot for each tick. Level n holds the tasks due in the same block of
+ * kSlots^(n+1) ticks as the current tick but not in the same block of kSlots^n ticks, one slot for each
+ * block of kSlots^n ticks. When the current tick enters such a block, its slot is cascaded down into
+ * the lower levels. With 8 levels of 256 slots every tick of a 64 bits time fits into the wheel.
+ * ref: Varghese & Lauck, "Hashed and Hierarchical Timing Wheels".
+ */
+
+#ifndef BASE_FRAMEWORK_TIMING_WHEEL_H__
+#define BASE_FRAMEWORK_TIMING_WHEEL_H__
+
+#include "base/base_types.h"
+#include "base/framework/delayed_task_queue.h"
+
+namespace base {
+	class TimingWheel : public DelayedTaskQueue {
+	public:
+		explicit TimingWheel(TimeSpan resolution = TimeSpan::FromMilliseconds(1));
+		virtual ~TimingWheel();
+		virtual void Push(Task *task);
+		virtual TimeTicks NextRunTime();
+		virtual TimeSpan NextLeeway();
+		virtual Task* PopDue(TimeTicks now);
+		virtual Task* TakeAll();
+		virtual Task* TakeCanceled();
+		virtual size_t size() const {
+			return size_;
+		}
+
+	private:
+		enum {
+			kBitsPerLevel = 8,
+			kSlots = 1 << kBitsPerLevel,
+			kLevels = 64 / kBitsPerLevel,
+			kWordsPerBitmap = kSlots / 32
+		};
+
+		struct Slot {
+			Task *head_;
+			Task *tail_;
+			// Set when a task is appended behind a task posted after it, which happens when the tasks
+			// cascaded from a higher level meet the ones pushed into the slot directly.
+			bool unordered_;
+		};
+
+		// The tick at the end of which the time is due.
+		int64_t ToTick(TimeTicks time) const;
+		// Put the task into the slot for its tick, or into the ready list if the tick has passed.
+		void Insert(Task *task);
+		void Append(int level, int index, Task *task);
+		Task* DetachSlot(int level, int index);
+		// Unlink the canceled tasks of the list from head to tail and put them in front of canceled,
+		// return the number of them.
+		static size_t RemoveCanceled(Task **head, Task **tail, Task **canceled);
+		// Cascade the slots of the blocks which begin at the tick down into the lower levels.
+		void Cascade(int64_t tick);
+		// Find the first tick not earlier than the current tick at which a slot should be handled.
+		bool FindNextTick(int64_t *tick) const;
+		// Find the first non-empty slot of the level whose index is not less than from, -1 if there is none.
+		int FindSlot(int level, int from) const;
+		Task* PopReady();
+		// Stable merge sort of a list by the sequence num of the tasks.
+		static Task* SortBySequence(Task *list);
+
+		int64_t resolution_;
+		int64_t current_tick_;
+		size_t size_;
+		// The tasks whose tick has been reached, in the order they should run.
+		Task *ready_head_;
+		Task *ready_tail_;
+		Slot slots_[kLevels][kSlots];
+		uint32_t bitmaps_[kLevels][kWordsPerBitmap];
+	};
+}
+
+#endif// BASE_FRAMEWORK_TIMING_WHEEL_H__
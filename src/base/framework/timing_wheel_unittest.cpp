@@ -0,0 +1,156 @@
+#include <stdlib.h>
+#include <vector>
+#include "base/framework/timing_wheel.h"
+#include "base/test/test_tasks.h"
+#include "base/thread/thread.h"
+#include "base/test/test_with_exit_manager.h"
+
+using base::Task;
+using base::TimeSpan;
+using base::TimeTicks;
+using base::TimingWheel;
+
+namespace {
+	class Timer : public Task {
+	public:
+		Timer(TimeTicks run_time, int sequence_num) {
+			set_delayed_run_time(run_time);
+			set_sequence_num(sequence_num);
+		}
+
+		virtual void Run() {
+		}
+	};
+
+	// The tick of the wheel with the default resolution of 1ms.
+	int64_t Tick(TimeTicks time) {
+		return (time.ToInternalValue() + 999) / 1000;
+	}
+
+	void DeleteList(Task *list) {
+		while (list != nullptr) {
+			Task *next = list->next();
+			delete list;
+			list = next;
+		}
+	}
+}
+
+TEST(TimingWheel, Empty) {
+	TimingWheel wheel;
+	EXPECT_TRUE(wheel.empty());
+	EXPECT_TRUE(wheel.NextRunTime().IsNull());
+	EXPECT_TRUE(wheel.PopDue(TimeTicks::Now() + TimeSpan::FromDays(1)) == nullptr);
+	EXPECT_TRUE(wheel.TakeAll() == nullptr);
+}
+
+TEST(TimingWheel, SameTickInPostedOrder) {
+	TimingWheel wheel;
+	TimeTicks run_time = TimeTicks::Now() + TimeSpan::FromMilliseconds(10);
+	for (int i = 0; i < 10; ++i) {
+		wheel.Push(new Timer(run_time, i));
+	}
+	EXPECT_EQ(10u, wheel.size());
+	EXPECT_TRUE(wheel.PopDue(run_time - TimeSpan::FromMilliseconds(1)) == nullptr);
+	for (int i = 0; i < 10; ++i) {
+		Task *task = wheel.PopDue(run_time);
+		ASSERT_TRUE(task != nullptr);
+		EXPECT_EQ(i, task->sequence_num());
+		delete task;
+	}
+	EXPECT_TRUE(wheel.empty());
+}
+
+// The tasks spread over every level, they must come out by their ticks, never early and at most one tick late.
+TEST(TimingWheel, RandomDeadlines) {
+	const int kCount = 20000;
+	TimingWheel wheel;
+	TimeTicks start = TimeTicks::Now();
+	srand(1);
+	for (int i = 0; i < kCount; ++i) {
+		int64_t delay_us = (static_cast<int64_t>(rand() % 32768) << 15 | rand() % 32768) * (1 << (rand() % 12));
+		wheel.Push(new Timer(start + TimeSpan::FromMicroseconds(delay_us), i));
+	}
+	int popped = 0;
+	TimeTicks previous_run_time;
+	int previous_sequence_num = -1;
+	for (TimeTicks now = start; popped < kCount; now += TimeSpan::FromMilliseconds(1 + rand() % 100000)) {
+		ASSERT_FALSE(wheel.NextRunTime().IsNull());
+		while (Task *task = wheel.PopDue(now)) {
+			EXPECT_LE(task->delayed_run_time(), now);
+			// within the same tick the posted order is kept, across the ticks the time order is kept.
+			if (Tick(task->delayed_run_time()) == Tick(previous_run_time)) {
+				EXPECT_GT(task->sequence_num(), previous_sequence_num);
+			}else {
+				EXPECT_LT(previous_run_time, task->delayed_run_time());
+			}
+			previous_run_time = task->delayed_run_time();
+			previous_sequence_num = task->sequence_num();
+			++popped;
+			delete task;
+		}
+		if (!wheel.empty()) {
+			EXPECT_GT(wheel.NextRunTime(), now - TimeSpan::FromMilliseconds(1));
+		}
+	}
+	EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimingWheel, PushAfterTimeMoved) {
+	TimingWheel wheel;
+	TimeTicks start = TimeTicks::Now();
+	wheel.Push(new Timer(start + TimeSpan::FromHours(1), 0));
+	EXPECT_TRUE(wheel.PopDue(start + TimeSpan::FromMinutes(30)) == nullptr);
+	// the past ones come out first.
+	wheel.Push(new Timer(start, 1));
+	wheel.Push(new Timer(start + TimeSpan::FromMinutes(31), 2));
+	Task *task = wheel.PopDue(start + TimeSpan::FromMinutes(30));
+	ASSERT_TRUE(task != nullptr);
+	EXPECT_EQ(1, task->sequence_num());
+	delete task;
+	EXPECT_TRUE(wheel.PopDue(start + TimeSpan::FromMinutes(30)) == nullptr);
+	task = wheel.PopDue(start + TimeSpan::FromHours(2));
+	ASSERT_TRUE(task != nullptr);
+	EXPECT_EQ(2, task->sequence_num());
+	delete task;
+	task = wheel.PopDue(start + TimeSpan::FromHours(2));
+	ASSERT_TRUE(task != nullptr);
+	EXPECT_EQ(0, task->sequence_num());
+	delete task;
+	EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimingWheel, TakeAll) {
+	TimingWheel wheel;
+	TimeTicks start = TimeTicks::Now();
+	for (int i = 0; i < 100; ++i) {
+		wheel.Push(new Timer(start + TimeSpan::FromMilliseconds(i * i * i), i));
+	}
+	delete wheel.PopDue(start);
+	Task *list = wheel.TakeAll();
+	int count = 0;
+	for (Task *task = list; task != nullptr; task = task->next()) {
+		++count;
+	}
+	EXPECT_EQ(99, count);
+	EXPECT_TRUE(wheel.empty());
+	DeleteList(list);
+}
+
+TEST_WITH_EM(TimingWheelMessageLoop, DelayedTasksInOrder) {
+	const int kCount = 20;
+	base::test::Recorder recorder(kCount);
+	base::Thread::Options options;
+	options.delayed_queue_type_ = base::MessageLoop::kTimingWheelDelayedQueue;
+	base::Thread thread;
+	thread.StartWithOptions(options);
+	EXPECT_EQ(base::MessageLoop::kTimingWheelDelayedQueue, thread.message_loop()->delayed_queue_type());
+	for (int i = kCount - 1; i >= 0; --i) {
+		thread.message_loop()->PostDelayTask(base::MakeRunnableMethod(&recorder, &base::test::Recorder::Record, i), i * 5);
+	}
+	recorder.Wait();
+	thread.Stop();
+	for (int i = 0; i < kCount; ++i) {
+		EXPECT_EQ(i, recorder.ids()[i]);
+	}
+}
@@ -60,6 +60,9 @@ namespace base {
 	private:
 		static void OnExit(void *params) {
 			Traits::Delete(instance_);
+			// the instance can be created again by the next AtExitManager.
+			instance_ = nullptr;
+			InterlockedExchange(&state_, static_cast<LONG>(kNotCreate));
 		}
 		friend Type* Type::GetInstance();
 		Singleton() {
@@ -0,0 +1,207 @@
+#include "base/memory/task_allocator.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include "base/memory/singleton.h"
+#include "base/synchronization/lock.h"
+#include "base/synchronization/mpsc_queue.h"
+#include "base/thread/thread_local.h"
+
+namespace base {
+	namespace {
+		const size_t kGranularity = 16;
+		const size_t kSizeClassCount = TaskAllocator::kMaxPooledSize / kGranularity;
+		// The size class of the blocks which are not pooled.
+		const size_t kLargeBlock = kSizeClassCount;
+		// The free blocks a thread keeps of each size, the others go back to the heap.
+		const size_t kMaxCachedBlocks = 1024;
+
+		struct ThreadCache;
+
+		// Put before every block, the link is only used while the block is free.
+		struct BlockHeader : public MpscQueue<BlockHeader>::Node {
+			ThreadCache *owner_;
+			size_t size_class_;
+		};
+
+		// Keeps the blocks aligned as malloc does.
+		const size_t kHeaderSize = (sizeof(BlockHeader) + kGranularity - 1) & ~(kGranularity - 1);
+
+		struct ThreadCache {
+			ThreadCache() : next_orphan_(nullptr) {
+				memset(free_lists_, 0, sizeof(free_lists_));
+				memset(free_counts_, 0, sizeof(free_counts_));
+			}
+
+			BlockHeader *free_lists_[kSizeClassCount];
+			size_t free_counts_[kSizeClassCount];
+			// The blocks freed by the other threads.
+			MpscQueue<BlockHeader> remote_frees_;
+			TaskAllocatorStats stats_;
+			ThreadCache *next_orphan_;
+		};
+
+		// The caches are never deleted, other threads may still free blocks into them. So they are kept
+		// out of LocalStorage and AtExitManager, and the caches of the exited threads are reused.
+		LONG g_slot_state = kNotCreate;
+		internal::ThreadLocalImpl::SlotType g_slot;
+		LockImpl g_orphan_lock;
+		ThreadCache *g_orphans = nullptr;
+
+		internal::ThreadLocalImpl::SlotType& CacheSlot() {
+			if (g_slot_state == kCreated) {
+				return g_slot;
+			}
+			if (InterlockedCompareExchange(&g_slot_state, kCreating, kNotCreate) == kNotCreate) {
+				internal::ThreadLocalImpl::AllocSlot(g_slot);
+				InterlockedExchange(&g_slot_state, kCreated);
+			}else {
+				while (g_slot_state != kCreated) {
+					Sleep(0);
+				}
+			}
+			return g_slot;
+		}
+
+		ThreadCache* CurrentCache() {
+			ThreadCache *cache = static_cast<ThreadCache*>(internal::ThreadLocalImpl::GetValueFromSlot(CacheSlot()));
+			if (cache != nullptr) {
+				return cache;
+			}
+			{
+				AutoLock lock(g_orphan_lock);
+				if (g_orphans != nullptr) {
+					cache = g_orphans;
+					g_orphans = cache->next_orphan_;
+					cache->next_orphan_ = nullptr;
+					cache->stats_ = TaskAllocatorStats();
+				}
+			}
+			if (cache == nullptr) {
+				cache = new ThreadCache();
+			}
+			internal::ThreadLocalImpl::SetValueInSlot(CacheSlot(), cache);
+			return cache;
+		}
+
+		void Recycle(ThreadCache *cache, BlockHeader *block) {
+			size_t size_class = block->size_class_;
+			if (cache->free_counts_[size_class] < kMaxCachedBlocks) {
+				block->set_next(cache->free_lists_[size_class]);
+				cache->free_lists_[size_class] = block;
+				++cache->free_counts_[size_class];
+			}else {
+				free(block);
+			}
+		}
+
+		void DrainRemoteFrees(ThreadCache *cache) {
+			BlockHeader *block = cache->remote_frees_.PopAll();
+			while (block != nullptr) {
+				BlockHeader *next = block->next();
+				Recycle(cache, block);
+				block = next;
+			}
+		}
+
+		BlockHeader* NewBlock(ThreadCache *owner, size_t size_class, size_t size) {
+			void *memory = malloc(kHeaderSize + size);
+			assert(memory != nullptr);
+			BlockHeader *block = new (memory) BlockHeader();
+			block->owner_ = owner;
+			block->size_class_ = size_class;
+			return block;
+		}
+
+		// Called by the loader for every thread which exits, whoever created it.
+		void NTAPI OnThreadExit(PVOID module, DWORD reason, PVOID reserved) {
+			if (reason == DLL_THREAD_DETACH) {
+				TaskAllocator::ReleaseThreadCache();
+			}
+		}
+	}
+
+	void* TaskAllocator::Allocate(size_t size) {
+		ThreadCache *cache = CurrentCache();
+		++cache->stats_.allocations_;
+		BlockHeader *block = nullptr;
+		if (size > kMaxPooledSize) {
+			++cache->stats_.heap_allocations_;
+			block = NewBlock(nullptr, kLargeBlock, size);
+		}else {
+			size_t size_class = size == 0 ? 0 : (size - 1) / kGranularity;
+			if (cache->free_lists_[size_class] == nullptr) {
+				DrainRemoteFrees(cache);
+			}
+			block = cache->free_lists_[size_class];
+			if (block != nullptr) {
+				cache->free_lists_[size_class] = block->next();
+				--cache->free_counts_[size_class];
+			}else {
+				++cache->stats_.heap_allocations_;
+				block = NewBlock(cache, size_class, (size_class + 1) * kGranularity);
+			}
+		}
+		return reinterpret_cast<char*>(block) + kHeaderSize;
+	}
+
+	void TaskAllocator::Free(void *memory) {
+		if (memory == nullptr) {
+			return;
+		}
+		BlockHeader *block = reinterpret_cast<BlockHeader*>(static_cast<char*>(memory) - kHeaderSize);
+		if (block->size_class_ == kLargeBlock) {
+			free(block);
+			return;
+		}
+		ThreadCache *cache = CurrentCache();
+		if (block->owner_ == cache) {
+			Recycle(cache, block);
+		}else {
+			++cache->stats_.remote_frees_;
+			block->owner_->remote_frees_.Push(block);
+		}
+	}
+
+	TaskAllocatorStats TaskAllocator::thread_stats() {
+		return CurrentCache()->stats_;
+	}
+
+	void TaskAllocator::ReleaseThreadCache() {
+		if (g_slot_state != kCreated) {
+			return;
+		}
+		ThreadCache *cache = static_cast<ThreadCache*>(internal::ThreadLocalImpl::GetValueFromSlot(g_slot));
+		if (cache == nullptr) {
+			return;
+		}
+		internal::ThreadLocalImpl::SetValueInSlot(CacheSlot(), nullptr);
+		AutoLock lock(g_orphan_lock);
+		cache->next_orphan_ = g_orphans;
+		g_orphans = cache;
+	}
+}
+
+// Put OnThreadExit among the TLS callbacks of the image, the linker would drop it from a static library
+// without the /INCLUDE.
+#ifdef _WIN64
+#pragma comment(linker, "/INCLUDE:_tls_used")
+#pragma comment(linker, "/INCLUDE:p_task_allocator_thread_exit")
+#else
+#pragma comment(linker, "/INCLUDE:__tls_used")
+#pragma comment(linker, "/INCLUDE:_p_task_allocator_thread_exit")
+#endif
+
+extern "C" {
+#ifdef _WIN64
+#pragma const_seg(".CRT$XLB")
+	extern const PIMAGE_TLS_CALLBACK p_task_allocator_thread_exit;
+	const PIMAGE_TLS_CALLBACK p_task_allocator_thread_exit = base::OnThreadExit;
+#pragma const_seg()
+#else
+#pragma data_seg(".CRT$XLB")
+	PIMAGE_TLS_CALLBACK p_task_allocator_thread_exit = base::OnThreadExit;
+#pragma data_seg()
+#endif
+}
@@ -0,0 +1,53 @@
+/*
+ * A pooled allocator for the task objects. Every thread keeps free lists of task sized blocks, so a task
+ * is allocated without going to the heap once the thread has run for a while. A block freed by another
+ * thread, which is the usual case as a task is deleted by the loop which ran it, is pushed back to the
+ * thread which allocated it with a single compare-and-swap instead of into the global heap.
+ *
+ * Task uses it for itself and all of its subclasses, there is nothing to do to use it.
+ * For example,
+ * base::TaskAllocatorStats before = base::TaskAllocator::thread_stats();
+ * loop->PostTask(base::MakeRunnableMethod(this, &Foo::Bar));
+ * base::TaskAllocatorStats after = base::TaskAllocator::thread_stats();    // after.heap_allocations_ does
+ *                                                                          // not grow in the steady state.
+ *
+ * Blocks larger than kMaxPooledSize go to the heap directly. When a thread exits, base::Thread or not,
+ * its cache and the blocks freed into it later are handed to the next thread which allocates. Only the
+ * cache of the main thread, and of a thread killed by TerminateThread, stay until the process exits.
+ */
+
+#ifndef BASE_MEMORY_TASK_ALLOCATOR_H__
+#define BASE_MEMORY_TASK_ALLOCATOR_H__
+
+#include "base/base_types.h"
+
+namespace base {
+	// The counters of one thread.
+	struct TaskAllocatorStats {
+		TaskAllocatorStats() : allocations_(0), heap_allocations_(0), remote_frees_(0) {
+		}
+
+		// All the blocks allocated by the thread.
+		int64_t allocations_;
+		// The blocks which were not found in the free lists of the thread.
+		int64_t heap_allocations_;
+		// The blocks of other threads freed by the thread.
+		int64_t remote_frees_;
+	};
+
+	class TaskAllocator {
+	public:
+		static const size_t kMaxPooledSize = 256;
+
+		static void* Allocate(size_t size);
+		// Can be called on any thread.
+		static void Free(void *block);
+
+		static TaskAllocatorStats thread_stats();
+
+		// Hand the cache of the calling thread to the next thread, called when any thread exits.
+		static void ReleaseThreadCache();
+	};
+}
+
+#endif// BASE_MEMORY_TASK_ALLOCATOR_H__
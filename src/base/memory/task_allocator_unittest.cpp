@@ -0,0 +1,134 @@
+#include <vector>
+#include "base/framework/message_loop.h"
+#include "base/framework/task.h"
+#include "base/memory/task_allocator.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/thread/thread.h"
+#include "base/test/test_with_exit_manager.h"
+
+using base::TaskAllocator;
+using base::TaskAllocatorStats;
+using base::Thread;
+using base::WaitableEvent;
+
+namespace {
+	class Counter {
+	public:
+		Counter() : count_(0) {
+		}
+
+		void Add(int value) {
+			count_ += value;
+		}
+
+		int count_;
+	};
+
+	void MakeAndDeleteTasks(Counter *counter, int count) {
+		std::vector<base::CancelableTask*> tasks;
+		for (int i = 0; i < count; ++i) {
+			tasks.push_back(base::MakeRunnableMethod(counter, &Counter::Add, i).release());
+		}
+		for (int i = 0; i < count; ++i) {
+			tasks[i]->Run();
+			delete tasks[i];
+		}
+	}
+
+	void PostTasks(base::MessageLoop *loop, Counter *counter, int count) {
+		for (int i = 0; i < count; ++i) {
+			loop->PostTask(base::MakeRunnableMethod(counter, &Counter::Add, 1));
+		}
+		// the tasks above have all been run and freed on the loop when this one runs.
+		WaitableEvent done(false, false);
+		loop->PostTask(base::MakeRunnableMethod(&done, &WaitableEvent::Signal));
+		done.Wait();
+	}
+
+	struct RawThreadBlock {
+		void *block_;
+		int64_t heap_allocations_;
+	};
+
+	// Runs on a thread made by CreateThread, so only the loader tells the allocator that it exits.
+	DWORD WINAPI AllocateOnRawThread(void *param) {
+		RawThreadBlock *result = static_cast<RawThreadBlock*>(param);
+		result->block_ = TaskAllocator::Allocate(48);
+		result->heap_allocations_ = TaskAllocator::thread_stats().heap_allocations_;
+		return 0;
+	}
+
+	void RunRawThread(RawThreadBlock *result) {
+		HANDLE thread = CreateThread(nullptr, 0, &AllocateOnRawThread, result, 0, nullptr);
+		ASSERT_TRUE(thread != nullptr);
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+	}
+}
+
+TEST_WITH_EM(TaskAllocator, ReusesBlocks) {
+	Counter counter;
+	MakeAndDeleteTasks(&counter, 100);
+	TaskAllocatorStats before = TaskAllocator::thread_stats();
+	for (int i = 0; i < 10; ++i) {
+		MakeAndDeleteTasks(&counter, 100);
+	}
+	TaskAllocatorStats after = TaskAllocator::thread_stats();
+	EXPECT_EQ(before.allocations_ + 1000, after.allocations_);
+	EXPECT_EQ(before.heap_allocations_, after.heap_allocations_);
+}
+
+TEST_WITH_EM(TaskAllocator, RemoteFreesGoBackToOwner) {
+	Thread thread;
+	thread.Start();
+	Counter counter;
+	// the last task of a round may still be on its way back when the next one starts, so the pool
+	// grows a little in the first rounds.
+	for (int i = 0; i < 3; ++i) {
+		PostTasks(thread.message_loop(), &counter, 200);
+	}
+	TaskAllocatorStats before = TaskAllocator::thread_stats();
+	for (int i = 0; i < 10; ++i) {
+		PostTasks(thread.message_loop(), &counter, 200);
+	}
+	TaskAllocatorStats after = TaskAllocator::thread_stats();
+	thread.Stop();
+	EXPECT_EQ(13 * 200, counter.count_);
+	// the tasks were freed by the thread and came back to be allocated again here.
+	EXPECT_EQ(before.heap_allocations_, after.heap_allocations_);
+}
+
+TEST_WITH_EM(TaskAllocator, LargeBlocks) {
+	TaskAllocatorStats before = TaskAllocator::thread_stats();
+	void *block = TaskAllocator::Allocate(TaskAllocator::kMaxPooledSize + 1);
+	memset(block, 0, TaskAllocator::kMaxPooledSize + 1);
+	TaskAllocator::Free(block);
+	block = TaskAllocator::Allocate(TaskAllocator::kMaxPooledSize + 1);
+	TaskAllocator::Free(block);
+	TaskAllocatorStats after = TaskAllocator::thread_stats();
+	EXPECT_EQ(before.heap_allocations_ + 2, after.heap_allocations_);
+}
+
+TEST_WITH_EM(TaskAllocator, SizeClasses) {
+	// blocks of one size class are reused for any size in it.
+	void *block = TaskAllocator::Allocate(40);
+	TaskAllocator::Free(block);
+	EXPECT_EQ(block, TaskAllocator::Allocate(33));
+	TaskAllocator::Free(block);
+	void *other = TaskAllocator::Allocate(64);
+	EXPECT_NE(block, other);
+	TaskAllocator::Free(other);
+	EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(block) % 8);
+}
+
+TEST_WITH_EM(TaskAllocator, CacheOfExitedThreadIsReused) {
+	RawThreadBlock first = {nullptr, 0};
+	RunRawThread(&first);
+	// freed after its thread has gone, into the cache it left behind.
+	TaskAllocator::Free(first.block_);
+	RawThreadBlock second = {nullptr, 0};
+	RunRawThread(&second);
+	EXPECT_EQ(first.block_, second.block_);
+	EXPECT_EQ(0, second.heap_allocations_);
+	TaskAllocator::Free(second.block_);
+}
@@ -0,0 +1,101 @@
+/*
+ * An intrusive lock-free multi-producer/single-consumer queue. Any thread can push a node with a
+ * single compare-and-swap on the head; the only consumer takes the whole list away with one atomic
+ * exchange and gets it back in FIFO order.
+ * Usage:
+ * class Foo : public base::MpscQueue<Foo>::Node {
+ * };
+ * base::MpscQueue<Foo> queue;
+ * queue.Push(new Foo());                          // on any thread.
+ * for (Foo *foo = queue.PopAll(); foo != nullptr; ) {     // on the consumer thread only.
+ *		Foo *next = foo->next();
+ *		delete foo;
+ *		foo = next;
+ * }
+ * The queue never owns its nodes, the nodes which are still in the queue when it is destructed
+ * must be taken away by PopAll.
+ */
+
+#ifndef BASE_SYNCHRONIZATION_MPSC_QUEUE_H__
+#define BASE_SYNCHRONIZATION_MPSC_QUEUE_H__
+
+#include <assert.h>
+#include <Windows.h>
+#include "base/util/noncopyable.h"
+
+namespace base {
+	template<typename T>
+	class MpscQueue : public noncopyable {
+	public:
+		class Node {
+		public:
+			Node() : next_(nullptr) {
+			}
+
+			T* next() const {
+				return static_cast<T*>(next_);
+			}
+
+			// The link can be reused by the single-threaded lists of the consumer once the node has been
+			// taken away from the queue.
+			void set_next(T *next) {
+				next_ = next;
+			}
+
+		private:
+			friend class MpscQueue<T>;
+			Node *next_;
+		};
+
+		MpscQueue() : head_(nullptr) {
+		}
+
+		~MpscQueue() {
+			assert(empty());
+		}
+
+		// Push a node into the queue. Return true if the queue was empty before, so the caller
+		// knows that the consumer may be sleeping and need to be woken up.
+		bool Push(T *node) {
+			return PushList(node, node);
+		}
+
+		// Push a list of nodes linked from the newest one to the oldest one by next() at once, so the
+		// consumer never sees a part of it. Return true if the queue was empty before.
+		bool PushList(T *newest, T *oldest) {
+			Node *head = head_;
+			for (; ;) {
+				oldest->next_ = head;
+				Node *previous = static_cast<Node*>(InterlockedCompareExchangePointer(
+					reinterpret_cast<PVOID volatile*>(&head_), static_cast<Node*>(newest), head));
+				if (previous == head) {
+					return previous == nullptr;
+				}
+				head = previous;
+			}
+		}
+
+		// Take all the nodes away from the queue, the oldest one first. Can only be called by the consumer.
+		T* PopAll() {
+			Node *list = static_cast<Node*>(InterlockedExchangePointer(reinterpret_cast<PVOID volatile*>(&head_), nullptr));
+			Node *reversed = nullptr;
+			while (list != nullptr) {
+				Node *next = list->next_;
+				list->next_ = reversed;
+				reversed = list;
+				list = next;
+			}
+			return static_cast<T*>(reversed);
+		}
+
+		bool empty() const {
+			return head_ == nullptr;
+		}
+
+	private:
+		// The newest node, linked to the older ones by next_.
+		Node* volatile head_;
+	};
+}
+
+#endif// BASE_SYNCHRONIZATION_MPSC_QUEUE_H__
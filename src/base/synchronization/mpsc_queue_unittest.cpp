@@ -0,0 +1,105 @@
+#include "base/synchronization/mpsc_queue.h"
+#include "base/thread/thread.h"
+#include "base/test/test_with_exit_manager.h"
+
+using base::MpscQueue;
+
+namespace {
+	struct Item : public MpscQueue<Item>::Node {
+		Item(int producer, int value) : producer_(producer), value_(value) {
+		}
+
+		int producer_;
+		int value_;
+	};
+
+	class Producer {
+	public:
+		Producer(MpscQueue<Item> *queue, int id, int count) : queue_(queue), id_(id), count_(count) {
+		}
+
+		void Produce() {
+			for (int i = 0; i < count_; ++i) {
+				queue_->Push(new Item(id_, i));
+			}
+		}
+
+	private:
+		MpscQueue<Item> *queue_;
+		int id_;
+		int count_;
+	};
+}
+
+TEST_WITH_EM(MpscQueue, Basic) {
+	MpscQueue<Item> queue;
+	EXPECT_TRUE(queue.empty());
+	EXPECT_TRUE(queue.PopAll() == nullptr);
+	EXPECT_TRUE(queue.Push(new Item(0, 0)));
+	EXPECT_FALSE(queue.Push(new Item(0, 1)));
+	EXPECT_FALSE(queue.Push(new Item(0, 2)));
+	EXPECT_FALSE(queue.empty());
+	Item *item = queue.PopAll();
+	EXPECT_TRUE(queue.empty());
+	for (int i = 0; i < 3; ++i) {
+		ASSERT_TRUE(item != nullptr);
+		EXPECT_EQ(i, item->value_);
+		Item *next = item->next();
+		delete item;
+		item = next;
+	}
+	EXPECT_TRUE(item == nullptr);
+	EXPECT_TRUE(queue.Push(new Item(0, 3)));
+	delete queue.PopAll();
+}
+
+TEST_WITH_EM(MpscQueue, PushList) {
+	MpscQueue<Item> queue;
+	EXPECT_TRUE(queue.Push(new Item(0, 0)));
+	// a list of 1, 2, 3 linked from the newest one.
+	Item *oldest = new Item(0, 1);
+	Item *middle = new Item(0, 2);
+	Item *newest = new Item(0, 3);
+	newest->set_next(middle);
+	middle->set_next(oldest);
+	EXPECT_FALSE(queue.PushList(newest, oldest));
+	Item *item = queue.PopAll();
+	for (int i = 0; i < 4; ++i) {
+		ASSERT_TRUE(item != nullptr);
+		EXPECT_EQ(i, item->value_);
+		Item *next = item->next();
+		delete item;
+		item = next;
+	}
+	EXPECT_TRUE(item == nullptr);
+}
+
+TEST_WITH_EM(MpscQueue, MultiProducer) {
+	const int kProducers = 4;
+	const int kCount = 10000;
+	MpscQueue<Item> queue;
+	std::shared_ptr<Producer> producers[kProducers];
+	base::Thread threads[kProducers];
+	for (int i = 0; i < kProducers; ++i) {
+		producers[i].reset(new Producer(&queue, i, kCount));
+		threads[i].Start();
+		threads[i].message_loop()->PostTask(base::MakeRunnableMethod(producers[i].get(), &Producer::Produce));
+	}
+	int expected[kProducers] = {0};
+	int received = 0;
+	while (received < kProducers * kCount) {
+		Item *item = queue.PopAll();
+		while (item != nullptr) {
+			// the items from the same producer must keep their order.
+			EXPECT_EQ(expected[item->producer_]++, item->value_);
+			++received;
+			Item *next = item->next();
+			delete item;
+			item = next;
+		}
+	}
+	EXPECT_TRUE(queue.empty());
+	for (int i = 0; i < kProducers; ++i) {
+		threads[i].Stop();
+	}
+}
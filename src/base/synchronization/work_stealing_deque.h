@@ -0,0 +1,153 @@
+/*
+ * A lock-free work-stealing deque of pointers. The owner thread pushes and pops at the bottom like a
+ * stack, any other thread can steal from the top. The owner pays no atomic operation unless the deque
+ * is about to become empty, a thief pays one compare-and-swap.
+ * Usage:
+ * base::WorkStealingDeque<Foo> deque;
+ * deque.Push(foo);                      // on the owner thread only.
+ * Foo *foo = deque.Pop();               // on the owner thread only, nullptr if empty.
+ * Foo *foo = nullptr;
+ * deque.Steal(&foo);                     // on any thread.
+ * The deque never owns the objects it holds.
+ * ref: Chase & Lev, "Dynamic Circular Work-Stealing Deque", and Le et al., "Correct and Efficient
+ * Work-Stealing for Weak Memory Models".
+ */
+
+#ifndef BASE_SYNCHRONIZATION_WORK_STEALING_DEQUE_H__
+#define BASE_SYNCHRONIZATION_WORK_STEALING_DEQUE_H__
+
+#include <assert.h>
+#include <vector>
+#include <Windows.h>
+#include "base/util/noncopyable.h"
+
+namespace base {
+	template<typename T>
+	class WorkStealingDeque : public noncopyable {
+	public:
+		enum StealResult {
+			kStealEmpty,
+			// Another thief or the owner won the race for the top, the deque may not be empty.
+			kStealAborted,
+			kStealSuccess
+		};
+
+		explicit WorkStealingDeque(LONG capacity = 256) : top_(0), bottom_(0) {
+			assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+			array_ = new Array(capacity);
+		}
+
+		~WorkStealingDeque() {
+			for (size_t i = 0; i < retired_arrays_.size(); ++i) {
+				delete retired_arrays_[i];
+			}
+			delete array_;
+		}
+
+		void Push(T *item) {
+			LONG bottom = bottom_;
+			LONG top = top_;
+			Array *array = array_;
+			if (Distance(top, bottom) >= array->capacity_) {
+				array = Grow(array, top, bottom);
+			}
+			array->Put(bottom, item);
+			// the item must be visible before the thieves see the new bottom.
+			_ReadWriteBarrier();
+			bottom_ = bottom + 1;
+		}
+
+		T* Pop() {
+			LONG bottom = bottom_ - 1;
+			Array *array = array_;
+			InterlockedExchange(&bottom_, bottom);
+			LONG top = top_;
+			if (Distance(top, bottom) < 0) {
+				bottom_ = bottom + 1;
+				return nullptr;
+			}
+			T *item = array->Get(bottom);
+			if (top == bottom) {
+				// the last one, race the thieves for it.
+				if (InterlockedCompareExchange(&top_, top + 1, top) != top) {
+					item = nullptr;
+				}
+				bottom_ = bottom + 1;
+			}
+			return item;
+		}
+
+		StealResult Steal(T **item) {
+			LONG top = top_;
+			MemoryBarrier();
+			LONG bottom = bottom_;
+			if (Distance(top, bottom) <= 0) {
+				return kStealEmpty;
+			}
+			Array *array = array_;
+			T *stolen = array->Get(top);
+			if (InterlockedCompareExchange(&top_, top + 1, top) != top) {
+				return kStealAborted;
+			}
+			*item = stolen;
+			return kStealSuccess;
+		}
+
+		// Only a hint when it is called by the other threads.
+		bool empty() const {
+			return size() == 0;
+		}
+
+		LONG size() const {
+			LONG top = top_;
+			LONG size = Distance(top, bottom_);
+			return size > 0 ? size : 0;
+		}
+
+	private:
+		struct Array {
+			explicit Array(LONG capacity) : capacity_(capacity), items_(new T*[capacity]) {
+			}
+
+			~Array() {
+				delete[] items_;
+			}
+
+			T* Get(LONG index) const {
+				return items_[index & (capacity_ - 1)];
+			}
+
+			void Put(LONG index, T *item) {
+				items_[index & (capacity_ - 1)] = item;
+			}
+
+			LONG capacity_;
+			T* volatile *items_;
+		};
+
+		// The indices wrap around, so they are compared by the distance between them.
+		static LONG Distance(LONG from, LONG to) {
+			return static_cast<LONG>(static_cast<ULONG>(to) - static_cast<ULONG>(from));
+		}
+
+		Array* Grow(Array *array, LONG top, LONG bottom) {
+			Array *bigger = new Array(array->capacity_ * 2);
+			for (LONG i = 0; i < Distance(top, bottom); ++i) {
+				bigger->Put(top + i, array->Get(top + i));
+			}
+			// a thief may still read the old array, so it lives as long as the deque.
+			retired_arrays_.push_back(array);
+			_ReadWriteBarrier();
+			array_ = bigger;
+			return bigger;
+		}
+
+		// 32 bits, a 64-bit load or store is two on a 32-bit build and a thief could see half of one.
+		volatile LONG top_;
+		volatile LONG bottom_;
+		Array* volatile array_;
+		std::vector<Array*> retired_arrays_;
+	};
+}
+
+#endif// BASE_SYNCHRONIZATION_WORK_STEALING_DEQUE_H__
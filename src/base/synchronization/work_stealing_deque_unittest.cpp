@@ -0,0 +1,122 @@
+#include <vector>
+#include "base/synchronization/work_stealing_deque.h"
+#include "base/thread/thread.h"
+#include "base/test/test_with_exit_manager.h"
+
+using base::WorkStealingDeque;
+
+namespace {
+	struct Item {
+		explicit Item(int value) : value_(value), taken_(0) {
+		}
+
+		int value_;
+		volatile LONG taken_;
+	};
+
+	typedef WorkStealingDeque<Item> ItemDeque;
+
+	class Thief {
+	public:
+		Thief(ItemDeque *deque, volatile bool *done) : deque_(deque), done_(done), count_(0) {
+		}
+
+		void Steal() {
+			for (;;) {
+				Item *item = nullptr;
+				ItemDeque::StealResult result = deque_->Steal(&item);
+				if (result == ItemDeque::kStealSuccess) {
+					InterlockedIncrement(&item->taken_);
+					++count_;
+				}else if (result == ItemDeque::kStealEmpty && *done_) {
+					break;
+				}
+			}
+		}
+
+		int count() const {
+			return count_;
+		}
+
+	private:
+		ItemDeque *deque_;
+		volatile bool *done_;
+		int count_;
+	};
+}
+
+TEST_WITH_EM(WorkStealingDeque, PopNewestStealOldest) {
+	ItemDeque deque(4);
+	std::vector<Item> items;
+	for (int i = 0; i < 10; ++i) {
+		items.push_back(Item(i));
+	}
+	EXPECT_TRUE(deque.empty());
+	EXPECT_TRUE(deque.Pop() == nullptr);
+	// grows past its capacity of 4.
+	for (int i = 0; i < 10; ++i) {
+		deque.Push(&items[i]);
+	}
+	EXPECT_EQ(10, deque.size());
+	Item *item = nullptr;
+	EXPECT_EQ(ItemDeque::kStealSuccess, deque.Steal(&item));
+	EXPECT_EQ(0, item->value_);
+	EXPECT_EQ(9, deque.Pop()->value_);
+	EXPECT_EQ(8, deque.Pop()->value_);
+	EXPECT_EQ(ItemDeque::kStealSuccess, deque.Steal(&item));
+	EXPECT_EQ(1, item->value_);
+	for (int i = 7; i >= 2; --i) {
+		EXPECT_EQ(i, deque.Pop()->value_);
+	}
+	EXPECT_TRUE(deque.empty());
+	EXPECT_TRUE(deque.Pop() == nullptr);
+	EXPECT_EQ(ItemDeque::kStealEmpty, deque.Steal(&item));
+}
+
+// Every item is taken exactly once, by the owner or by one of the thieves.
+TEST_WITH_EM(WorkStealingDeque, ConcurrentSteal) {
+	const int kThieves = 3;
+	const int kCount = 100000;
+	ItemDeque deque(16);
+	std::vector<Item> items;
+	items.reserve(kCount);
+	for (int i = 0; i < kCount; ++i) {
+		items.push_back(Item(i));
+	}
+	volatile bool done = false;
+	std::vector<std::shared_ptr<Thief>> thieves;
+	std::vector<std::shared_ptr<base::Thread>> threads;
+	for (int i = 0; i < kThieves; ++i) {
+		thieves.push_back(std::shared_ptr<Thief>(new Thief(&deque, &done)));
+		threads.push_back(std::shared_ptr<base::Thread>(new base::Thread()));
+		threads[i]->Start();
+		threads[i]->message_loop()->PostTask(base::MakeRunnableMethod(thieves[i].get(), &Thief::Steal));
+	}
+	int popped = 0;
+	for (int i = 0; i < kCount; ++i) {
+		deque.Push(&items[i]);
+		// take back one of every three pushed.
+		if (i % 3 == 0) {
+			Item *item = deque.Pop();
+			if (item != nullptr) {
+				InterlockedIncrement(&item->taken_);
+				++popped;
+			}
+		}
+	}
+	Item *item;
+	while ((item = deque.Pop()) != nullptr) {
+		InterlockedIncrement(&item->taken_);
+		++popped;
+	}
+	done = true;
+	int stolen = 0;
+	for (int i = 0; i < kThieves; ++i) {
+		threads[i]->Stop();
+		stolen += thieves[i]->count();
+	}
+	EXPECT_EQ(kCount, popped + stolen);
+	for (int i = 0; i < kCount; ++i) {
+		EXPECT_EQ(1, items[i].taken_);
+	}
+}
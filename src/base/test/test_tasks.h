@@ -0,0 +1,90 @@
+/*
+ * Tasks and helpers shared by the unittests, so each test file does not carry its own copy.
+ *
+ * For example,
+ * base::test::Recorder recorder(3);    // Wait returns once 3 ids are recorded.
+ * for (int i = 0; i < 3; ++i) {
+ *     loop->PostTask(base::MakeRunnableMethod(&recorder, &base::test::Recorder::Record, i));
+ * }
+ * recorder.Wait();
+ * EXPECT_EQ(0, recorder.ids()[0]);
+ */
+#ifndef BASE_TEST_TEST_TASKS_H__
+#define BASE_TEST_TEST_TASKS_H__
+
+#include <memory>
+#include <vector>
+#include "base/synchronization/lock.h"
+#include "base/synchronization/waitable_event.h"
+
+namespace base {
+	namespace test {
+		// Records ids in the order they run, from any thread. Wait returns after Done, or once total ids
+		// are recorded when total is positive.
+		class Recorder {
+		public:
+			explicit Recorder(int total = 0) : total_(total), done_(false, false) {
+			}
+
+			void Record(int id) {
+				bool done = false;
+				{
+					AutoLock lock(lock_);
+					ids_.push_back(id);
+					done = static_cast<int>(ids_.size()) == total_;
+				}
+				if (done) {
+					done_.Signal();
+				}
+			}
+
+			void Done() {
+				done_.Signal();
+			}
+
+			void Wait() {
+				done_.Wait();
+			}
+
+			std::vector<int> ids() const {
+				AutoLock lock(lock_);
+				return ids_;
+			}
+
+		private:
+			int total_;
+			WaitableEvent done_;
+			mutable LockImpl lock_;
+			std::vector<int> ids_;
+		};
+
+		// Sets the flag when it is deleted, to tell whether the task bound with it was released.
+		class DeleteTracker {
+		public:
+			explicit DeleteTracker(bool *deleted) : deleted_(deleted) {
+			}
+
+			~DeleteTracker() {
+				*deleted_ = true;
+			}
+
+		private:
+			bool *deleted_;
+		};
+
+		inline void Hold(std::shared_ptr<DeleteTracker> tracker, bool *ran) {
+			*ran = true;
+		}
+
+		// Keeps the thread busy until release is signaled.
+		inline void Block(WaitableEvent *entered, WaitableEvent *release) {
+			entered->Signal();
+			release->Wait();
+		}
+
+		inline void DoNothing() {
+		}
+	}
+}
+
+#endif // #ifndef BASE_TEST_TEST_TASKS_H__
@@ -0,0 +1,139 @@
+#include "base/thread/parallel.h"
+#include "base/synchronization/waitable_event.h"
+
+namespace base {
+	namespace internal {
+		namespace {
+			// The smallest automatic chunk is 1/kAutoGrainDivisor of the range for each participant.
+			const int64_t kAutoGrainDivisor = 256;
+			// A chunk is 1/kChunkDivisor of the range left for each participant.
+			const int64_t kChunkDivisor = 8;
+
+			// Shared by the caller and the helpers, the helpers which start after the range is done only
+			// touch the state, never the body.
+			class ParallelState {
+			public:
+				ParallelState(ThreadPool *pool, int64_t begin, int64_t end, int64_t grain, RangeBody *body)
+					: pool_(pool), body_(body), end_(end), grain_(grain), next_(begin), done_count_(0),
+					total_count_(end - begin), helper_count_(0), done_(true, false) {
+					participant_count_ = pool->worker_count() + 1;
+					if (grain_ <= 0) {
+						grain_ = total_count_ / (kAutoGrainDivisor * participant_count_);
+					}
+					if (grain_ < 1) {
+						grain_ = 1;
+					}
+				}
+
+				ThreadPool* pool() const {
+					return pool_;
+				}
+
+				int64_t total_count() const {
+					return total_count_;
+				}
+
+				// Return true if there is still work for two chunks and a helper may be added.
+				bool NeedsHelper() {
+					if (end_ - next_ < 2 * grain_) {
+						return false;
+					}
+					LONG helpers = helper_count_;
+					while (helpers < participant_count_ - 1) {
+						if (InterlockedCompareExchange(&helper_count_, helpers + 1, helpers) == helpers) {
+							return true;
+						}
+						helpers = helper_count_;
+					}
+					return false;
+				}
+
+				// Take chunks until the range runs out.
+				void Participate() {
+					int64_t begin = 0;
+					int64_t end = 0;
+					while (TakeChunk(&begin, &end)) {
+						body_->Run(begin, end);
+						int64_t count = end - begin;
+						if (InterlockedExchangeAdd64(&done_count_, count) + count == total_count_) {
+							done_.Signal();
+						}
+					}
+				}
+
+				void Wait() {
+					done_.Wait();
+				}
+
+			private:
+				bool TakeChunk(int64_t *begin, int64_t *end) {
+					int64_t next = next_;
+					for (; ;) {
+						int64_t left = end_ - next;
+						if (left <= 0) {
+							return false;
+						}
+						int64_t size = left / (kChunkDivisor * participant_count_);
+						if (size < grain_) {
+							size = grain_;
+						}
+						if (size > left) {
+							size = left;
+						}
+						int64_t previous = InterlockedCompareExchange64(&next_, next + size, next);
+						if (previous == next) {
+							*begin = next;
+							*end = next + size;
+							return true;
+						}
+						next = previous;
+					}
+				}
+
+				ThreadPool *pool_;
+				RangeBody *body_;
+				int64_t end_;
+				int64_t grain_;
+				int64_t participant_count_;
+				volatile LONGLONG next_;
+				volatile LONGLONG done_count_;
+				int64_t total_count_;
+				volatile LONG helper_count_;
+				WaitableEvent done_;
+			};
+
+			// Runs on a worker, and brings in one more while there is enough work left.
+			class Helper : public Task {
+			public:
+				explicit Helper(std::shared_ptr<ParallelState> state) : state_(state) {
+				}
+
+				static void PostIfNeeded(std::shared_ptr<ParallelState> state) {
+					if (state->NeedsHelper()) {
+						state->pool()->PostTask(std::unique_ptr<Task>(new Helper(state)));
+					}
+				}
+
+				virtual void Run() {
+					PostIfNeeded(state_);
+					state_->Participate();
+				}
+
+			private:
+				std::shared_ptr<ParallelState> state_;
+			};
+		}
+
+		void RunParallel(ThreadPool *pool, int64_t begin, int64_t end, int64_t grain, RangeBody *body) {
+			assert(pool != nullptr && body != nullptr);
+			if (end <= begin) {
+				return;
+			}
+			std::shared_ptr<ParallelState> state(new ParallelState(pool, begin, end, grain, body));
+			Helper::PostIfNeeded(state);
+			state->Participate();
+			// the chunks taken by the helpers may still be running.
+			state->Wait();
+		}
+	}
+}
@@ -0,0 +1,160 @@
+/*
+ * Data parallel loops on the workers of a ThreadPool. The calling thread works on the range too, the
+ * workers join it as they become free, and the call returns when the whole range is done.
+ *
+ * For example,
+ * base::ThreadPool pool;
+ * pool.Start();
+ * base::ParallelFor(&pool, 0, size, 0, [&](int64_t i) {
+ *     output[i] = input[i] * 2;
+ * });
+ * int64_t sum = base::ParallelReduce(&pool, 0, size, 0, int64_t(0), [&](int64_t i) {
+ *     return input[i];
+ * }, [](int64_t a, int64_t b) {
+ *     return a + b;
+ * });
+ * base::ParallelInvoke(&pool, [&]() { SortLeft(); }, [&]() { SortRight(); });
+ *
+ * The range is handed out in chunks which shrink as it runs out, from about an eighth of the range left
+ * divided by the participants down to the grain, so the first chunks are cheap to take and the last ones
+ * balance the load. A grain of 0 picks one so that the smallest chunk is about 1/256 of the range for
+ * each participant. A participant which starts while there is still work for two posts one more
+ * participant to the pool, so a busy pool is not flooded with tasks which only find the range done.
+ */
+
+#ifndef BASE_THREAD_PARALLEL_H__
+#define BASE_THREAD_PARALLEL_H__
+
+#include "base/base_types.h"
+#include "base/synchronization/lock.h"
+#include "base/thread/thread_pool.h"
+
+namespace base {
+	namespace internal {
+		class RangeBody {
+		public:
+			virtual ~RangeBody() {
+			}
+
+			// Run the indices in [begin, end), it is called on several threads at once.
+			virtual void Run(int64_t begin, int64_t end) = 0;
+		};
+
+		// Run the body over [begin, end) on the calling thread and on the workers of the pool.
+		void RunParallel(ThreadPool *pool, int64_t begin, int64_t end, int64_t grain, RangeBody *body);
+
+		template<typename Func>
+		class ForBody : public RangeBody {
+		public:
+			explicit ForBody(Func &func) : func_(func) {
+			}
+
+			virtual void Run(int64_t begin, int64_t end) {
+				for (int64_t i = begin; i < end; ++i) {
+					func_(i);
+				}
+			}
+
+		private:
+			Func &func_;
+		};
+
+		// Each chunk is reduced on its own, then merged into the result under the lock.
+		template<typename T, typename Func, typename Reduce>
+		class ReduceBody : public RangeBody {
+		public:
+			ReduceBody(const T &identity, Func &func, Reduce &reduce)
+				: identity_(identity), result_(identity), func_(func), reduce_(reduce) {
+			}
+
+			virtual void Run(int64_t begin, int64_t end) {
+				T partial = identity_;
+				for (int64_t i = begin; i < end; ++i) {
+					partial = reduce_(partial, func_(i));
+				}
+				AutoLock lock(lock_);
+				result_ = reduce_(result_, partial);
+			}
+
+			const T& result() const {
+				return result_;
+			}
+
+		private:
+			const T &identity_;
+			T result_;
+			Func &func_;
+			Reduce &reduce_;
+			LockImpl lock_;
+		};
+
+		template<typename F1, typename F2, typename F3, typename F4>
+		class InvokeBody : public RangeBody {
+		public:
+			InvokeBody(F1 &f1, F2 &f2, F3 *f3, F4 *f4) : f1_(f1), f2_(f2), f3_(f3), f4_(f4) {
+			}
+
+			virtual void Run(int64_t begin, int64_t end) {
+				for (int64_t i = begin; i < end; ++i) {
+					if (i == 0) {
+						f1_();
+					}else if (i == 1) {
+						f2_();
+					}else if (i == 2) {
+						(*f3_)();
+					}else {
+						(*f4_)();
+					}
+				}
+			}
+
+		private:
+			F1 &f1_;
+			F2 &f2_;
+			F3 *f3_;
+			F4 *f4_;
+		};
+
+		struct NoFunction {
+			void operator()() {
+			}
+		};
+	}
+
+	// Call func(i) for each i in [begin, end). func is called on several threads at once.
+	template<typename Func>
+	void ParallelFor(ThreadPool *pool, int64_t begin, int64_t end, int64_t grain, Func func) {
+		internal::ForBody<Func> body(func);
+		internal::RunParallel(pool, begin, end, grain, &body);
+	}
+
+	// Combine func(i) for each i in [begin, end) with reduce, in no particular order, so reduce must be
+	// associative and commutative and identity must not change what it is combined with.
+	template<typename T, typename Func, typename Reduce>
+	T ParallelReduce(ThreadPool *pool, int64_t begin, int64_t end, int64_t grain, const T &identity, Func func, Reduce reduce) {
+		internal::ReduceBody<T, Func, Reduce> body(identity, func, reduce);
+		internal::RunParallel(pool, begin, end, grain, &body);
+		return body.result();
+	}
+
+	// Run the functions at once, and return when all of them have.
+	template<typename F1, typename F2>
+	void ParallelInvoke(ThreadPool *pool, F1 f1, F2 f2) {
+		internal::InvokeBody<F1, F2, internal::NoFunction, internal::NoFunction> body(f1, f2, nullptr, nullptr);
+		internal::RunParallel(pool, 0, 2, 1, &body);
+	}
+
+	template<typename F1, typename F2, typename F3>
+	void ParallelInvoke(ThreadPool *pool, F1 f1, F2 f2, F3 f3) {
+		internal::InvokeBody<F1, F2, F3, internal::NoFunction> body(f1, f2, &f3, nullptr);
+		internal::RunParallel(pool, 0, 3, 1, &body);
+	}
+
+	template<typename F1, typename F2, typename F3, typename F4>
+	void ParallelInvoke(ThreadPool *pool, F1 f1, F2 f2, F3 f3, F4 f4) {
+		internal::InvokeBody<F1, F2, F3, F4> body(f1, f2, &f3, &f4);
+		internal::RunParallel(pool, 0, 4, 1, &body);
+	}
+}
+
+#endif// BASE_THREAD_PARALLEL_H__
@@ -0,0 +1,70 @@
+#include <math.h>
+#include <sstream>
+#include <vector>
+#include "base/test/perf_reporter.h"
+#include "base/test/test_with_exit_manager.h"
+#include "base/thread/parallel.h"
+
+using base::ThreadPool;
+
+namespace {
+	const int kMaxWorkers = 64;
+
+	std::string MakeName(const char *kernel, int worker_count) {
+		std::stringstream name;
+		name << kernel << " on " << worker_count << " workers and the caller";
+		return name.str();
+	}
+}
+
+// Adds two arrays of 4M floats, bound by the memory bandwidth.
+TEST_WITH_EM(ParallelPerfTest, MemoryBound) {
+	const int64_t kSize = 1 << 22;
+	const int kRounds = 10;
+	std::vector<float> a(kSize, 1.0f);
+	std::vector<float> b(kSize, 2.0f);
+	std::vector<float> c(kSize, 0.0f);
+	for (int worker_count = 1; worker_count <= kMaxWorkers; worker_count *= 2) {
+		ThreadPool pool(worker_count);
+		pool.Start();
+		std::string watch_name = MakeName("a[i] + b[i]", worker_count);
+		base::PerfReporter reporter(kSize * kRounds);
+		base::StopWatch watch(base::StringPiece(watch_name), &reporter);
+		watch.Start();
+		for (int round = 0; round < kRounds; ++round) {
+			base::ParallelFor(&pool, 0, kSize, 0, [&a, &b, &c](int64_t i) {
+				c[static_cast<size_t>(i)] = a[static_cast<size_t>(i)] + b[static_cast<size_t>(i)];
+			});
+		}
+		watch.Stop();
+		watch.Report();
+		pool.Stop();
+		EXPECT_EQ(3.0f, c[kSize - 1]);
+	}
+}
+
+// A few hundred floating point operations for each index, bound by the cores.
+TEST_WITH_EM(ParallelPerfTest, ComputeBound) {
+	const int64_t kSize = 1 << 16;
+	for (int worker_count = 1; worker_count <= kMaxWorkers; worker_count *= 2) {
+		ThreadPool pool(worker_count);
+		pool.Start();
+		std::string watch_name = MakeName("sum of sqrt series", worker_count);
+		base::PerfReporter reporter(kSize);
+		base::StopWatch watch(base::StringPiece(watch_name), &reporter);
+		watch.Start();
+		double sum = base::ParallelReduce(&pool, 0, kSize, 0, 0.0, [](int64_t i) {
+			double value = static_cast<double>(i);
+			for (int j = 0; j < 100; ++j) {
+				value = sqrt(value + j);
+			}
+			return value;
+		}, [](double x, double y) {
+			return x + y;
+		});
+		watch.Stop();
+		watch.Report();
+		pool.Stop();
+		EXPECT_LT(0.0, sum);
+	}
+}
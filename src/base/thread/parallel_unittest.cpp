@@ -0,0 +1,111 @@
+#include <vector>
+#include "base/synchronization/waitable_event.h"
+#include "base/test/test_tasks.h"
+#include "base/test/test_with_exit_manager.h"
+#include "base/thread/parallel.h"
+
+using base::ThreadPool;
+using base::WaitableEvent;
+using base::test::Block;
+
+TEST_WITH_EM(Parallel, ForCoversRange) {
+	const int64_t kSize = 100000;
+	const int64_t kGrains[] = {0, 1, 1000, kSize * 2};
+	ThreadPool pool(4);
+	pool.Start();
+	for (size_t g = 0; g < sizeof(kGrains) / sizeof(kGrains[0]); ++g) {
+		std::vector<LONG> hits(kSize + 10, 0);
+		base::ParallelFor(&pool, 10, kSize + 10, kGrains[g], [&hits](int64_t i) {
+			InterlockedIncrement(&hits[static_cast<size_t>(i)]);
+		});
+		int wrong = 0;
+		for (int64_t i = 0; i < kSize + 10; ++i) {
+			if (hits[static_cast<size_t>(i)] != (i < 10 ? 0 : 1)) {
+				++wrong;
+			}
+		}
+		EXPECT_EQ(0, wrong);
+	}
+	// nothing to do.
+	base::ParallelFor(&pool, 5, 5, 0, [](int64_t i) {
+		ADD_FAILURE();
+	});
+	pool.Stop();
+}
+
+TEST_WITH_EM(Parallel, Reduce) {
+	const int64_t kSize = 1 << 20;
+	ThreadPool pool(4);
+	pool.Start();
+	int64_t sum = base::ParallelReduce(&pool, 0, kSize, 0, int64_t(0), [](int64_t i) {
+		return i;
+	}, [](int64_t a, int64_t b) {
+		return a + b;
+	});
+	EXPECT_EQ(kSize * (kSize - 1) / 2, sum);
+	int64_t max = base::ParallelReduce(&pool, 0, kSize, 64, int64_t(-1), [kSize](int64_t i) {
+		return (i * 7919) % kSize;
+	}, [](int64_t a, int64_t b) {
+		return a > b ? a : b;
+	});
+	EXPECT_EQ(kSize - 1, max);
+	pool.Stop();
+}
+
+TEST_WITH_EM(Parallel, Invoke) {
+	ThreadPool pool(2);
+	pool.Start();
+	int a = 0;
+	int b = 0;
+	int c = 0;
+	int d = 0;
+	base::ParallelInvoke(&pool, [&a]() { a = 1; }, [&b]() { b = 2; });
+	EXPECT_EQ(1, a);
+	EXPECT_EQ(2, b);
+	base::ParallelInvoke(&pool, [&a]() { a = 3; }, [&b]() { b = 4; }, [&c]() { c = 5; }, [&d]() { d = 6; });
+	EXPECT_EQ(3, a);
+	EXPECT_EQ(4, b);
+	EXPECT_EQ(5, c);
+	EXPECT_EQ(6, d);
+	pool.Stop();
+}
+
+TEST_WITH_EM(Parallel, CallerRunsWhenWorkersAreBusy) {
+	ThreadPool pool(2);
+	pool.Start();
+	WaitableEvent entered(false, false);
+	WaitableEvent release(true, false);
+	for (int i = 0; i < 2; ++i) {
+		pool.PostTask(base::MakeRunnableFunction(&Block, &entered, &release));
+		entered.Wait();
+	}
+	// no worker is free, the caller does all the work.
+	DWORD caller = GetCurrentThreadId();
+	int64_t others = base::ParallelReduce(&pool, 0, 1000, 0, int64_t(0), [caller](int64_t i) {
+		return GetCurrentThreadId() == caller ? int64_t(0) : int64_t(1);
+	}, [](int64_t a, int64_t b) {
+		return a + b;
+	});
+	EXPECT_EQ(0, others);
+	release.Signal();
+	pool.Stop();
+}
+
+TEST_WITH_EM(Parallel, NestedOnWorkers) {
+	const int64_t kOuter = 16;
+	const int64_t kInner = 1000;
+	ThreadPool pool(4);
+	pool.Start();
+	std::vector<int64_t> sums(kOuter, 0);
+	base::ParallelFor(&pool, 0, kOuter, 1, [&pool, &sums](int64_t i) {
+		sums[static_cast<size_t>(i)] = base::ParallelReduce(&pool, 0, kInner, 0, int64_t(0), [i](int64_t j) {
+			return i;
+		}, [](int64_t a, int64_t b) {
+			return a + b;
+		});
+	});
+	for (int64_t i = 0; i < kOuter; ++i) {
+		EXPECT_EQ(i * kInner, sums[static_cast<size_t>(i)]);
+	}
+	pool.Stop();
+}
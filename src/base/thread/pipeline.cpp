@@ -0,0 +1,274 @@
+#include "base/thread/pipeline.h"
+#include "base/synchronization/lock.h"
+#include "base/thread/thread.h"
+
+namespace base {
+	namespace internal {
+		// A bounded ring of batches. The free slots and the ready batches are counted by two semaphores,
+		// so a full ring blocks the pushers and an empty one blocks the poppers without spinning.
+		class PipelineCore::Ring : public noncopyable {
+		public:
+			explicit Ring(size_t capacity) : slots_(capacity, nullptr), head_(0), count_(0), closed_(false) {
+				free_slots_ = CreateSemaphore(nullptr, static_cast<LONG>(capacity), static_cast<LONG>(capacity), nullptr);
+				ready_ = CreateSemaphore(nullptr, 0, 0x7FFFFFFF, nullptr);
+				assert(free_slots_ != nullptr && ready_ != nullptr);
+			}
+
+			~Ring() {
+				for (size_t i = 0; i < count_; ++i) {
+					delete slots_[(head_ + i) % slots_.size()];
+				}
+				CloseHandle(free_slots_);
+				CloseHandle(ready_);
+			}
+
+			size_t capacity() const {
+				return slots_.size();
+			}
+
+			// Wait for a free slot, |blocked_count| is increased before the wait.
+			void Push(PipelineBatch *batch, volatile LONGLONG *blocked_count) {
+				if (WaitForSingleObject(free_slots_, 0) != WAIT_OBJECT_0) {
+					InterlockedIncrement64(blocked_count);
+					WaitForSingleObject(free_slots_, INFINITE);
+				}
+				{
+					AutoLock lock(lock_);
+					assert(!closed_);
+					slots_[(head_ + count_) % slots_.size()] = batch;
+					++count_;
+				}
+				ReleaseSemaphore(ready_, 1, nullptr);
+			}
+
+			// Return nullptr once the ring is closed and empty. |waiting| is the number of batches which were
+			// in the ring, the one taken included.
+			PipelineBatch* Pop(size_t *waiting) {
+				WaitForSingleObject(ready_, INFINITE);
+				PipelineBatch *batch = nullptr;
+				{
+					AutoLock lock(lock_);
+					if (count_ == 0) {
+						assert(closed_);
+						// pass the close on to the next popper.
+						ReleaseSemaphore(ready_, 1, nullptr);
+						return nullptr;
+					}
+					*waiting = count_;
+					batch = slots_[head_];
+					head_ = (head_ + 1) % slots_.size();
+					--count_;
+				}
+				ReleaseSemaphore(free_slots_, 1, nullptr);
+				return batch;
+			}
+
+			// No more batches are pushed, the poppers get nullptr once the ring is empty.
+			void Close() {
+				{
+					AutoLock lock(lock_);
+					closed_ = true;
+				}
+				ReleaseSemaphore(ready_, 1, nullptr);
+			}
+
+		private:
+			std::vector<PipelineBatch*> slots_;
+			size_t head_;
+			size_t count_;
+			bool closed_;
+			LockImpl lock_;
+			HANDLE free_slots_;
+			HANDLE ready_;
+		};
+
+		class PipelineCore::Stage : public noncopyable {
+		public:
+			Stage(const std::string &name, int parallelism, PipelineProcessor *processor, size_t ring_capacity)
+				: name_(name), parallelism_(parallelism), processor_(processor), input_(new Ring(ring_capacity)),
+				output_(nullptr), running_count_(0), batches_(0), items_(0), busy_us_(0), blocked_count_(0),
+				occupancy_sum_(0) {
+				assert(parallelism_ > 0);
+			}
+
+			const std::string& name() const {
+				return name_;
+			}
+
+			Ring* input() const {
+				return input_.get();
+			}
+
+			void set_output(Ring *output) {
+				output_ = output;
+			}
+
+			bool Start();
+			// Stop the threads, which exit once the input ring is closed and empty.
+			void Stop();
+			void RunWorker();
+			PipelineStageStats stats() const;
+
+		private:
+			// The last worker to exit, or a start which fails after the others, closes the output ring.
+			void ReleaseWorker();
+
+			std::string name_;
+			int parallelism_;
+			std::unique_ptr<PipelineProcessor> processor_;
+			std::unique_ptr<Ring> input_;
+			Ring *output_;
+			std::vector<std::shared_ptr<Worker>> workers_;
+			// The workers which have started and not exited yet.
+			volatile LONG running_count_;
+			volatile LONGLONG batches_;
+			volatile LONGLONG items_;
+			volatile LONGLONG busy_us_;
+			volatile LONGLONG blocked_count_;
+			volatile LONGLONG occupancy_sum_;
+		};
+
+		// A stage thread runs the stage instead of its message loop, the loop only runs the quit task of
+		// Thread::Stop after the stage is done.
+		class PipelineCore::Worker : public Thread {
+		public:
+			explicit Worker(Stage *stage) : stage_(stage) {
+			}
+
+		protected:
+			virtual void Run(MessageLoop *message_loop) {
+				stage_->RunWorker();
+				message_loop->Run();
+			}
+
+		private:
+			Stage *stage_;
+		};
+
+		bool PipelineCore::Stage::Start() {
+			for (int i = 0; i < parallelism_; ++i) {
+				// counted before it starts, so the workers which exit first can not close the output early.
+				InterlockedIncrement(&running_count_);
+				std::shared_ptr<Worker> worker(new Worker(this));
+				if (!worker->Start()) {
+					ReleaseWorker();
+					return false;
+				}
+				workers_.push_back(worker);
+			}
+			return true;
+		}
+
+		void PipelineCore::Stage::Stop() {
+			for (size_t i = 0; i < workers_.size(); ++i) {
+				workers_[i]->Stop();
+			}
+			workers_.clear();
+		}
+
+		void PipelineCore::Stage::RunWorker() {
+			for (; ;) {
+				size_t waiting = 0;
+				PipelineBatch *batch = input_->Pop(&waiting);
+				if (batch == nullptr) {
+					break;
+				}
+				InterlockedExchangeAdd64(&occupancy_sum_, static_cast<LONGLONG>(waiting));
+				InterlockedIncrement64(&batches_);
+				InterlockedExchangeAdd64(&items_, static_cast<LONGLONG>(batch->size()));
+				TimeTicks start_time = TimeTicks::HightResolutionNow();
+				processor_->Process(batch);
+				InterlockedExchangeAdd64(&busy_us_, (TimeTicks::HightResolutionNow() - start_time).ToMicroseconds());
+				if (output_ == nullptr || batch->size() == 0) {
+					delete batch;
+				}else {
+					output_->Push(batch, &blocked_count_);
+				}
+			}
+			ReleaseWorker();
+		}
+
+		void PipelineCore::Stage::ReleaseWorker() {
+			if (InterlockedDecrement(&running_count_) == 0 && output_ != nullptr) {
+				output_->Close();
+			}
+		}
+
+		PipelineStageStats PipelineCore::Stage::stats() const {
+			PipelineStageStats stats;
+			stats.batches_ = batches_;
+			stats.items_ = items_;
+			stats.busy_us_ = busy_us_;
+			stats.blocked_count_ = blocked_count_;
+			stats.occupancy_sum_ = occupancy_sum_;
+			stats.occupancy_samples_ = batches_;
+			stats.ring_capacity_ = input_->capacity();
+			return stats;
+		}
+
+		PipelineCore::PipelineCore(size_t ring_capacity)
+			: ring_capacity_(ring_capacity), started_(false), finished_(false), source_blocked_count_(0) {
+			assert(ring_capacity_ > 0);
+		}
+
+		PipelineCore::~PipelineCore() {
+			Finish();
+		}
+
+		void PipelineCore::AddStage(const std::string &name, int parallelism, PipelineProcessor *processor) {
+			assert(!started_);
+			std::shared_ptr<Stage> stage(new Stage(name, parallelism, processor, ring_capacity_));
+			if (!stages_.empty()) {
+				stages_.back()->set_output(stage->input());
+			}
+			stages_.push_back(stage);
+		}
+
+		bool PipelineCore::Start() {
+			assert(!stages_.empty() && !finished_);
+			if (started_) {
+				return true;
+			}
+			started_ = true;
+			for (size_t i = 0; i < stages_.size(); ++i) {
+				if (!stages_[i]->Start()) {
+					Finish();
+					return false;
+				}
+			}
+			return true;
+		}
+
+		void PipelineCore::Push(PipelineBatch *batch) {
+			assert(started_);
+			stages_.front()->input()->Push(batch, &source_blocked_count_);
+		}
+
+		void PipelineCore::Finish() {
+			if (!started_) {
+				return;
+			}
+			// the close goes down the stages as each one drains.
+			stages_.front()->input()->Close();
+			for (size_t i = 0; i < stages_.size(); ++i) {
+				stages_[i]->Stop();
+			}
+			started_ = false;
+			finished_ = true;
+		}
+
+		size_t PipelineCore::stage_count() const {
+			return stages_.size();
+		}
+
+		const std::string& PipelineCore::stage_name(size_t index) const {
+			assert(index < stages_.size());
+			return stages_[index]->name();
+		}
+
+		PipelineStageStats PipelineCore::stage_stats(size_t index) const {
+			assert(index < stages_.size());
+			return stages_[index]->stats();
+		}
+	}
+}
@@ -0,0 +1,220 @@
+/*
+ * A chain of stages which pass batches of items down bounded ring buffers. Each stage runs on its own
+ * threads, as many as its parallelism, and the ring in front of it holds a fixed number of batches. A
+ * stage which finds the next ring full waits for a free slot, so the slowest stage holds back the ones
+ * before it, back to the source, instead of letting the queues grow.
+ *
+ * For example,
+ * base::Pipeline<Record> pipeline(256, 8);    // 256 records a batch, 8 batches between two stages.
+ * pipeline.AddStage("parse", 4, [](std::vector<Record> &batch) {
+ *     ....
+ * });
+ * pipeline.AddStage("store", 1, [&](std::vector<Record> &batch) {
+ *     database.Insert(batch);
+ * });
+ * pipeline.Start();
+ * while (reader.Read(&record)) {
+ *     pipeline.Push(std::move(record));    // waits while the first ring is full.
+ * }
+ * pipeline.Finish();                       // returns when the last batch has left the last stage.
+ *
+ * A stage may change the items of a batch in place and remove some of them. The batches of a stage with
+ * a parallelism above 1 may reach the next stage in a different order.
+ */
+
+#ifndef BASE_THREAD_PIPELINE_H__
+#define BASE_THREAD_PIPELINE_H__
+
+#include <assert.h>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <Windows.h>
+#include "base/base_types.h"
+#include "base/util/noncopyable.h"
+
+namespace base {
+	// Can be read on any thread while the pipeline runs.
+	struct PipelineStageStats {
+		PipelineStageStats() : batches_(0), items_(0), busy_us_(0), blocked_count_(0), occupancy_sum_(0),
+			occupancy_samples_(0), ring_capacity_(0) {
+		}
+
+		// The average number of batches waiting in the ring in front of the stage when it takes one.
+		double average_occupancy() const {
+			return occupancy_samples_ > 0 ? static_cast<double>(occupancy_sum_) / occupancy_samples_ : 0;
+		}
+
+		int64_t batches_;
+		int64_t items_;
+		// The time spent in the stage function by all its threads.
+		int64_t busy_us_;
+		// How many times the stage had to wait for a free slot in the next ring.
+		int64_t blocked_count_;
+		int64_t occupancy_sum_;
+		int64_t occupancy_samples_;
+		size_t ring_capacity_;
+	};
+
+	namespace internal {
+		class PipelineBatch {
+		public:
+			virtual ~PipelineBatch() {
+			}
+
+			virtual size_t size() const = 0;
+		};
+
+		class PipelineProcessor {
+		public:
+			virtual ~PipelineProcessor() {
+			}
+
+			virtual void Process(PipelineBatch *batch) = 0;
+		};
+
+		// Runs the stages and the rings, the items are only known to Pipeline.
+		class PipelineCore : public noncopyable {
+		public:
+			explicit PipelineCore(size_t ring_capacity);
+			~PipelineCore();
+			// Takes the ownership of the processor. Can only be called before Start.
+			void AddStage(const std::string &name, int parallelism, PipelineProcessor *processor);
+			// A pipeline can only be started once.
+			bool Start();
+			bool started() const {
+				return started_;
+			}
+
+			// Takes the ownership of the batch, waits while the first ring is full.
+			void Push(PipelineBatch *batch);
+			// Let the stages drain the rings, and stop their threads.
+			void Finish();
+			size_t stage_count() const;
+			const std::string& stage_name(size_t index) const;
+			PipelineStageStats stage_stats(size_t index) const;
+			// How many times the source had to wait for the first ring.
+			int64_t source_blocked_count() const {
+				return source_blocked_count_;
+			}
+
+		private:
+			class Ring;
+			class Stage;
+			class Worker;
+
+			size_t ring_capacity_;
+			std::vector<std::shared_ptr<Stage>> stages_;
+			bool started_;
+			bool finished_;
+			volatile LONGLONG source_blocked_count_;
+		};
+
+		template<typename T>
+		class TypedBatch : public PipelineBatch {
+		public:
+			virtual size_t size() const {
+				return items_.size();
+			}
+
+			std::vector<T> items_;
+		};
+
+		template<typename T, typename Func>
+		class StageProcessor : public PipelineProcessor {
+		public:
+			explicit StageProcessor(Func func) : func_(std::move(func)) {
+			}
+
+			virtual void Process(PipelineBatch *batch) {
+				func_(static_cast<TypedBatch<T>*>(batch)->items_);
+			}
+
+		private:
+			Func func_;
+		};
+	}
+
+	template<typename T>
+	class Pipeline : public noncopyable {
+	public:
+		Pipeline(size_t batch_size, size_t ring_capacity)
+			: batch_size_(batch_size), core_(ring_capacity) {
+			assert(batch_size_ > 0);
+		}
+
+		// Finish the pipeline if it is running.
+		~Pipeline() {
+			Finish();
+		}
+
+		// func(std::vector<T> &batch) is called on several threads at once if the parallelism is above 1.
+		// Can only be called before Start.
+		template<typename Func>
+		void AddStage(const std::string &name, int parallelism, Func func) {
+			core_.AddStage(name, parallelism, new internal::StageProcessor<T, Func>(std::move(func)));
+		}
+
+		bool Start() {
+			return core_.Start();
+		}
+
+		// The source, can only be called on one thread.
+		void Push(const T &item) {
+			Batch()->items_.push_back(item);
+			PushIfFull();
+		}
+
+		void Push(T &&item) {
+			Batch()->items_.push_back(std::move(item));
+			PushIfFull();
+		}
+
+		// Push the partial batch, and return when all the items have left the last stage.
+		void Finish() {
+			if (batch_ != nullptr && !batch_->items_.empty() && core_.started()) {
+				core_.Push(batch_.release());
+			}
+			batch_.reset();
+			core_.Finish();
+		}
+
+		size_t stage_count() const {
+			return core_.stage_count();
+		}
+
+		const std::string& stage_name(size_t index) const {
+			return core_.stage_name(index);
+		}
+
+		PipelineStageStats stage_stats(size_t index) const {
+			return core_.stage_stats(index);
+		}
+
+		int64_t source_blocked_count() const {
+			return core_.source_blocked_count();
+		}
+
+	private:
+		internal::TypedBatch<T>* Batch() {
+			if (batch_ == nullptr) {
+				batch_.reset(new internal::TypedBatch<T>());
+				batch_->items_.reserve(batch_size_);
+			}
+			return batch_.get();
+		}
+
+		void PushIfFull() {
+			if (batch_->items_.size() >= batch_size_) {
+				core_.Push(batch_.release());
+			}
+		}
+
+		size_t batch_size_;
+		std::unique_ptr<internal::TypedBatch<T>> batch_;
+		internal::PipelineCore core_;
+	};
+}
+
+#endif// BASE_THREAD_PIPELINE_H__
@@ -0,0 +1,144 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "base/framework/message_loop.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/test/perf_reporter.h"
+#include "base/test/test_with_exit_manager.h"
+#include "base/thread/pipeline.h"
+#include "base/thread/thread.h"
+
+using base::MessageLoop;
+using base::Pipeline;
+using base::Thread;
+using base::WaitableEvent;
+
+namespace {
+	const int kRecords = 1 << 20;
+
+	struct Record {
+		int64_t key_;
+		int64_t value_;
+	};
+
+	int64_t Mix(int64_t value) {
+		value ^= value >> 33;
+		value *= 0x62A9D9ED799705F5LL;
+		return value ^ (value >> 28);
+	}
+
+	// The same three steps with a task for each record, handed from one thread to the next.
+	class TaskChain {
+	public:
+		TaskChain(MessageLoop *parse, MessageLoop *transform, MessageLoop *sink, WaitableEvent *done)
+			: parse_(parse), transform_(transform), sink_(sink), done_(done), count_(0), sum_(0) {
+		}
+
+		void Parse(Record record) {
+			record.value_ = Mix(record.key_);
+			transform_->PostTask(base::MakeRunnableMethod(this, &TaskChain::Transform, record));
+		}
+
+		void Transform(Record record) {
+			record.value_ = Mix(record.value_);
+			sink_->PostTask(base::MakeRunnableMethod(this, &TaskChain::Sink, record));
+		}
+
+		void Sink(Record record) {
+			sum_ += record.value_;
+			if (++count_ == kRecords) {
+				done_->Signal();
+			}
+		}
+
+		int64_t sum() const {
+			return sum_;
+		}
+
+	private:
+		MessageLoop *parse_;
+		MessageLoop *transform_;
+		MessageLoop *sink_;
+		WaitableEvent *done_;
+		int count_;
+		int64_t sum_;
+	};
+
+	void ReportStages(const Pipeline<Record> &pipeline) {
+		for (size_t i = 0; i < pipeline.stage_count(); ++i) {
+			base::PipelineStageStats stats = pipeline.stage_stats(i);
+			std::cout << "  " << pipeline.stage_name(i) << ": " << stats.items_ << " items in " << stats.batches_
+				<< " batches, busy " << stats.busy_us_ / 1000 << "ms, ring occupancy " << stats.average_occupancy()
+				<< "/" << stats.ring_capacity_ << ", blocked " << stats.blocked_count_ << " times" << std::endl;
+		}
+		std::cout << "  source blocked " << pipeline.source_blocked_count() << " times" << std::endl;
+	}
+
+	void RunPipeline(size_t batch_size, int transform_parallelism) {
+		Pipeline<Record> pipeline(batch_size, 8);
+		pipeline.AddStage("parse", 1, [](std::vector<Record> &batch) {
+			for (size_t i = 0; i < batch.size(); ++i) {
+				batch[i].value_ = Mix(batch[i].key_);
+			}
+		});
+		pipeline.AddStage("transform", transform_parallelism, [](std::vector<Record> &batch) {
+			for (size_t i = 0; i < batch.size(); ++i) {
+				batch[i].value_ = Mix(batch[i].value_);
+			}
+		});
+		int64_t sum = 0;
+		pipeline.AddStage("sink", 1, [&sum](std::vector<Record> &batch) {
+			for (size_t i = 0; i < batch.size(); ++i) {
+				sum += batch[i].value_;
+			}
+		});
+		pipeline.Start();
+		std::stringstream name;
+		name << "pipeline with batches of " << batch_size << ", transform on " << transform_parallelism << " threads";
+		std::string watch_name = name.str();
+		base::PerfReporter reporter(kRecords);
+		base::StopWatch watch(base::StringPiece(watch_name), &reporter);
+		watch.Start();
+		for (int i = 0; i < kRecords; ++i) {
+			Record record = {i, 0};
+			pipeline.Push(record);
+		}
+		pipeline.Finish();
+		watch.Stop();
+		watch.Report();
+		ReportStages(pipeline);
+		EXPECT_EQ(kRecords, pipeline.stage_stats(2).items_);
+	}
+}
+
+// A task for each record from thread to thread, no batching and no flow control.
+TEST_WITH_EM(PipelinePerfTest, TaskPerRecord) {
+	Thread parse;
+	Thread transform;
+	Thread sink;
+	parse.Start();
+	transform.Start();
+	sink.Start();
+	WaitableEvent done(false, false);
+	TaskChain chain(parse.message_loop(), transform.message_loop(), sink.message_loop(), &done);
+	base::PerfReporter reporter(kRecords);
+	base::StopWatch watch(base::StringPiece("task per record"), &reporter);
+	watch.Start();
+	for (int i = 0; i < kRecords; ++i) {
+		Record record = {i, 0};
+		parse.message_loop()->PostTask(base::MakeRunnableMethod(&chain, &TaskChain::Parse, record));
+	}
+	done.Wait();
+	watch.Stop();
+	watch.Report();
+	sink.Stop();
+	transform.Stop();
+	parse.Stop();
+}
+
+TEST_WITH_EM(PipelinePerfTest, Batches) {
+	RunPipeline(1, 1);
+	RunPipeline(64, 1);
+	RunPipeline(256, 1);
+	RunPipeline(256, 4);
+}
@@ -0,0 +1,86 @@
+#include <algorithm>
+#include <vector>
+#include "base/synchronization/waitable_event.h"
+#include "base/test/test_with_exit_manager.h"
+#include "base/thread/pipeline.h"
+#include "base/thread/thread_helper.h"
+
+using base::Pipeline;
+using base::PipelineStageStats;
+using base::WaitableEvent;
+
+TEST_WITH_EM(Pipeline, AllItemsPassThrough) {
+	const int kItems = 10000;
+	Pipeline<int> pipeline(64, 4);
+	pipeline.AddStage("double", 3, [](std::vector<int> &batch) {
+		for (size_t i = 0; i < batch.size(); ++i) {
+			batch[i] *= 2;
+		}
+	});
+	// drops the multiples of 4.
+	pipeline.AddStage("filter", 2, [](std::vector<int> &batch) {
+		batch.erase(std::remove_if(batch.begin(), batch.end(), [](int value) {
+			return value % 4 == 0;
+		}), batch.end());
+	});
+	std::vector<int> output;
+	pipeline.AddStage("collect", 1, [&output](std::vector<int> &batch) {
+		output.insert(output.end(), batch.begin(), batch.end());
+	});
+	ASSERT_TRUE(pipeline.Start());
+	for (int i = 0; i < kItems; ++i) {
+		pipeline.Push(i);
+	}
+	pipeline.Finish();
+	ASSERT_EQ(static_cast<size_t>(kItems / 2), output.size());
+	std::sort(output.begin(), output.end());
+	for (int i = 0; i < kItems / 2; ++i) {
+		EXPECT_EQ(4 * i + 2, output[i]);
+	}
+	EXPECT_EQ(3u, pipeline.stage_count());
+	EXPECT_EQ("filter", pipeline.stage_name(1));
+	PipelineStageStats stats = pipeline.stage_stats(0);
+	EXPECT_EQ(kItems, stats.items_);
+	EXPECT_EQ((kItems + 63) / 64, stats.batches_);
+	EXPECT_EQ(kItems / 2, pipeline.stage_stats(2).items_);
+	EXPECT_EQ(4u, stats.ring_capacity_);
+}
+
+TEST_WITH_EM(Pipeline, BackPressure) {
+	WaitableEvent release(true, false);
+	Pipeline<int> pipeline(1, 2);
+	pipeline.AddStage("fast", 1, [](std::vector<int> &batch) {
+	});
+	int count = 0;
+	pipeline.AddStage("slow", 1, [&release, &count](std::vector<int> &batch) {
+		release.Wait();
+		count += static_cast<int>(batch.size());
+	});
+	pipeline.Start();
+	// the slow stage holds one batch and its ring two, and the fast stage waits with the fourth one until
+	// the slow stage goes on. The source would wait on the seventh.
+	for (int i = 0; i < 5; ++i) {
+		pipeline.Push(i);
+	}
+	base::ThreadHelper::Sleep(50);
+	EXPECT_EQ(0, pipeline.source_blocked_count());
+	EXPECT_EQ(1, pipeline.stage_stats(0).blocked_count_);
+	release.Signal();
+	for (int i = 5; i < 100; ++i) {
+		pipeline.Push(i);
+	}
+	pipeline.Finish();
+	EXPECT_EQ(100, count);
+	EXPECT_EQ(100, pipeline.stage_stats(1).items_);
+}
+
+TEST_WITH_EM(Pipeline, FinishWithoutItems) {
+	Pipeline<int> pipeline(16, 4);
+	int batches = 0;
+	pipeline.AddStage("count", 2, [&batches](std::vector<int> &batch) {
+		++batches;
+	});
+	pipeline.Start();
+	pipeline.Finish();
+	EXPECT_EQ(0, batches);
+}
@@ -0,0 +1,112 @@
+#include "base/thread/sequenced_task_runner.h"
+#include "base/thread/thread_local.h"
+
+namespace base {
+	namespace {
+		// The most tasks a slice runs before it gives the worker back to the pool.
+		const LONG kMaxSliceTasks = 32;
+
+		void PostToSequence(std::shared_ptr<SequencedTaskRunner> runner, std::unique_ptr<Task> task) {
+			runner->PostTask(std::move(task));
+		}
+	}
+
+	// Holds the runner while it is in the pool. If the pool deletes it without running it, the runner
+	// deletes the tasks left once its last reference is gone.
+	class SequencedTaskRunner::Slice : public Task {
+	public:
+		explicit Slice(std::shared_ptr<SequencedTaskRunner> runner) : runner_(runner) {
+		}
+
+		virtual void Run() {
+			runner_->RunSlice();
+		}
+
+	private:
+		std::shared_ptr<SequencedTaskRunner> runner_;
+	};
+
+	std::shared_ptr<SequencedTaskRunner> SequencedTaskRunner::Create(ThreadPool *pool) {
+		return std::shared_ptr<SequencedTaskRunner>(new SequencedTaskRunner(pool));
+	}
+
+	SequencedTaskRunner::SequencedTaskRunner(ThreadPool *pool) : pool_(pool), work_head_(nullptr), pending_count_(0) {
+		assert(pool_ != nullptr);
+	}
+
+	SequencedTaskRunner::~SequencedTaskRunner() {
+		Task *lists[] = {work_head_, incoming_queue_.PopAll()};
+		for (int i = 0; i < 2; ++i) {
+			for (Task *task = lists[i]; task != nullptr;) {
+				Task *next = task->next();
+				delete task;
+				task = next;
+			}
+		}
+	}
+
+	SequencedTaskRunner* SequencedTaskRunner::current() {
+		return internal::LocalStorage<SequencedTaskRunner>::GetInstance()->Get();
+	}
+
+	void SequencedTaskRunner::PostTask(std::unique_ptr<Task> task) {
+		assert(task != nullptr);
+		// the task is in the queue before it is counted, so the slice which the count schedules finds it.
+		incoming_queue_.Push(task.release());
+		if (InterlockedIncrement(&pending_count_) == 1) {
+			Schedule();
+		}
+	}
+
+	void SequencedTaskRunner::PostDelayTask(std::unique_ptr<Task> task, int64_t delay_ms) {
+		if (delay_ms <= 0) {
+			PostTask(std::move(task));
+			return;
+		}
+		Location from_here = task->posted_from();
+		pool_->PostDelayTask(from_here, MakeRunnableFunction(&PostToSequence, shared_from_this(), Passed(std::move(task))),
+			delay_ms);
+	}
+
+	void SequencedTaskRunner::PostTask(const Location &from_here, std::unique_ptr<Task> task) {
+		task->set_posted_from(from_here);
+		PostTask(std::move(task));
+	}
+
+	void SequencedTaskRunner::PostDelayTask(const Location &from_here, std::unique_ptr<Task> task, int64_t delay_ms) {
+		task->set_posted_from(from_here);
+		PostDelayTask(std::move(task), delay_ms);
+	}
+
+	void SequencedTaskRunner::Schedule() {
+		pool_->PostTask(std::unique_ptr<Task>(new Slice(shared_from_this())));
+	}
+
+	void SequencedTaskRunner::RunSlice() {
+		internal::LocalStorage<SequencedTaskRunner> *storage = internal::LocalStorage<SequencedTaskRunner>::GetInstance();
+		SequencedTaskRunner *previous = storage->Get();
+		storage->Set(this);
+		LONG run_count = 0;
+		while (run_count < kMaxSliceTasks) {
+			if (work_head_ == nullptr) {
+				work_head_ = incoming_queue_.PopAll();
+				if (work_head_ == nullptr) {
+					break;
+				}
+			}
+			Task *task = work_head_;
+			work_head_ = task->next();
+			if (!task->IsCanceled()) {
+				task->Run();
+			}
+			task->Retire();
+			++run_count;
+		}
+		storage->Set(previous);
+		// a task may have run before its poster counted it, then the count goes below 0 for a while and
+		// the poster does not schedule it again.
+		if (InterlockedExchangeAdd(&pending_count_, -run_count) - run_count > 0) {
+			Schedule();
+		}
+	}
+}
@@ -0,0 +1,74 @@
+/*
+ * A sequence of tasks which run one at a time and in the order they were posted, on the workers of a
+ * ThreadPool. A component which needs its tasks serialized gets a sequence instead of a thread of its
+ * own, so hundreds of them can share a few workers. The tasks of one sequence may run on a different
+ * worker each time, but never two at once, and each one sees all the effects of the ones before it.
+ *
+ * For example,
+ * base::ThreadPool pool(4);
+ * pool.Start();
+ * std::shared_ptr<base::SequencedTaskRunner> runner = base::SequencedTaskRunner::Create(&pool);
+ * runner->PostTask(FROM_HERE, base::MakeRunnableMethod(this, &Foo::First));
+ * runner->PostTask(FROM_HERE, base::MakeRunnableMethod(this, &Foo::Second));     // runs after First.
+ * ....
+ * void Foo::First() {
+ *     assert(runner_->RunsTasksInCurrentSequence());
+ *     base::SequencedTaskRunner::current()->PostTask(FROM_HERE, base::MakeRunnableMethod(this, &Foo::Third));
+ * }
+ *
+ * The posted tasks hold the runner, so they still run after the last reference of the owner is gone.
+ */
+
+#ifndef BASE_THREAD_SEQUENCED_TASK_RUNNER_H__
+#define BASE_THREAD_SEQUENCED_TASK_RUNNER_H__
+
+#include <memory>
+#include "base/base_types.h"
+#include "base/framework/location.h"
+#include "base/framework/task.h"
+#include "base/synchronization/mpsc_queue.h"
+#include "base/thread/thread_pool.h"
+#include "base/util/noncopyable.h"
+
+namespace base {
+	class SequencedTaskRunner : public std::enable_shared_from_this<SequencedTaskRunner>, public noncopyable {
+	public:
+		// The pool must outlive the tasks of the sequence.
+		static std::shared_ptr<SequencedTaskRunner> Create(ThreadPool *pool);
+		~SequencedTaskRunner();
+		// The runner whose task is running on the current thread, nullptr if there is none.
+		static SequencedTaskRunner* current();
+		// Can be called on any thread. The delayed tasks join the sequence when they are due, in the order
+		// of their due times.
+		void PostTask(std::unique_ptr<Task> task);
+		void PostDelayTask(std::unique_ptr<Task> task, int64_t delay_ms);
+		void PostTask(const Location &from_here, std::unique_ptr<Task> task);
+		void PostDelayTask(const Location &from_here, std::unique_ptr<Task> task, int64_t delay_ms);
+		bool RunsTasksInCurrentSequence() const {
+			return current() == this;
+		}
+
+		ThreadPool* pool() const {
+			return pool_;
+		}
+
+	private:
+		class Slice;
+		friend class Slice;
+		explicit SequencedTaskRunner(ThreadPool *pool);
+		// Post a slice of the sequence to the pool.
+		void Schedule();
+		// Run some of the pending tasks on the current worker, and schedule the rest in another slice.
+		void RunSlice();
+
+		ThreadPool *pool_;
+		MpscQueue<Task> incoming_queue_;
+		// The tasks taken from the incoming queue which have not run yet, only touched by the slice.
+		Task *work_head_;
+		// The tasks posted and not run yet. The one which makes it 1 schedules the sequence, so at most one
+		// slice is in the pool at a time.
+		volatile LONG pending_count_;
+	};
+}
+
+#endif// BASE_THREAD_SEQUENCED_TASK_RUNNER_H__
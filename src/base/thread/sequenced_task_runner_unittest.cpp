@@ -0,0 +1,144 @@
+#include <vector>
+#include "base/synchronization/waitable_event.h"
+#include "base/test/test_with_exit_manager.h"
+#include "base/thread/sequenced_task_runner.h"
+#include "base/thread/thread.h"
+
+using base::SequencedTaskRunner;
+using base::ThreadPool;
+using base::WaitableEvent;
+
+namespace {
+	// Checks that the tasks of one sequence run in order and never at once.
+	class Sequence {
+	public:
+		Sequence() : running_(0), overlaps_(0), out_of_order_(0), next_(0) {
+		}
+
+		void Step(int index) {
+			if (InterlockedIncrement(&running_) != 1) {
+				++overlaps_;
+			}
+			if (index != next_) {
+				++out_of_order_;
+			}
+			next_ = index + 1;
+			// give another worker the chance to run the next one at the same time.
+			base::ThreadHelper::YliedCurrentThread();
+			InterlockedDecrement(&running_);
+		}
+
+		volatile LONG running_;
+		int overlaps_;
+		int out_of_order_;
+		int next_;
+	};
+
+	void Record(std::vector<int> *ids, int id) {
+		ids->push_back(id);
+	}
+
+	void CheckCurrent(SequencedTaskRunner *runner, bool *in_sequence, WaitableEvent *done) {
+		*in_sequence = runner->RunsTasksInCurrentSequence() && SequencedTaskRunner::current() == runner;
+		done->Signal();
+	}
+
+	void PostFromSequence(std::vector<int> *ids, WaitableEvent *done) {
+		ids->push_back(0);
+		SequencedTaskRunner::current()->PostTask(base::MakeRunnableFunction(&Record, ids, 2));
+		SequencedTaskRunner::current()->PostTask(base::MakeRunnableMethod(done, &WaitableEvent::Signal));
+	}
+
+	// The sequence is busy with this task until both are posted.
+	void PostTwo(std::vector<int> *ids, WaitableEvent *done) {
+		SequencedTaskRunner::current()->PostTask(base::MakeRunnableFunction(&PostFromSequence, ids, done));
+		SequencedTaskRunner::current()->PostTask(base::MakeRunnableFunction(&Record, ids, 1));
+	}
+
+	void PostSteps(SequencedTaskRunner *runner, Sequence *sequence, int count) {
+		for (int i = 0; i < count; ++i) {
+			runner->PostTask(base::MakeRunnableMethod(sequence, &Sequence::Step, i));
+		}
+	}
+}
+
+TEST_WITH_EM(SequencedTaskRunner, ManySequencesOnFewWorkers) {
+	const int kSequences = 100;
+	const int kSteps = 200;
+	ThreadPool pool(4);
+	pool.Start();
+	std::vector<std::shared_ptr<SequencedTaskRunner>> runners;
+	std::vector<Sequence> sequences(kSequences);
+	for (int i = 0; i < kSequences; ++i) {
+		runners.push_back(SequencedTaskRunner::Create(&pool));
+	}
+	for (int step = 0; step < kSteps; ++step) {
+		for (int i = 0; i < kSequences; ++i) {
+			runners[i]->PostTask(FROM_HERE, base::MakeRunnableMethod(&sequences[i], &Sequence::Step, step));
+		}
+	}
+	pool.Stop();
+	for (int i = 0; i < kSequences; ++i) {
+		EXPECT_EQ(kSteps, sequences[i].next_);
+		EXPECT_EQ(0, sequences[i].overlaps_);
+		EXPECT_EQ(0, sequences[i].out_of_order_);
+	}
+}
+
+TEST_WITH_EM(SequencedTaskRunner, PostFromWorker) {
+	ThreadPool pool(4);
+	pool.Start();
+	std::shared_ptr<SequencedTaskRunner> runner = SequencedTaskRunner::Create(&pool);
+	Sequence sequence;
+	// the poster is a worker of the same pool.
+	pool.PostTask(base::MakeRunnableFunction(&PostSteps, runner.get(), &sequence, 1000));
+	pool.Stop();
+	EXPECT_EQ(1000, sequence.next_);
+	EXPECT_EQ(0, sequence.overlaps_);
+	EXPECT_EQ(0, sequence.out_of_order_);
+}
+
+TEST_WITH_EM(SequencedTaskRunner, Current) {
+	ThreadPool pool(2);
+	pool.Start();
+	std::shared_ptr<SequencedTaskRunner> runner = SequencedTaskRunner::Create(&pool);
+	std::shared_ptr<SequencedTaskRunner> other = SequencedTaskRunner::Create(&pool);
+	EXPECT_TRUE(SequencedTaskRunner::current() == nullptr);
+	bool in_sequence = false;
+	WaitableEvent done(false, false);
+	runner->PostTask(base::MakeRunnableFunction(&CheckCurrent, runner.get(), &in_sequence, &done));
+	done.Wait();
+	EXPECT_TRUE(in_sequence);
+	other->PostTask(base::MakeRunnableFunction(&CheckCurrent, runner.get(), &in_sequence, &done));
+	done.Wait();
+	EXPECT_FALSE(in_sequence);
+	// a task posted from the sequence runs after the ones before it.
+	std::vector<int> ids;
+	runner->PostTask(base::MakeRunnableFunction(&PostTwo, &ids, &done));
+	done.Wait();
+	pool.Stop();
+	ASSERT_EQ(3u, ids.size());
+	EXPECT_EQ(0, ids[0]);
+	EXPECT_EQ(1, ids[1]);
+	EXPECT_EQ(2, ids[2]);
+}
+
+TEST_WITH_EM(SequencedTaskRunner, DelayedTasks) {
+	ThreadPool pool(2);
+	pool.Start();
+	std::shared_ptr<SequencedTaskRunner> runner = SequencedTaskRunner::Create(&pool);
+	std::vector<int> ids;
+	WaitableEvent done(false, false);
+	runner->PostDelayTask(base::MakeRunnableFunction(&Record, &ids, 2), 20);
+	runner->PostDelayTask(base::MakeRunnableFunction(&Record, &ids, 1), 10);
+	runner->PostTask(base::MakeRunnableFunction(&Record, &ids, 0));
+	runner->PostDelayTask(base::MakeRunnableMethod(&done, &WaitableEvent::Signal), 30);
+	// the delayed tasks keep the runner.
+	runner.reset();
+	done.Wait();
+	pool.Stop();
+	ASSERT_EQ(3u, ids.size());
+	EXPECT_EQ(0, ids[0]);
+	EXPECT_EQ(1, ids[1]);
+	EXPECT_EQ(2, ids[2]);
+}
@@ -0,0 +1,263 @@
+#include "base/thread/task_graph.h"
+
+namespace base {
+	struct TaskGraph::Node {
+		Node() : id_(0), loop_(nullptr), pending_count_(0), skipped_(false) {
+		}
+
+		NodeId id_;
+		std::unique_ptr<Task> work_;
+		MessageLoop *loop_;
+		std::vector<NodeId> predecessors_;
+		std::vector<NodeId> successors_;
+		// The predecessors which have not run yet in this run.
+		volatile LONG pending_count_;
+		// A predecessor did not run in this run, so this one does not either.
+		volatile bool skipped_;
+		TimeTicks start_time_;
+		TimeTicks end_time_;
+	};
+
+	// Dispatched for every node in every run, the work itself stays with the graph.
+	class TaskGraph::NodeTask : public Task {
+	public:
+		NodeTask(TaskGraph *graph, TaskGraph::Node *node) : graph_(graph), node_(node) {
+		}
+
+		virtual void Run() {
+			graph_->RunNode(node_);
+		}
+
+	private:
+		TaskGraph *graph_;
+		// not the link of the task in the queues.
+		TaskGraph::Node *node_;
+	};
+
+	TaskGraph::TaskGraph()
+		: sorted_(true), running_(false), remaining_count_(0), skipped_count_(0), pool_(nullptr), reply_loop_(nullptr),
+		finished_(nullptr) {
+	}
+
+	TaskGraph::~TaskGraph() {
+		assert(!running_);
+	}
+
+	TaskGraph::NodeId TaskGraph::AddNode(std::unique_ptr<Task> work) {
+		assert(!running_);
+		assert(work != nullptr);
+		std::shared_ptr<Node> node(new Node());
+		node->id_ = static_cast<NodeId>(nodes_.size());
+		node->work_ = std::move(work);
+		nodes_.push_back(node);
+		sorted_ = false;
+		return node->id_;
+	}
+
+	TaskGraph::NodeId TaskGraph::AddNode(const Location &from_here, std::unique_ptr<Task> work) {
+		work->set_posted_from(from_here);
+		return AddNode(std::move(work));
+	}
+
+	void TaskGraph::AddDependency(NodeId before, NodeId after) {
+		assert(!running_);
+		assert(before >= 0 && before < node_count() && after >= 0 && after < node_count() && before != after);
+		nodes_[before]->successors_.push_back(after);
+		nodes_[after]->predecessors_.push_back(before);
+		sorted_ = false;
+	}
+
+	void TaskGraph::BindToLoop(NodeId node, MessageLoop *loop) {
+		assert(!running_);
+		assert(node >= 0 && node < node_count());
+		nodes_[node]->loop_ = loop;
+	}
+
+	void TaskGraph::Run(ThreadPool *pool, std::unique_ptr<Task> done) {
+		RunInternal(pool, std::move(done), MessageLoop::current(), nullptr);
+	}
+
+	void TaskGraph::RunAndWait(ThreadPool *pool) {
+		assert(pool == nullptr || !pool->RunsTasksOnCurrentThread());
+		WaitableEvent finished(false, false);
+		RunInternal(pool, nullptr, nullptr, &finished);
+		finished.Wait();
+	}
+
+	void TaskGraph::RunInternal(ThreadPool *pool, std::unique_ptr<Task> done, MessageLoop *reply_loop, WaitableEvent *finished) {
+		assert(!running_);
+		if (!sorted_) {
+			SortNodes();
+		}
+		pool_ = pool;
+		reply_loop_ = reply_loop;
+		done_ = std::move(done);
+		finished_ = finished;
+		for (size_t i = 0; i < nodes_.size(); ++i) {
+			Node *node = nodes_[i].get();
+			node->pending_count_ = static_cast<LONG>(node->predecessors_.size());
+			node->skipped_ = false;
+			node->start_time_ = TimeTicks();
+			node->end_time_ = TimeTicks();
+		}
+		// one more for the dispatch below, so the run can not finish, and be started again by |done|,
+		// before all the first nodes have been dispatched.
+		remaining_count_ = static_cast<LONG>(nodes_.size()) + 1;
+		skipped_count_ = 0;
+		running_ = true;
+		start_time_ = TimeTicks::HightResolutionNow();
+		for (size_t i = 0; i < nodes_.size(); ++i) {
+			if (nodes_[i]->predecessors_.empty()) {
+				Dispatch(nodes_[i].get());
+			}
+		}
+		if (InterlockedDecrement(&remaining_count_) == 0) {
+			Finish();
+		}
+	}
+
+	void TaskGraph::SortNodes() {
+		sorted_nodes_.clear();
+		std::vector<size_t> pending(nodes_.size());
+		for (size_t i = 0; i < nodes_.size(); ++i) {
+			pending[i] = nodes_[i]->predecessors_.size();
+			if (pending[i] == 0) {
+				sorted_nodes_.push_back(static_cast<NodeId>(i));
+			}
+		}
+		for (size_t i = 0; i < sorted_nodes_.size(); ++i) {
+			const std::vector<NodeId> &successors = nodes_[sorted_nodes_[i]]->successors_;
+			for (size_t j = 0; j < successors.size(); ++j) {
+				if (--pending[successors[j]] == 0) {
+					sorted_nodes_.push_back(successors[j]);
+				}
+			}
+		}
+		// the nodes left out are on a cycle and would never run.
+		assert(sorted_nodes_.size() == nodes_.size());
+		sorted_ = true;
+	}
+
+	void TaskGraph::Dispatch(Node *node) {
+		if (node->skipped_) {
+			CompleteNode(node);
+			return;
+		}
+		std::unique_ptr<Task> task(new NodeTask(this, node));
+		task->set_posted_from(node->work_->posted_from());
+		bool posted = false;
+		if (node->loop_ != nullptr) {
+			posted = node->loop_->PostTask(std::move(task));
+		}else {
+			assert(pool_ != nullptr);
+			posted = pool_->PostTask(std::move(task));
+		}
+		if (!posted) {
+			// the loop is overloaded or the pool is stopped, the run goes on without the node.
+			node->skipped_ = true;
+			CompleteNode(node);
+		}
+	}
+
+	void TaskGraph::RunNode(Node *node) {
+		node->start_time_ = TimeTicks::HightResolutionNow();
+		if (!node->work_->IsCanceled()) {
+			node->work_->Run();
+		}
+		node->end_time_ = TimeTicks::HightResolutionNow();
+		CompleteNode(node);
+	}
+
+	void TaskGraph::CompleteNode(Node *node) {
+		if (node->skipped_) {
+			InterlockedIncrement(&skipped_count_);
+		}
+		for (size_t i = 0; i < node->successors_.size(); ++i) {
+			Node *successor = nodes_[node->successors_[i]].get();
+			if (node->skipped_) {
+				// seen by the last predecessor through the decrement below.
+				successor->skipped_ = true;
+			}
+			if (InterlockedDecrement(&successor->pending_count_) == 0) {
+				Dispatch(successor);
+			}
+		}
+		if (InterlockedDecrement(&remaining_count_) == 0) {
+			Finish();
+		}
+	}
+
+	void TaskGraph::Finish() {
+		end_time_ = TimeTicks::HightResolutionNow();
+		std::unique_ptr<Task> done(std::move(done_));
+		MessageLoop *reply_loop = reply_loop_;
+		WaitableEvent *finished = finished_;
+		// the graph can be run again, or destroyed, from here on.
+		MemoryBarrier();
+		running_ = false;
+		if (done != nullptr) {
+			if (reply_loop != nullptr) {
+				reply_loop->PostTask(std::move(done));
+			}else if (!done->IsCanceled()) {
+				done->Run();
+			}
+		}
+		if (finished != nullptr) {
+			finished->Signal();
+		}
+	}
+
+	TaskGraph::NodeTiming TaskGraph::node_timing(NodeId node) const {
+		assert(node >= 0 && node < node_count());
+		NodeTiming timing;
+		const Node *n = nodes_[node].get();
+		if (!n->start_time_.IsNull()) {
+			timing.start_ = n->start_time_ - start_time_;
+			timing.end_ = n->end_time_ - start_time_;
+		}
+		return timing;
+	}
+
+	TimeSpan TaskGraph::run_time() const {
+		return end_time_ - start_time_;
+	}
+
+	TimeSpan TaskGraph::CriticalPath(std::vector<NodeId> *path) const {
+		assert(!running_);
+		if (path != nullptr) {
+			path->clear();
+		}
+		if (nodes_.empty()) {
+			return TimeSpan();
+		}
+		assert(sorted_);
+		// the longest chain of run times which ends at each node, and the predecessor it comes from.
+		std::vector<TimeSpan> longest(nodes_.size());
+		std::vector<NodeId> previous(nodes_.size(), -1);
+		NodeId last = sorted_nodes_[0];
+		for (size_t i = 0; i < sorted_nodes_.size(); ++i) {
+			NodeId id = sorted_nodes_[i];
+			const Node *node = nodes_[id].get();
+			for (size_t j = 0; j < node->predecessors_.size(); ++j) {
+				NodeId predecessor = node->predecessors_[j];
+				if (previous[id] == -1 || longest[previous[id]] < longest[predecessor]) {
+					previous[id] = predecessor;
+				}
+			}
+			longest[id] = node->end_time_ - node->start_time_;
+			if (previous[id] != -1) {
+				longest[id] = longest[id] + longest[previous[id]];
+			}
+			// on a tie the later node wins, so the path runs on through the nodes which took no time.
+			if (!(longest[id] < longest[last])) {
+				last = id;
+			}
+		}
+		if (path != nullptr) {
+			for (NodeId id = last; id != -1; id = previous[id]) {
+				path->insert(path->begin(), id);
+			}
+		}
+		return longest[last];
+	}
+}
@@ -0,0 +1,113 @@
+/*
+ * A graph of tasks which run as soon as the tasks they depend on have run, on the workers of a ThreadPool
+ * or on the MessageLoop a node is bound to. Nobody blocks on a join: the worker which finishes the last
+ * predecessor of a node dispatches it.
+ * The graph is built once and can be run again and again, a run only resets the counters of the nodes.
+ * The nodes are timed on every run, so the critical path of the last run can be looked at.
+ *
+ * For example,
+ * base::TaskGraph graph;
+ * base::TaskGraph::NodeId parse = graph.AddNode(FROM_HERE, base::MakeRunnableMethod(this, &Job::Parse));
+ * base::TaskGraph::NodeId merge = graph.AddNode(FROM_HERE, base::MakeRunnableMethod(this, &Job::Merge));
+ * for (int i = 0; i < kParts; ++i) {
+ *     base::TaskGraph::NodeId transform = graph.AddNode(FROM_HERE, base::MakeRunnableMethod(this, &Job::Transform, i));
+ *     graph.AddDependency(parse, transform);
+ *     graph.AddDependency(transform, merge);
+ * }
+ * graph.Run(&pool, base::MakeRunnableMethod(this, &Job::OnDone));     // OnDone runs on this loop.
+ *
+ * The graph must outlive its runs and must not be changed while it runs.
+ */
+
+#ifndef BASE_THREAD_TASK_GRAPH_H__
+#define BASE_THREAD_TASK_GRAPH_H__
+
+#include <memory>
+#include <vector>
+#include "base/base_types.h"
+#include "base/framework/location.h"
+#include "base/framework/message_loop.h"
+#include "base/framework/task.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/thread/thread_pool.h"
+#include "base/time/time.h"
+#include "base/util/noncopyable.h"
+
+namespace base {
+	class TaskGraph : public noncopyable {
+	public:
+		typedef int NodeId;
+
+		// The timing of a node in the last run, relative to the start of the run.
+		struct NodeTiming {
+			TimeSpan start_;
+			TimeSpan end_;
+		};
+
+		TaskGraph();
+		~TaskGraph();
+		// The work of a node is run once in every run of the graph, so it is kept by the graph.
+		NodeId AddNode(std::unique_ptr<Task> work);
+		NodeId AddNode(const Location &from_here, std::unique_ptr<Task> work);
+		// |after| runs only when |before| has run. A dependency must not make a cycle.
+		void AddDependency(NodeId before, NodeId after);
+		// Run the node on |loop| instead of the pool, for example the work which must be done on the UI thread.
+		void BindToLoop(NodeId node, MessageLoop *loop);
+		// Dispatch the nodes without predecessors and return at once. |done| is posted to the loop of the
+		// caller when all the nodes have run, or run on the thread of the last node if the caller has no loop.
+		// |pool| can be nullptr when every node is bound to a loop.
+		void Run(ThreadPool *pool, std::unique_ptr<Task> done);
+		// Run the graph and block until all the nodes have run. Must not be called on a thread which runs
+		// the nodes.
+		void RunAndWait(ThreadPool *pool);
+		bool running() const {
+			return running_;
+		}
+
+		int node_count() const {
+			return static_cast<int>(nodes_.size());
+		}
+
+		// The functions below describe the last run which has finished.
+		// The nodes which did not run because their loop rejected them, see MessageLoop::SetCapacity, or the
+		// pool was not started, or a node they depend on did not run. The other nodes run and the run
+		// finishes as usual.
+		int skipped_count() const {
+			return skipped_count_;
+		}
+
+		NodeTiming node_timing(NodeId node) const;
+		TimeSpan run_time() const;
+		// The chain of dependent nodes which took the most time, from the first one to the last one.
+		TimeSpan CriticalPath(std::vector<NodeId> *path) const;
+
+	private:
+		struct Node;
+		class NodeTask;
+		friend class NodeTask;
+		void RunInternal(ThreadPool *pool, std::unique_ptr<Task> done, MessageLoop *reply_loop, WaitableEvent *finished);
+		// Order the nodes so that every node comes after its predecessors, and check there is no cycle.
+		void SortNodes();
+		void Dispatch(Node *node);
+		void RunNode(Node *node);
+		// The node has run or is skipped, dispatch the successors which are ready.
+		void CompleteNode(Node *node);
+		void Finish();
+
+		std::vector<std::shared_ptr<Node>> nodes_;
+		// In dependency order, rebuilt when the graph has been changed.
+		std::vector<NodeId> sorted_nodes_;
+		bool sorted_;
+		volatile bool running_;
+		volatile LONG remaining_count_;
+		volatile LONG skipped_count_;
+		ThreadPool *pool_;
+		MessageLoop *reply_loop_;
+		std::unique_ptr<Task> done_;
+		WaitableEvent *finished_;
+		TimeTicks start_time_;
+		TimeTicks end_time_;
+	};
+}
+
+#endif// BASE_THREAD_TASK_GRAPH_H__
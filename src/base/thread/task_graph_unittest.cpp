@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <vector>
+#include "base/thread/task_graph.h"
+#include "base/test/test_tasks.h"
+#include "base/thread/thread.h"
+#include "base/test/test_with_exit_manager.h"
+
+using base::MessageLoop;
+using base::TaskGraph;
+using base::ThreadPool;
+using base::TimeSpan;
+using base::WaitableEvent;
+using base::test::Block;
+using base::test::DoNothing;
+
+namespace {
+	// Records the order the nodes run in.
+	class Recorder : public base::test::Recorder {
+	public:
+		void Sleep(int id, int sleep_ms) {
+			::Sleep(sleep_ms);
+			Record(id);
+		}
+
+		void RecordLoop(MessageLoop **loop) {
+			*loop = MessageLoop::current();
+		}
+	};
+
+	void OnDone(MessageLoop **loop, WaitableEvent *done) {
+		*loop = MessageLoop::current();
+		done->Signal();
+	}
+
+	void RunGraph(TaskGraph *graph, ThreadPool *pool, MessageLoop **loop, WaitableEvent *done) {
+		graph->Run(pool, base::MakeRunnableFunction(&OnDone, loop, done));
+	}
+}
+
+// parse -> 4 transforms -> merge, run three times without being built again.
+TEST_WITH_EM(TaskGraph, RunsInDependencyOrder) {
+	const int kTransforms = 4;
+	ThreadPool pool(3);
+	pool.Start();
+	Recorder recorder;
+	TaskGraph graph;
+	TaskGraph::NodeId parse = graph.AddNode(FROM_HERE, base::MakeRunnableMethod(&recorder, &Recorder::Record, 0));
+	TaskGraph::NodeId merge = graph.AddNode(FROM_HERE, base::MakeRunnableMethod(&recorder, &Recorder::Record, 1));
+	for (int i = 0; i < kTransforms; ++i) {
+		TaskGraph::NodeId transform = graph.AddNode(FROM_HERE, base::MakeRunnableMethod(&recorder, &Recorder::Record, 2 + i));
+		graph.AddDependency(parse, transform);
+		graph.AddDependency(transform, merge);
+	}
+	const int kRuns = 3;
+	for (int i = 0; i < kRuns; ++i) {
+		graph.RunAndWait(&pool);
+		EXPECT_FALSE(graph.running());
+	}
+	pool.Stop();
+	std::vector<int> ids = recorder.ids();
+	ASSERT_EQ(static_cast<size_t>(kRuns * (kTransforms + 2)), ids.size());
+	for (int i = 0; i < kRuns; ++i) {
+		int base = i * (kTransforms + 2);
+		EXPECT_EQ(0, ids[base]);
+		EXPECT_EQ(1, ids[base + kTransforms + 1]);
+	}
+}
+
+TEST_WITH_EM(TaskGraph, EmptyGraph) {
+	TaskGraph graph;
+	graph.RunAndWait(nullptr);
+	EXPECT_FALSE(graph.running());
+	EXPECT_EQ(TimeSpan(), graph.CriticalPath(nullptr));
+}
+
+TEST_WITH_EM(TaskGraph, DonePostedToCallerLoop) {
+	ThreadPool pool(2);
+	pool.Start();
+	base::Thread thread;
+	thread.Start();
+	Recorder recorder;
+	TaskGraph graph;
+	TaskGraph::NodeId first = graph.AddNode(base::MakeRunnableMethod(&recorder, &Recorder::Record, 0));
+	graph.AddDependency(first, graph.AddNode(base::MakeRunnableMethod(&recorder, &Recorder::Record, 1)));
+	MessageLoop *done_loop = nullptr;
+	WaitableEvent done(false, false);
+	thread.message_loop()->PostTask(base::MakeRunnableFunction(&RunGraph, &graph, &pool, &done_loop, &done));
+	done.Wait();
+	EXPECT_EQ(thread.message_loop(), done_loop);
+	thread.Stop();
+	pool.Stop();
+	EXPECT_EQ(2u, recorder.ids().size());
+}
+
+TEST_WITH_EM(TaskGraph, BoundNodeRunsOnLoop) {
+	ThreadPool pool(2);
+	pool.Start();
+	base::Thread thread;
+	thread.Start();
+	Recorder recorder;
+	MessageLoop *pool_loop = nullptr;
+	MessageLoop *bound_loop = nullptr;
+	TaskGraph graph;
+	TaskGraph::NodeId on_pool = graph.AddNode(base::MakeRunnableMethod(&recorder, &Recorder::RecordLoop, &pool_loop));
+	TaskGraph::NodeId on_loop = graph.AddNode(base::MakeRunnableMethod(&recorder, &Recorder::RecordLoop, &bound_loop));
+	graph.AddDependency(on_pool, on_loop);
+	graph.BindToLoop(on_loop, thread.message_loop());
+	graph.RunAndWait(&pool);
+	EXPECT_NE(thread.message_loop(), pool_loop);
+	EXPECT_EQ(thread.message_loop(), bound_loop);
+	thread.Stop();
+	pool.Stop();
+}
+
+// a -> b -> d and a -> c -> d, b is the slow one.
+TEST_WITH_EM(TaskGraph, CriticalPath) {
+	ThreadPool pool(2);
+	pool.Start();
+	Recorder recorder;
+	TaskGraph graph;
+	TaskGraph::NodeId a = graph.AddNode(base::MakeRunnableMethod(&recorder, &Recorder::Record, 0));
+	TaskGraph::NodeId b = graph.AddNode(base::MakeRunnableMethod(&recorder, &Recorder::Sleep, 1, 30));
+	TaskGraph::NodeId c = graph.AddNode(base::MakeRunnableMethod(&recorder, &Recorder::Record, 2));
+	TaskGraph::NodeId d = graph.AddNode(base::MakeRunnableMethod(&recorder, &Recorder::Record, 3));
+	graph.AddDependency(a, b);
+	graph.AddDependency(a, c);
+	graph.AddDependency(b, d);
+	graph.AddDependency(c, d);
+	graph.RunAndWait(&pool);
+	pool.Stop();
+	std::vector<TaskGraph::NodeId> path;
+	TimeSpan length = graph.CriticalPath(&path);
+	ASSERT_EQ(3u, path.size());
+	EXPECT_EQ(a, path[0]);
+	EXPECT_EQ(b, path[1]);
+	EXPECT_EQ(d, path[2]);
+	EXPECT_LE(TimeSpan::FromMilliseconds(25), length);
+	EXPECT_LE(length, graph.run_time());
+	TaskGraph::NodeTiming timing = graph.node_timing(d);
+	EXPECT_LE(graph.node_timing(b).end_, timing.start_);
+}
+
+// a -> b -> c and d, b is bound to a loop which rejects it, so b and c are skipped.
+TEST_WITH_EM(TaskGraph, RejectedNodeIsSkipped) {
+	ThreadPool pool(2);
+	pool.Start();
+	base::Thread thread;
+	thread.Start();
+	// the loop is busy with one task and has another one waiting, which fills it.
+	WaitableEvent started(false, false);
+	WaitableEvent release(false, false);
+	thread.message_loop()->SetCapacity(1, MessageLoop::kRejectTask);
+	thread.message_loop()->PostTask(base::MakeRunnableFunction(&Block, &started, &release));
+	started.Wait();
+	ASSERT_TRUE(thread.message_loop()->PostTask(base::MakeRunnableFunction(&DoNothing)));
+	Recorder recorder;
+	TaskGraph graph;
+	TaskGraph::NodeId a = graph.AddNode(base::MakeRunnableMethod(&recorder, &Recorder::Record, 0));
+	TaskGraph::NodeId b = graph.AddNode(base::MakeRunnableMethod(&recorder, &Recorder::Record, 1));
+	TaskGraph::NodeId c = graph.AddNode(base::MakeRunnableMethod(&recorder, &Recorder::Record, 2));
+	graph.AddNode(base::MakeRunnableMethod(&recorder, &Recorder::Record, 3));
+	graph.AddDependency(a, b);
+	graph.AddDependency(b, c);
+	graph.BindToLoop(b, thread.message_loop());
+	graph.RunAndWait(&pool);
+	EXPECT_FALSE(graph.running());
+	EXPECT_EQ(2, graph.skipped_count());
+	std::vector<int> ids = recorder.ids();
+	ASSERT_EQ(2u, ids.size());
+	std::sort(ids.begin(), ids.end());
+	EXPECT_EQ(0, ids[0]);
+	EXPECT_EQ(3, ids[1]);
+	release.Signal();
+	// room for the quit task of Stop.
+	thread.message_loop()->SetCapacity(0, MessageLoop::kBlockProducer);
+	thread.Stop();
+	pool.Stop();
+}
@@ -41,8 +41,18 @@ namespace base {
 		{
 			assert(startup_data_ != nullptr);
 			//note: we can only create message loop here because of the tls feature.
-			MessageLoop message_loop(startup_data_->options_.message_loop_type_);
-			message_loop_ = &message_loop;
+			// the subclass of the type, so UIMessageLoop::current() and IOMessageLoop::current() work.
+			std::unique_ptr<MessageLoop> message_loop;
+			MessageLoop::MessageLoopType type = startup_data_->options_.message_loop_type_;
+			if (type == MessageLoop::kUIMessageLoop) {
+				message_loop.reset(new UIMessageLoop());
+			}else if (type == MessageLoop::kIOMessageLoop) {
+				message_loop.reset(new IOMessageLoop());
+			}else {
+				message_loop.reset(new MessageLoop(type));
+			}
+			message_loop->SetDelayedQueueType(startup_data_->options_.delayed_queue_type_);
+			message_loop_ = message_loop.get();
 			thread_id_ = ThreadHelper::CurrentId();
 			SetUp();
 			// wait message loop to be created.
@@ -15,10 +15,11 @@ namespace base {
 	public:
 		struct Options{
 			Options(MessageLoop::MessageLoopType type=MessageLoop::kDefaultMessageLoop)
-				: message_loop_type_(type){
+				: message_loop_type_(type), delayed_queue_type_(MessageLoop::kHeapDelayedQueue){
 			}
 
 			MessageLoop::MessageLoopType message_loop_type_;
+			MessageLoop::DelayedQueueType delayed_queue_type_;
 		};
 
 		Thread();
@@ -0,0 +1,354 @@
+#include "base/thread/thread_pool.h"
+#include "base/synchronization/work_stealing_deque.h"
+#include "base/thread/thread_local.h"
+
+namespace base {
+	namespace {
+		// The most tasks a worker moves from the injection queue to its deque at once.
+		const LONG kMaxInjectionBatch = 16;
+		// How many times a thief retries a victim which it lost a race on.
+		const int kMaxStealAttempts = 4;
+	}
+
+	// A worker runs the tasks of the pool instead of its message loop, the loop only runs the quit task of
+	// Thread::Stop after the pool has stopped.
+	class ThreadPool::Worker : public Thread {
+	public:
+		Worker(ThreadPool *pool, int index) : pool_(pool), index_(index), random_(0x9E3779B9u * (index + 1)) {
+		}
+
+		ThreadPool* pool() const {
+			return pool_;
+		}
+
+		int index() const {
+			return index_;
+		}
+
+		WorkStealingDeque<Task>& deque() {
+			return deque_;
+		}
+
+		// xorshift, good enough to spread the thieves over the victims.
+		unsigned int NextRandom() {
+			random_ ^= random_ << 13;
+			random_ ^= random_ >> 17;
+			random_ ^= random_ << 5;
+			return random_;
+		}
+
+		static Worker* current() {
+			return internal::LocalStorage<Worker>::GetInstance()->Get();
+		}
+
+	protected:
+		virtual void Run(MessageLoop *message_loop) {
+			internal::LocalStorage<Worker>::GetInstance()->Set(this);
+			pool_->RunWorker(this);
+			internal::LocalStorage<Worker>::GetInstance()->Set(nullptr);
+			message_loop->Run();
+		}
+
+	private:
+		ThreadPool *pool_;
+		int index_;
+		unsigned int random_;
+		WorkStealingDeque<Task> deque_;
+	};
+
+	// Runs on the timer thread when a delayed task is due and moves it into the pool.
+	class ThreadPool::DelayedInjection : public Task {
+	public:
+		DelayedInjection(ThreadPool *pool, Task *task) : pool_(pool), task_(task) {
+		}
+
+		~DelayedInjection() {
+			// the pool stopped before the task was due.
+			delete task_;
+		}
+
+		virtual void Run() {
+			Task *task = task_;
+			task_ = nullptr;
+			pool_->Inject(task);
+		}
+
+	private:
+		ThreadPool *pool_;
+		Task *task_;
+	};
+
+	ThreadPool::ThreadPool(int worker_count)
+		: worker_count_(worker_count), started_(false), quit_(false), injected_head_(nullptr), injected_tail_(nullptr),
+		injected_count_(0), idle_count_(0), steal_count_(0) {
+		if (worker_count_ <= 0) {
+			SYSTEM_INFO info;
+			GetSystemInfo(&info);
+			worker_count_ = static_cast<int>(info.dwNumberOfProcessors);
+		}
+		semaphore_ = CreateSemaphore(nullptr, 0, 0x7FFFFFFF, nullptr);
+		assert(semaphore_ != nullptr);
+	}
+
+	ThreadPool::~ThreadPool() {
+		Stop();
+		DeleteTasks(injected_head_);
+		CloseHandle(semaphore_);
+	}
+
+	bool ThreadPool::Start() {
+		if (started_) {
+			return true;
+		}
+		quit_ = false;
+		timer_thread_ = std::shared_ptr<Thread>(new Thread());
+		if (!timer_thread_->Start()) {
+			timer_thread_.reset();
+			return false;
+		}
+		for (int i = 0; i < worker_count_; ++i) {
+			std::shared_ptr<Worker> worker(new Worker(this, i));
+			workers_.push_back(worker);
+		}
+		// all the deques exist before any worker starts to steal.
+		for (int i = 0; i < worker_count_; ++i) {
+			if (!workers_[i]->Start()) {
+				StopWorkers();
+				timer_thread_->Stop();
+				timer_thread_.reset();
+				return false;
+			}
+		}
+		started_ = true;
+		return true;
+	}
+
+	void ThreadPool::Stop() {
+		if (!started_) {
+			return;
+		}
+		assert(!RunsTasksOnCurrentThread());
+		// the delayed tasks which are not due yet are deleted with the loop of the timer thread.
+		timer_thread_->Stop();
+		StopWorkers();
+		// every worker leaves its deque empty, only the tasks posted during the stop may be left.
+		DeleteTasks(injected_head_);
+		injected_head_ = nullptr;
+		injected_tail_ = nullptr;
+		injected_count_ = 0;
+		timer_thread_.reset();
+		started_ = false;
+	}
+
+	bool ThreadPool::PostTask(std::unique_ptr<Task> task) {
+		if (!started_) {
+			return false;
+		}
+		Inject(task.release());
+		return true;
+	}
+
+	bool ThreadPool::PostDelayTask(std::unique_ptr<Task> task, int64_t delay_ms) {
+		if (delay_ms <= 0) {
+			return PostTask(std::move(task));
+		}
+		if (!started_) {
+			return false;
+		}
+		// the loop is gone once Stop has stopped the timer thread.
+		MessageLoop *timer_loop = timer_thread_->message_loop();
+		if (timer_loop == nullptr) {
+			return false;
+		}
+		Location from_here = task->posted_from();
+		std::unique_ptr<Task> injection(new DelayedInjection(this, task.release()));
+		return timer_loop->PostDelayTask(from_here, std::move(injection), delay_ms);
+	}
+
+	bool ThreadPool::PostTask(const Location &from_here, std::unique_ptr<Task> task) {
+		task->set_posted_from(from_here);
+		return PostTask(std::move(task));
+	}
+
+	bool ThreadPool::PostDelayTask(const Location &from_here, std::unique_ptr<Task> task, int64_t delay_ms) {
+		task->set_posted_from(from_here);
+		return PostDelayTask(std::move(task), delay_ms);
+	}
+
+	bool ThreadPool::RunsTasksOnCurrentThread() const {
+		Worker *worker = Worker::current();
+		return worker != nullptr && worker->pool() == this;
+	}
+
+	void ThreadPool::Inject(Task *task) {
+		assert(task != nullptr);
+		Worker *worker = Worker::current();
+		if (worker != nullptr && worker->pool() == this) {
+			worker->deque().Push(task);
+		}else {
+			task->set_next(nullptr);
+			AutoLock lock(injected_lock_);
+			if (injected_tail_ == nullptr) {
+				injected_head_ = task;
+			}else {
+				injected_tail_->set_next(task);
+			}
+			injected_tail_ = task;
+			++injected_count_;
+		}
+		WakeUpWorker();
+	}
+
+	void ThreadPool::RunWorker(Worker *worker) {
+		for (;;) {
+			Task *task = worker->deque().Pop();
+			if (task == nullptr) {
+				task = TakeInjected(worker);
+			}
+			if (task == nullptr) {
+				task = Steal(worker);
+			}
+			if (task != nullptr) {
+				RunTask(task);
+				continue;
+			}
+			if (quit_) {
+				break;
+			}
+			WaitForWork(worker);
+		}
+	}
+
+	void ThreadPool::StopWorkers() {
+		quit_ = true;
+		ReleaseSemaphore(semaphore_, static_cast<LONG>(workers_.size()), nullptr);
+		for (size_t i = 0; i < workers_.size(); ++i) {
+			workers_[i]->Stop();
+		}
+		workers_.clear();
+	}
+
+	Task* ThreadPool::TakeInjected(Worker *worker) {
+		if (injected_count_ == 0) {
+			return nullptr;
+		}
+		Task *first = nullptr;
+		LONG taken = 0;
+		{
+			AutoLock lock(injected_lock_);
+			if (injected_head_ == nullptr) {
+				return nullptr;
+			}
+			// leave some for the other workers.
+			LONG batch = injected_count_ / worker_count_ + 1;
+			if (batch > kMaxInjectionBatch) {
+				batch = kMaxInjectionBatch;
+			}
+			first = injected_head_;
+			Task *last = first;
+			for (taken = 1; taken < batch && last->next() != nullptr; ++taken) {
+				last = last->next();
+			}
+			injected_head_ = last->next();
+			if (injected_head_ == nullptr) {
+				injected_tail_ = nullptr;
+			}
+			last->set_next(nullptr);
+			injected_count_ -= taken;
+		}
+		Task *rest = first->next();
+		if (rest != nullptr) {
+			// the older ones are stolen first.
+			for (Task *task = rest; task != nullptr;) {
+				Task *next = task->next();
+				worker->deque().Push(task);
+				task = next;
+			}
+			WakeUpWorker();
+		}
+		return first;
+	}
+
+	Task* ThreadPool::Steal(Worker *worker) {
+		if (worker_count_ < 2) {
+			return nullptr;
+		}
+		int start = static_cast<int>(worker->NextRandom() % worker_count_);
+		for (int i = 0; i < worker_count_; ++i) {
+			Worker *victim = workers_[(start + i) % worker_count_].get();
+			if (victim == worker) {
+				continue;
+			}
+			for (int attempt = 0; attempt < kMaxStealAttempts; ++attempt) {
+				Task *task = nullptr;
+				WorkStealingDeque<Task>::StealResult result = victim->deque().Steal(&task);
+				if (result == WorkStealingDeque<Task>::kStealSuccess) {
+					InterlockedIncrement(&steal_count_);
+					return task;
+				}
+				if (result == WorkStealingDeque<Task>::kStealEmpty) {
+					break;
+				}
+			}
+		}
+		return nullptr;
+	}
+
+	void ThreadPool::RunTask(Task *task) {
+		if (!task->IsCanceled()) {
+			task->Run();
+		}
+		task->Retire();
+	}
+
+	void ThreadPool::WaitForWork(Worker *worker) {
+		InterlockedIncrement(&idle_count_);
+		// a poster which missed the idle count has pushed its task already, so look once more.
+		if (HasWork() || quit_) {
+			// give the count back unless a poster has taken it, then the semaphore is released once more
+			// than needed and a worker wakes up for nothing.
+			LONG idle = idle_count_;
+			while (idle > 0) {
+				if (InterlockedCompareExchange(&idle_count_, idle - 1, idle) == idle) {
+					break;
+				}
+				idle = idle_count_;
+			}
+			return;
+		}
+		WaitForSingleObject(semaphore_, INFINITE);
+	}
+
+	void ThreadPool::WakeUpWorker() {
+		MemoryBarrier();
+		// whoever takes one from the idle count releases the semaphore once.
+		LONG idle = idle_count_;
+		while (idle > 0) {
+			if (InterlockedCompareExchange(&idle_count_, idle - 1, idle) == idle) {
+				ReleaseSemaphore(semaphore_, 1, nullptr);
+				return;
+			}
+			idle = idle_count_;
+		}
+	}
+
+	bool ThreadPool::HasWork() const {
+		if (injected_count_ > 0) {
+			return true;
+		}
+		for (size_t i = 0; i < workers_.size(); ++i) {
+			if (!workers_[i]->deque().empty()) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void ThreadPool::DeleteTasks(Task *list) {
+		while (list != nullptr) {
+			Task *next = list->next();
+			delete list;
+			list = next;
+		}
+	}
+}
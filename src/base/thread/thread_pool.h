@@ -0,0 +1,99 @@
+/*
+ * A pool of worker threads which balance the tasks among themselves by stealing.
+ * Each worker has a work-stealing deque. The tasks posted from a worker go into its own deque and it runs
+ * them newest first while they are hot in the cache, the tasks posted from the other threads go into a
+ * global injection queue. A worker which runs out of tasks takes a batch from the injection queue, then
+ * tries to steal the oldest task of the other workers in a random order, and parks when there is none.
+ * So an uneven load spreads over all the workers instead of piling up on the one it was posted to.
+ *
+ * For example,
+ * base::ThreadPool pool(4);
+ * pool.Start();
+ * pool.PostTask(FROM_HERE, base::MakeRunnableMethod(this, &Foo::Bar));
+ * ....
+ * pool.Stop();      // runs the posted tasks before it returns.
+ *
+ * Unlike a MessageLoop the tasks of a pool run in no particular order and on any worker.
+ */
+
+#ifndef BASE_THREAD_THREAD_POOL_H__
+#define BASE_THREAD_THREAD_POOL_H__
+
+#include <memory>
+#include <vector>
+#include "base/base_types.h"
+#include "base/framework/location.h"
+#include "base/framework/task.h"
+#include "base/synchronization/lock.h"
+#include "base/thread/thread.h"
+#include "base/util/noncopyable.h"
+
+namespace base {
+	class ThreadPool : public noncopyable {
+	public:
+		// 0 workers means one for each processor.
+		explicit ThreadPool(int worker_count = 0);
+		// Stop the pool if it is running.
+		~ThreadPool();
+		// Return false, with no thread left running, if a thread cannot be started.
+		bool Start();
+		// Wait until all the posted tasks have run and the workers have exited. The delayed tasks which
+		// are not due yet are deleted. Must not be called on a worker.
+		void Stop();
+		// Can be called on any thread, including the workers. Return false and delete the task if the
+		// pool is not started, or for a delayed task once the pool is stopping.
+		bool PostTask(std::unique_ptr<Task> task);
+		bool PostDelayTask(std::unique_ptr<Task> task, int64_t delay_ms);
+		bool PostTask(const Location &from_here, std::unique_ptr<Task> task);
+		bool PostDelayTask(const Location &from_here, std::unique_ptr<Task> task, int64_t delay_ms);
+		int worker_count() const {
+			return worker_count_;
+		}
+
+		// The number of tasks taken from another worker so far.
+		LONG steal_count() const {
+			return steal_count_;
+		}
+
+		// Return true if the current thread is a worker of this pool.
+		bool RunsTasksOnCurrentThread() const;
+
+	private:
+		class Worker;
+		class DelayedInjection;
+		friend class Worker;
+		friend class DelayedInjection;
+		// Push the task into the deque of the current worker, or into the injection queue.
+		void Inject(Task *task);
+		void RunWorker(Worker *worker);
+		// Quit the workers, which may have been started only in part.
+		void StopWorkers();
+		// Take a task from the injection queue, the rest of a batch goes into the deque of the worker.
+		Task* TakeInjected(Worker *worker);
+		Task* Steal(Worker *worker);
+		void RunTask(Task *task);
+		// Park the worker until there may be a task for it, or until the pool stops.
+		void WaitForWork(Worker *worker);
+		void WakeUpWorker();
+		bool HasWork() const;
+		void DeleteTasks(Task *list);
+
+		int worker_count_;
+		bool started_;
+		volatile bool quit_;
+		std::vector<std::shared_ptr<Worker>> workers_;
+		// Runs the delayed tasks of the pool, which are injected when they are due.
+		std::shared_ptr<Thread> timer_thread_;
+		// The tasks posted from the other threads in FIFO order, linked by Task::next().
+		LockImpl injected_lock_;
+		Task *injected_head_;
+		Task *injected_tail_;
+		volatile LONG injected_count_;
+		// The parked workers wait on the semaphore.
+		HANDLE semaphore_;
+		volatile LONG idle_count_;
+		volatile LONG steal_count_;
+	};
+}
+
+#endif// BASE_THREAD_THREAD_POOL_H__
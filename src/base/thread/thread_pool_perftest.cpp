@@ -0,0 +1,127 @@
+#include <sstream>
+#include <vector>
+#include "base/synchronization/waitable_event.h"
+#include "base/test/perf_reporter.h"
+#include "base/test/test_with_exit_manager.h"
+#include "base/thread/thread.h"
+#include "base/thread/thread_pool.h"
+
+using base::Thread;
+using base::ThreadPool;
+using base::TimeTicks;
+using base::WaitableEvent;
+
+namespace {
+	const int kWorkers = 4;
+
+	// Burn about a microsecond for each unit, calibrated once so the tasks do not read the clock.
+	volatile int64_t spin_sink = 0;
+	int64_t spins_per_us = 0;
+
+	void SpinFor(int64_t spins) {
+		for (int64_t i = 0; i < spins; ++i) {
+			spin_sink += i;
+		}
+	}
+
+	void CalibrateSpin() {
+		if (spins_per_us != 0) {
+			return;
+		}
+		const int64_t kSpins = 1 << 24;
+		TimeTicks start = TimeTicks::Now();
+		SpinFor(kSpins);
+		int64_t elapsed_us = (TimeTicks::Now() - start).ToMicroseconds();
+		spins_per_us = elapsed_us > 0 ? kSpins / elapsed_us : 1;
+		if (spins_per_us == 0) {
+			spins_per_us = 1;
+		}
+	}
+
+	class Counter {
+	public:
+		Counter(LONG total, WaitableEvent *done) : count_(0), total_(total), done_(done) {
+		}
+
+		void Spin(int64_t us) {
+			SpinFor(us * spins_per_us);
+			if (InterlockedIncrement(&count_) == total_) {
+				done_->Signal();
+			}
+		}
+
+	private:
+		volatile LONG count_;
+		LONG total_;
+		WaitableEvent *done_;
+	};
+
+	// The cost of the i-th task of a workload.
+	typedef int64_t (*Workload)(int i);
+
+	int64_t FineGrained(int i) {
+		return 1;
+	}
+
+	// One of every worker count tasks is 500 times heavier, round robin puts all of them on one thread.
+	int64_t Skewed(int i) {
+		return i % kWorkers == 0 ? 500 : 1;
+	}
+
+	void RunOnPool(const std::string &watch_name, int task_count, Workload workload) {
+		CalibrateSpin();
+		WaitableEvent done(false, false);
+		Counter counter(task_count, &done);
+		ThreadPool pool(kWorkers);
+		pool.Start();
+		base::PerfReporter reporter(task_count);
+		base::StopWatch watch(base::StringPiece(watch_name), &reporter);
+		watch.Start();
+		for (int i = 0; i < task_count; ++i) {
+			pool.PostTask(base::MakeRunnableMethod(&counter, &Counter::Spin, workload(i)));
+		}
+		done.Wait();
+		watch.Stop();
+		watch.Report();
+		std::cout << "  " << pool.steal_count() << " steals" << std::endl;
+		pool.Stop();
+	}
+
+	// The same tasks dealt to one message loop after another.
+	void RunRoundRobin(const std::string &watch_name, int task_count, Workload workload) {
+		CalibrateSpin();
+		WaitableEvent done(false, false);
+		Counter counter(task_count, &done);
+		std::vector<std::shared_ptr<Thread>> threads;
+		for (int i = 0; i < kWorkers; ++i) {
+			threads.push_back(std::shared_ptr<Thread>(new Thread()));
+			threads.back()->Start();
+		}
+		base::PerfReporter reporter(task_count);
+		base::StopWatch watch(base::StringPiece(watch_name), &reporter);
+		watch.Start();
+		for (int i = 0; i < task_count; ++i) {
+			threads[i % kWorkers]->message_loop()->PostTask(base::MakeRunnableMethod(&counter, &Counter::Spin, workload(i)));
+		}
+		done.Wait();
+		watch.Stop();
+		watch.Report();
+		for (int i = 0; i < kWorkers; ++i) {
+			threads[i]->Stop();
+		}
+	}
+}
+
+// 1us tasks, the cost of scheduling dominates.
+TEST_WITH_EM(ThreadPoolPerfTest, FineGrainedTasks) {
+	const int kTaskCount = 1 << 18;
+	RunOnPool("ThreadPool 1us tasks", kTaskCount, &FineGrained);
+	RunRoundRobin("Round robin 1us tasks", kTaskCount, &FineGrained);
+}
+
+// The idle workers steal the tasks queued behind the heavy ones, round robin waits for the busiest thread.
+TEST_WITH_EM(ThreadPoolPerfTest, SkewedTasks) {
+	const int kTaskCount = 1 << 12;
+	RunOnPool("ThreadPool skewed tasks", kTaskCount, &Skewed);
+	RunRoundRobin("Round robin skewed tasks", kTaskCount, &Skewed);
+}
@@ -0,0 +1,139 @@
+#include "base/thread/thread_pool.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/test/test_tasks.h"
+#include "base/test/test_with_exit_manager.h"
+
+using base::ThreadPool;
+using base::TimeSpan;
+using base::TimeTicks;
+using base::WaitableEvent;
+using base::test::DeleteTracker;
+using base::test::Hold;
+
+namespace {
+	void Increase(volatile LONG *count) {
+		InterlockedIncrement(count);
+	}
+
+	// Posts two children from the worker until the depth runs out.
+	void FanOut(ThreadPool *pool, int depth, volatile LONG *count) {
+		InterlockedIncrement(count);
+		if (depth > 0) {
+			pool->PostTask(base::MakeRunnableFunction(&FanOut, pool, depth - 1, count));
+			pool->PostTask(base::MakeRunnableFunction(&FanOut, pool, depth - 1, count));
+		}
+	}
+
+	void SignalAt(TimeTicks *run_time, WaitableEvent *done) {
+		*run_time = TimeTicks::Now();
+		done->Signal();
+	}
+
+	void CheckCurrentThread(ThreadPool *pool, bool *on_worker, WaitableEvent *done) {
+		*on_worker = pool->RunsTasksOnCurrentThread();
+		done->Signal();
+	}
+
+	void Release(WaitableEvent *release) {
+		release->Signal();
+	}
+
+	// Pushes the children into its own deque and blocks until one of them has run, so another worker
+	// has to steal it.
+	void BlockOnChildren(ThreadPool *pool, int count, WaitableEvent *release) {
+		for (int i = 0; i < count; ++i) {
+			pool->PostTask(base::MakeRunnableFunction(&Release, release));
+		}
+		release->Wait();
+	}
+}
+
+TEST_WITH_EM(ThreadPool, RunsAllTasks) {
+	const int kCount = 10000;
+	ThreadPool pool(4);
+	EXPECT_EQ(4, pool.worker_count());
+	ASSERT_TRUE(pool.Start());
+	volatile LONG count = 0;
+	for (int i = 0; i < kCount; ++i) {
+		pool.PostTask(FROM_HERE, base::MakeRunnableFunction(&Increase, &count));
+	}
+	pool.Stop();
+	EXPECT_EQ(kCount, count);
+}
+
+TEST_WITH_EM(ThreadPool, TasksPostedFromWorkers) {
+	ThreadPool pool(3);
+	pool.Start();
+	volatile LONG count = 0;
+	pool.PostTask(base::MakeRunnableFunction(&FanOut, &pool, 10, &count));
+	pool.Stop();
+	EXPECT_EQ((1 << 11) - 1, count);
+}
+
+TEST_WITH_EM(ThreadPool, IdleWorkersSteal) {
+	ThreadPool pool(2);
+	pool.Start();
+	WaitableEvent release(false, false);
+	pool.PostTask(base::MakeRunnableFunction(&BlockOnChildren, &pool, 8, &release));
+	pool.Stop();
+	EXPECT_GE(pool.steal_count(), 1);
+}
+
+TEST_WITH_EM(ThreadPool, DelayedTask) {
+	ThreadPool pool(2);
+	pool.Start();
+	WaitableEvent done(false, false);
+	TimeTicks run_time;
+	TimeTicks post_time = TimeTicks::Now();
+	pool.PostDelayTask(FROM_HERE, base::MakeRunnableFunction(&SignalAt, &run_time, &done), 20);
+	done.Wait();
+	pool.Stop();
+	EXPECT_LE(TimeSpan::FromMilliseconds(20), run_time - post_time);
+}
+
+TEST_WITH_EM(ThreadPool, StopDeletesPendingDelayedTasks) {
+	bool deleted = false;
+	bool ran = false;
+	{
+		ThreadPool pool(2);
+		pool.Start();
+		std::shared_ptr<DeleteTracker> tracker(new DeleteTracker(&deleted));
+		pool.PostDelayTask(base::MakeRunnableFunction(&Hold, tracker, &ran), 10000);
+		tracker.reset();
+		pool.Stop();
+		EXPECT_TRUE(deleted);
+	}
+	EXPECT_FALSE(ran);
+}
+
+TEST_WITH_EM(ThreadPool, PostWhenNotStarted) {
+	bool deleted = false;
+	bool ran = false;
+	ThreadPool pool(2);
+	EXPECT_FALSE(pool.PostTask(base::MakeRunnableFunction(&Hold, std::shared_ptr<DeleteTracker>(), &ran)));
+	EXPECT_FALSE(pool.PostDelayTask(base::MakeRunnableFunction(&Hold,
+		std::shared_ptr<DeleteTracker>(new DeleteTracker(&deleted)), &ran), 10));
+	EXPECT_TRUE(deleted);
+	ASSERT_TRUE(pool.Start());
+	EXPECT_TRUE(pool.PostTask(FROM_HERE, base::MakeRunnableFunction(&Hold, std::shared_ptr<DeleteTracker>(), &ran)));
+	pool.Stop();
+	EXPECT_TRUE(ran);
+	ran = false;
+	deleted = false;
+	EXPECT_FALSE(pool.PostDelayTask(FROM_HERE, base::MakeRunnableFunction(&Hold,
+		std::shared_ptr<DeleteTracker>(new DeleteTracker(&deleted)), &ran), 10));
+	EXPECT_TRUE(deleted);
+	EXPECT_FALSE(ran);
+}
+
+TEST_WITH_EM(ThreadPool, RunsTasksOnCurrentThread) {
+	ThreadPool pool(2);
+	pool.Start();
+	EXPECT_FALSE(pool.RunsTasksOnCurrentThread());
+	bool on_worker = false;
+	WaitableEvent done(false, false);
+	pool.PostTask(base::MakeRunnableFunction(&CheckCurrentThread, &pool, &on_worker, &done));
+	done.Wait();
+	pool.Stop();
+	EXPECT_TRUE(on_worker);
+}
@@ -87,7 +87,7 @@ namespace base {
 				if (!QueryPerformanceFrequency(&ticks_per_second)) {
 					return;
 				}
-				ticks_per_microsecond_ = static_cast<float>(ticks_per_second.QuadPart) / static_cast<float>(UnitConversion::kMicrosecondsPerSecond);
+				ticks_per_microsecond_ = static_cast<double>(ticks_per_second.QuadPart) / static_cast<double>(UnitConversion::kMicrosecondsPerSecond);
 				skew_ = UnreliableNow() - ReliableNow();
 			}
 
@@ -101,7 +101,7 @@ namespace base {
 				return RolloverProtectedNow().ToMicroseconds();
 			}
 
-			float ticks_per_microsecond_;
+			double ticks_per_microsecond_;
 			int64_t skew_;
 		};
 	}
@@ -422,6 +422,14 @@ namespace base {
 		return TimeTicks() + time_helper::HighResolutionNowSingleton::GetInstance()->Now();
 	}
 
+	TimeTicks TimeTicks::ThreadNow() {
+		FILETIME creation_time, exit_time, kernel_time, user_time;
+		if (!::GetThreadTimes(::GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time)) {
+			return TimeTicks();
+		}
+		return TimeTicks(time_helper::FileTimeToMicroseconds(kernel_time) + time_helper::FileTimeToMicroseconds(user_time));
+	}
+
   TimeTicks& TimeTicks::operator=(TimeTicks other) {
     ticks_ = other.ticks_;
     return *this;
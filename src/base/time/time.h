@@ -176,6 +176,9 @@ namespace base {
 		static TimeTicks Now();
 		//TODO(oldman): Rename it to "HighResolutionNow"
 		static TimeTicks HightResolutionNow();
+		// The CPU time the current thread has used in user and kernel mode, only the difference of two
+		// readings on the same thread makes sense. It advances by the scheduler tick, about 15ms.
+		static TimeTicks ThreadNow();
 		bool IsNull() const {
 			return ticks_ == 0;
 		}
@@ -1,118 +1,311 @@
 /*
- * This file defined some helper functions to Invoke a method or function with certain params.it used
- * std::trl::tuple to pass the arguments.
+ * This file defined some helper functions to Invoke a method or function with certain params. The params
+ * are moved into a ParamsN object when the task is built and passed to the call as lvalues, so a method
+ * which takes a const reference gets the bound object itself and the task can be run more than once.
+ * A move-only param, or one which must be moved into the call, is bound with Passed(), the call then
+ * takes it away from the task.
+ * For example,
+ * std::unique_ptr<Buffer> buffer(new Buffer());
+ * loop->PostTask(base::MakeRunnableMethod(writer, &Writer::Write, base::Passed(std::move(buffer))));
+ * // void Writer::Write(std::unique_ptr<Buffer> buffer);
  */
 
 #ifndef BASE_FRAMEWORK_TASK_BUILDER_H__
 #define BASE_FRAMEWORK_TASK_BUILDER_H__
 
-#include <tuple>
+#include <assert.h>
+#include <type_traits>
+#include <utility>
 
 namespace base {
-	using std::tr1::tuple;
-	template<class T, class Method>
-	inline void DispatchToMethod(T *obj, Method method, const tuple<std::tr1::_Nil> &arg) {
-		(obj->*method)();
+	namespace internal {
+		template<class T>
+		class PassedWrapper {
+		public:
+			explicit PassedWrapper(T &&value) : value_(std::move(value)), is_valid_(true) {
+			}
+
+			PassedWrapper(PassedWrapper &&other) : value_(std::move(other.value_)), is_valid_(other.is_valid_) {
+				other.is_valid_ = false;
+			}
+
+			// A passed param can only be taken once, so a task which binds one can only be run once.
+			T Take() {
+				assert(is_valid_);
+				is_valid_ = false;
+				return std::move(value_);
+			}
+
+		private:
+			T value_;
+			bool is_valid_;
+		};
+
+		template<class T>
+		inline T& Unwrap(T &param) {
+			return param;
+		}
+
+		template<class T>
+		inline T Unwrap(PassedWrapper<T> &param) {
+			return param.Take();
+		}
+
+		// The params are constructed in place from the arguments of the builder, and moved once into the task.
+		struct Params0 {
+		};
+
+		template<class A>
+		struct Params1 {
+			template<class A2>
+			explicit Params1(A2 &&a) : a_(std::forward<A2>(a)) {
+			}
+
+			Params1(Params1 &&other) : a_(std::move(other.a_)) {
+			}
+
+			A a_;
+		};
+
+		template<class A, class B>
+		struct Params2 {
+			template<class A2, class B2>
+			Params2(A2 &&a, B2 &&b) : a_(std::forward<A2>(a)), b_(std::forward<B2>(b)) {
+			}
+
+			Params2(Params2 &&other) : a_(std::move(other.a_)), b_(std::move(other.b_)) {
+			}
+
+			A a_;
+			B b_;
+		};
+
+		template<class A, class B, class C>
+		struct Params3 {
+			template<class A2, class B2, class C2>
+			Params3(A2 &&a, B2 &&b, C2 &&c) : a_(std::forward<A2>(a)), b_(std::forward<B2>(b)), c_(std::forward<C2>(c)) {
+			}
+
+			Params3(Params3 &&other) : a_(std::move(other.a_)), b_(std::move(other.b_)), c_(std::move(other.c_)) {
+			}
+
+			A a_;
+			B b_;
+			C c_;
+		};
+
+		template<class A, class B, class C, class D>
+		struct Params4 {
+			template<class A2, class B2, class C2, class D2>
+			Params4(A2 &&a, B2 &&b, C2 &&c, D2 &&d) : a_(std::forward<A2>(a)), b_(std::forward<B2>(b)), c_(std::forward<C2>(c)), d_(std::forward<D2>(d)) {
+			}
+
+			Params4(Params4 &&other) : a_(std::move(other.a_)), b_(std::move(other.b_)), c_(std::move(other.c_)), d_(std::move(other.d_)) {
+			}
+
+			A a_;
+			B b_;
+			C c_;
+			D d_;
+		};
+
+		template<class A, class B, class C, class D, class E>
+		struct Params5 {
+			template<class A2, class B2, class C2, class D2, class E2>
+			Params5(A2 &&a, B2 &&b, C2 &&c, D2 &&d, E2 &&e) : a_(std::forward<A2>(a)), b_(std::forward<B2>(b)), c_(std::forward<C2>(c)), d_(std::forward<D2>(d)), e_(std::forward<E2>(e)) {
+			}
+
+			Params5(Params5 &&other) : a_(std::move(other.a_)), b_(std::move(other.b_)), c_(std::move(other.c_)), d_(std::move(other.d_)), e_(std::move(other.e_)) {
+			}
+
+			A a_;
+			B b_;
+			C c_;
+			D d_;
+			E e_;
+		};
+
+		template<class A, class B, class C, class D, class E, class F>
+		struct Params6 {
+			template<class A2, class B2, class C2, class D2, class E2, class F2>
+			Params6(A2 &&a, B2 &&b, C2 &&c, D2 &&d, E2 &&e, F2 &&f) : a_(std::forward<A2>(a)), b_(std::forward<B2>(b)), c_(std::forward<C2>(c)), d_(std::forward<D2>(d)), e_(std::forward<E2>(e)), f_(std::forward<F2>(f)) {
+			}
+
+			Params6(Params6 &&other) : a_(std::move(other.a_)), b_(std::move(other.b_)), c_(std::move(other.c_)), d_(std::move(other.d_)), e_(std::move(other.e_)), f_(std::move(other.f_)) {
+			}
+
+			A a_;
+			B b_;
+			C c_;
+			D d_;
+			E e_;
+			F f_;
+		};
+
+		template<class A, class B, class C, class D, class E, class F, class G>
+		struct Params7 {
+			template<class A2, class B2, class C2, class D2, class E2, class F2, class G2>
+			Params7(A2 &&a, B2 &&b, C2 &&c, D2 &&d, E2 &&e, F2 &&f, G2 &&g) : a_(std::forward<A2>(a)), b_(std::forward<B2>(b)), c_(std::forward<C2>(c)), d_(std::forward<D2>(d)), e_(std::forward<E2>(e)), f_(std::forward<F2>(f)), g_(std::forward<G2>(g)) {
+			}
+
+			Params7(Params7 &&other) : a_(std::move(other.a_)), b_(std::move(other.b_)), c_(std::move(other.c_)), d_(std::move(other.d_)), e_(std::move(other.e_)), f_(std::move(other.f_)), g_(std::move(other.g_)) {
+			}
+
+			A a_;
+			B b_;
+			C c_;
+			D d_;
+			E e_;
+			F f_;
+			G g_;
+		};
+
+		template<class A, class B, class C, class D, class E, class F, class G, class H>
+		struct Params8 {
+			template<class A2, class B2, class C2, class D2, class E2, class F2, class G2, class H2>
+			Params8(A2 &&a, B2 &&b, C2 &&c, D2 &&d, E2 &&e, F2 &&f, G2 &&g, H2 &&h) : a_(std::forward<A2>(a)), b_(std::forward<B2>(b)), c_(std::forward<C2>(c)), d_(std::forward<D2>(d)), e_(std::forward<E2>(e)), f_(std::forward<F2>(f)), g_(std::forward<G2>(g)), h_(std::forward<H2>(h)) {
+			}
+
+			Params8(Params8 &&other) : a_(std::move(other.a_)), b_(std::move(other.b_)), c_(std::move(other.c_)), d_(std::move(other.d_)), e_(std::move(other.e_)), f_(std::move(other.f_)), g_(std::move(other.g_)), h_(std::move(other.h_)) {
+			}
+
+			A a_;
+			B b_;
+			C c_;
+			D d_;
+			E e_;
+			F f_;
+			G g_;
+			H h_;
+		};
+
+		template<class A, class B, class C, class D, class E, class F, class G, class H, class I>
+		struct Params9 {
+			template<class A2, class B2, class C2, class D2, class E2, class F2, class G2, class H2, class I2>
+			Params9(A2 &&a, B2 &&b, C2 &&c, D2 &&d, E2 &&e, F2 &&f, G2 &&g, H2 &&h, I2 &&i) : a_(std::forward<A2>(a)), b_(std::forward<B2>(b)), c_(std::forward<C2>(c)), d_(std::forward<D2>(d)), e_(std::forward<E2>(e)), f_(std::forward<F2>(f)), g_(std::forward<G2>(g)), h_(std::forward<H2>(h)), i_(std::forward<I2>(i)) {
+			}
+
+			Params9(Params9 &&other) : a_(std::move(other.a_)), b_(std::move(other.b_)), c_(std::move(other.c_)), d_(std::move(other.d_)), e_(std::move(other.e_)), f_(std::move(other.f_)), g_(std::move(other.g_)), h_(std::move(other.h_)), i_(std::move(other.i_)) {
+			}
+
+			A a_;
+			B b_;
+			C c_;
+			D d_;
+			E e_;
+			F f_;
+			G g_;
+			H h_;
+			I i_;
+		};
 	}
 
-	template<class T, class Method, class A>
-	inline void DispatchToMethod(T *obj, Method method, const A &arg) {
-		(obj->*method)(arg);
+	template<class T, class Method>
+	inline void DispatchToMethod(T *obj, Method method, internal::Params0 &params) {
+		(obj->*method)();
 	}
 
 	template<class T, class Method, class A>
-	inline void DispatchToMethod(T *obj, Method method, const tuple<A> &arg) {
-		(obj->*method)(get<0>(arg));
+	inline void DispatchToMethod(T *obj, Method method, internal::Params1<A> &params) {
+		(obj->*method)(internal::Unwrap(params.a_));
 	}
 
 	template<class T, class Method, class A, class B>
-	inline void DispatchToMethod(T *obj, Method method, const tuple<A, B> &arg) {
-		(obj->*method)(get<0>(arg), get<1>(arg));
+	inline void DispatchToMethod(T *obj, Method method, internal::Params2<A, B> &params) {
+		(obj->*method)(internal::Unwrap(params.a_), internal::Unwrap(params.b_));
 	}
 
 	template<class T, class Method, class A, class B, class C>
-	inline void DispatchToMethod(T *obj, Method method, const tuple<A, B, C> &arg) {
-		(obj->*method)(get<0>(arg), get<1>(arg), get<2>(arg));
+	inline void DispatchToMethod(T *obj, Method method, internal::Params3<A, B, C> &params) {
+		(obj->*method)(internal::Unwrap(params.a_), internal::Unwrap(params.b_), internal::Unwrap(params.c_));
 	}
 
 	template<class T, class Method, class A, class B, class C, class D>
-	inline void DispatchToMethod(T *obj, Method method, const tuple<A, B, C, D> &arg) {
-		(obj->*method)(get<0>(arg), get<1>(arg), get<2>(arg), get<3>(arg));
+	inline void DispatchToMethod(T *obj, Method method, internal::Params4<A, B, C, D> &params) {
+		(obj->*method)(internal::Unwrap(params.a_), internal::Unwrap(params.b_), internal::Unwrap(params.c_), internal::Unwrap(params.d_));
 	}
 
 	template<class T, class Method, class A, class B, class C, class D, class E>
-	inline void DispatchToMethod(T *obj, Method method, const tuple<A, B, C, D, E> &arg) {
-		(obj->*method)(get<0>(arg), get<1>(arg), get<2>(arg), get<3>(arg), get<4>(arg));
+	inline void DispatchToMethod(T *obj, Method method, internal::Params5<A, B, C, D, E> &params) {
+		(obj->*method)(internal::Unwrap(params.a_), internal::Unwrap(params.b_), internal::Unwrap(params.c_), internal::Unwrap(params.d_), internal::Unwrap(params.e_));
 	}
 
 	template<class T, class Method, class A, class B, class C, class D, class E, class F>
-	inline void DispatchToMethod(T *obj, Method method, const tuple<A, B, C, D, E, F> &arg) {
-		(obj->*method)(get<0>(arg), get<1>(arg), get<2>(arg), get<3>(arg), get<4>(arg), get<5>(arg));
+	inline void DispatchToMethod(T *obj, Method method, internal::Params6<A, B, C, D, E, F> &params) {
+		(obj->*method)(internal::Unwrap(params.a_), internal::Unwrap(params.b_), internal::Unwrap(params.c_), internal::Unwrap(params.d_), internal::Unwrap(params.e_), internal::Unwrap(params.f_));
 	}
 
 	template<class T, class Method, class A, class B, class C, class D, class E, class F, class G>
-	inline void DispatchToMethod(T *obj, Method method, const tuple<A, B, C, D, E, F, G> &arg) {
-		(obj->*method)(get<0>(arg), get<1>(arg), get<2>(arg), get<3>(arg), get<4>(arg), get<5>(arg), get<6>(arg));
+	inline void DispatchToMethod(T *obj, Method method, internal::Params7<A, B, C, D, E, F, G> &params) {
+		(obj->*method)(internal::Unwrap(params.a_), internal::Unwrap(params.b_), internal::Unwrap(params.c_), internal::Unwrap(params.d_), internal::Unwrap(params.e_), internal::Unwrap(params.f_), internal::Unwrap(params.g_));
 	}
 
 	template<class T, class Method, class A, class B, class C, class D, class E, class F, class G, class H>
-	inline void DispatchToMethod(T *obj, Method method, const tuple<A, B, C, D, E, F, G, H> &arg) {
-		(obj->*method)(get<0>(arg), get<1>(arg), get<2>(arg), get<3>(arg), get<4>(arg), get<5>(arg), get<6>(arg), get<7>(arg));
+	inline void DispatchToMethod(T *obj, Method method, internal::Params8<A, B, C, D, E, F, G, H> &params) {
+		(obj->*method)(internal::Unwrap(params.a_), internal::Unwrap(params.b_), internal::Unwrap(params.c_), internal::Unwrap(params.d_), internal::Unwrap(params.e_), internal::Unwrap(params.f_), internal::Unwrap(params.g_), internal::Unwrap(params.h_));
 	}
 
 	template<class T, class Method, class A, class B, class C, class D, class E, class F, class G, class H, class I>
-	inline void DispatchToMethod(T *obj, Method method, const tuple<A, B, C, D, E, F, G, H, I> &arg) {
-		(obj->*method)(get<0>(arg), get<1>(arg), get<2>(arg), get<3>(arg), get<4>(arg), get<5>(arg), get<6>(arg), get<7>(arg), get<8>(arg));
+	inline void DispatchToMethod(T *obj, Method method, internal::Params9<A, B, C, D, E, F, G, H, I> &params) {
+		(obj->*method)(internal::Unwrap(params.a_), internal::Unwrap(params.b_), internal::Unwrap(params.c_), internal::Unwrap(params.d_), internal::Unwrap(params.e_), internal::Unwrap(params.f_), internal::Unwrap(params.g_), internal::Unwrap(params.h_), internal::Unwrap(params.i_));
 	}
 
+	// |func| is a function pointer or an object with operator(), like a lambda.
 	template<class Func>
-	inline void DispatchToFunction(Func func, const tuple<std::tr1::_Nil> &arg) {
-		(*func)();
+	inline void DispatchToFunction(Func &func, internal::Params0 &params) {
+		func();
+	}
+
+	template<class Func, class A>
+	inline void DispatchToFunction(Func &func, internal::Params1<A> &params) {
+		func(internal::Unwrap(params.a_));
 	}
 
-	template<class Func,  class A>
-	inline void DispatchToFunction(Func func, const tuple<A> &arg) {
-		(*func)(get<0>(arg));
+	template<class Func, class A, class B>
+	inline void DispatchToFunction(Func &func, internal::Params2<A, B> &params) {
+		func(internal::Unwrap(params.a_), internal::Unwrap(params.b_));
 	}
 
-	template<class Func,  class A, class B>
-	inline void DispatchToFunction(Func func, const tuple<A, B> &arg) {
-		(*func)(get<0>(arg), get<1>(arg));
+	template<class Func, class A, class B, class C>
+	inline void DispatchToFunction(Func &func, internal::Params3<A, B, C> &params) {
+		func(internal::Unwrap(params.a_), internal::Unwrap(params.b_), internal::Unwrap(params.c_));
 	}
 
-	template<class Func,  class A, class B, class C>
-	inline void DispatchToFunction(Func func, const tuple<A, B, C> &arg) {
-		(*func)(get<0>(arg), get<1>(arg), get<2>(arg));
+	template<class Func, class A, class B, class C, class D>
+	inline void DispatchToFunction(Func &func, internal::Params4<A, B, C, D> &params) {
+		func(internal::Unwrap(params.a_), internal::Unwrap(params.b_), internal::Unwrap(params.c_), internal::Unwrap(params.d_));
 	}
 
-	template<class Func,  class A, class B, class C, class D>
-	inline void DispatchToFunction(Func func, const tuple<A, B, C, D> &arg) {
-		(*func)(get<0>(arg), get<1>(arg), get<2>(arg), get<3>(arg));
+	template<class Func, class A, class B, class C, class D, class E>
+	inline void DispatchToFunction(Func &func, internal::Params5<A, B, C, D, E> &params) {
+		func(internal::Unwrap(params.a_), internal::Unwrap(params.b_), internal::Unwrap(params.c_), internal::Unwrap(params.d_), internal::Unwrap(params.e_));
 	}
 
-	template<class Func,  class A, class B, class C, class D, class E>
-	inline void DispatchToFunction(Func func, const tuple<A, B, C, D, E> &arg) {
-		(*func)(get<0>(arg), get<1>(arg), get<2>(arg), get<3>(arg), get<4>(arg));
+	template<class Func, class A, class B, class C, class D, class E, class F>
+	inline void DispatchToFunction(Func &func, internal::Params6<A, B, C, D, E, F> &params) {
+		func(internal::Unwrap(params.a_), internal::Unwrap(params.b_), internal::Unwrap(params.c_), internal::Unwrap(params.d_), internal::Unwrap(params.e_), internal::Unwrap(params.f_));
 	}
 
-	template<class Func,  class A, class B, class C, class D, class E, class F>
-	inline void DispatchToFunction(Func func, const tuple<A, B, C, D, E, F> &arg) {
-		(*func)(get<0>(arg), get<1>(arg), get<2>(arg), get<3>(arg), get<4>(arg), get<5>(arg));
+	template<class Func, class A, class B, class C, class D, class E, class F, class G>
+	inline void DispatchToFunction(Func &func, internal::Params7<A, B, C, D, E, F, G> &params) {
+		func(internal::Unwrap(params.a_), internal::Unwrap(params.b_), internal::Unwrap(params.c_), internal::Unwrap(params.d_), internal::Unwrap(params.e_), internal::Unwrap(params.f_), internal::Unwrap(params.g_));
 	}
 
-	template<class Func,  class A, class B, class C, class D, class E, class F, class G>
-	inline void DispatchToFunction(Func func, const tuple<A, B, C, D, E, F, G> &arg) {
-		(*func)(get<0>(arg), get<1>(arg), get<2>(arg), get<3>(arg), get<4>(arg), get<5>(arg), get<6>(arg));
+	template<class Func, class A, class B, class C, class D, class E, class F, class G, class H>
+	inline void DispatchToFunction(Func &func, internal::Params8<A, B, C, D, E, F, G, H> &params) {
+		func(internal::Unwrap(params.a_), internal::Unwrap(params.b_), internal::Unwrap(params.c_), internal::Unwrap(params.d_), internal::Unwrap(params.e_), internal::Unwrap(params.f_), internal::Unwrap(params.g_), internal::Unwrap(params.h_));
 	}
 
-	template<class Func,  class A, class B, class C, class D, class E, class F, class G, class H>
-	inline void DispatchToFunction(Func func, const tuple<A, B, C, D, E, F, G, H> &arg) {
-		(*func)(get<0>(arg), get<1>(arg), get<2>(arg), get<3>(arg), get<4>(arg), get<5>(arg), get<6>(arg), get<7>(arg));
+	template<class Func, class A, class B, class C, class D, class E, class F, class G, class H, class I>
+	inline void DispatchToFunction(Func &func, internal::Params9<A, B, C, D, E, F, G, H, I> &params) {
+		func(internal::Unwrap(params.a_), internal::Unwrap(params.b_), internal::Unwrap(params.c_), internal::Unwrap(params.d_), internal::Unwrap(params.e_), internal::Unwrap(params.f_), internal::Unwrap(params.g_), internal::Unwrap(params.h_), internal::Unwrap(params.i_));
 	}
 
-	template<class Func,  class A, class B, class C, class D, class E, class F, class G, class H, class I>
-	inline void DispatchToFunction(Func func, const tuple<A, B, C, D, E, F, G, H, I> &arg) {
-		(*func)(get<0>(arg), get<1>(arg), get<2>(arg), get<3>(arg), get<4>(arg), get<5>(arg), get<6>(arg), get<7>(arg), get<8>(arg));
+	// Bind a param which is moved into the call, see above.
+	template<class T>
+	inline internal::PassedWrapper<T> Passed(T &&value) {
+		static_assert(!std::is_reference<T>::value, "Passed() takes an rvalue, use std::move");
+		return internal::PassedWrapper<T>(std::move(value));
 	}
 }
 